@@ -0,0 +1,176 @@
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "socket.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+//! Make room for `fds` more file descriptors, as far as the hard limit allows
+static void
+raise_fd_limit(const size_t fds)
+{
+    rlimit limit{};
+    SystemCall("getrlimit", ::getrlimit(RLIMIT_NOFILE, &limit));
+    if (limit.rlim_cur < fds + 64) {
+        limit.rlim_cur = min<rlim_t>(limit.rlim_max, fds + 64);
+        SystemCall("setrlimit", ::setrlimit(RLIMIT_NOFILE, &limit));
+    }
+}
+
+static const char*
+backend_name(const EventLoop::Backend backend)
+{
+    switch (backend) {
+        case EventLoop::Backend::Poll:
+            return "poll";
+        case EventLoop::Backend::Epoll:
+            return "epoll";
+        default:
+            return "io_uring";
+    }
+}
+
+//! Register `pipes` idle pipes, then time one readable pipe at a time
+void
+eventloop_loop(const EventLoop::Backend backend, const size_t pipes)
+{
+    constexpr size_t events = 100000;
+
+    vector<pair<FileDescriptor, FileDescriptor>> ends;
+    ends.reserve(pipes);
+    for (size_t i = 0; i < pipes; i++) {
+        int fds[2];
+        SystemCall("pipe2", ::pipe2(fds, O_NONBLOCK | O_CLOEXEC));
+        ends.emplace_back(FileDescriptor{fds[0]}, FileDescriptor{fds[1]});
+    }
+
+    EventLoop loop{backend};
+    size_t handled = 0;
+    for (auto& [reader, writer] : ends) {
+        loop.add_rule(reader, Direction::In, [&reader = reader, &handled] {
+            reader.read(1);
+            handled++;
+        });
+    }
+
+    auto rd = get_random_generator();
+    const auto first_time = high_resolution_clock::now();
+    for (size_t i = 0; i < events; i++) {
+        ends[rd() % pipes].second.write("x");
+        if (loop.wait_next_event(-1) != EventLoop::Result::Success) {
+            throw runtime_error("EventLoop stopped early");
+        }
+    }
+    const auto duration = duration_cast<nanoseconds>(high_resolution_clock::now() - first_time).count();
+
+    if (handled != events) {
+        throw runtime_error("expected " + to_string(events) + " events, handled " + to_string(handled));
+    }
+
+    cout << fixed << setprecision(2);
+    cout << "EventLoop (" << backend_name(loop.backend()) << ") with " << setw(5) << pipes
+         << " registered fds: " << setw(8) << duration / 1000.0 / events << " us per event\n";
+}
+
+//! Receive bursts of UDP datagrams over loopback, counting the receiver's system calls
+void
+udp_loop(const EventLoop::Backend backend, const bool multishot)
+{
+    constexpr size_t datagrams = 200000;
+    constexpr size_t burst = 32;
+    const string payload(1000, 'x');
+
+    UDPSocket receiver;
+    receiver.bind(Address("127.0.0.1", 0));
+    receiver.set_blocking(false);
+    UDPSocket sender;
+    sender.connect(receiver.local_address());
+
+    // the io_uring receiver replaces recvfrom(2); the EventLoop polls its ring instead of the socket
+    optional<IoUringReceiver> ring;
+    if (multishot) {
+        try {
+            ring.emplace(receiver, true);
+        } catch (const unix_error& e) {
+            cout << "UDP receive (io_uring multishot) unavailable: " << e.what() << "\n";
+            return;
+        }
+    }
+
+    EventLoop loop{backend};
+    size_t received = 0;
+    size_t syscalls = 0;
+    if (ring.has_value()) {
+        loop.add_rule(ring->fd(), Direction::In, [&] {
+            while (const auto datagram = ring->read()) {
+                received++;
+            }
+        });
+    } else {
+        loop.add_rule(receiver, Direction::In, [&] {
+            receiver.recv();
+            syscalls++;
+            received++;
+        });
+    }
+
+    const auto first_time = high_resolution_clock::now();
+    for (size_t sent = 0; sent < datagrams; sent += burst) {
+        for (size_t i = 0; i < burst; i++) {
+            sender.send(payload);
+        }
+        while (received < sent + burst) {
+            if (loop.wait_next_event(1000) != EventLoop::Result::Success) {
+                throw runtime_error("UDP datagrams did not arrive");
+            }
+            syscalls++;
+        }
+    }
+    const auto duration = duration_cast<nanoseconds>(high_resolution_clock::now() - first_time).count();
+    if (ring.has_value()) {
+        syscalls += ring->enter_count();
+    }
+
+    cout << fixed << setprecision(2);
+    cout << "UDP receive (" << backend_name(loop.backend()) << (multishot ? " + io_uring multishot" : ", recvfrom")
+         << "): " << setw(5) << double(syscalls) / datagrams << " syscalls per datagram, " << setw(8)
+         << datagrams * payload.size() * 8.0 / duration << " Gbit/s (burst of " << burst << ")\n";
+}
+
+int
+main()
+{
+    try {
+        raise_fd_limit(2 * 4096);
+        const auto backends = {EventLoop::Backend::Poll, EventLoop::Backend::Epoll, EventLoop::Backend::IoUring};
+        for (const size_t pipes : {16, 256, 1024, 4096}) {
+            for (const auto backend : backends) {
+                eventloop_loop(backend, pipes);
+            }
+        }
+        for (const auto backend : backends) {
+            udp_loop(backend, false);
+        }
+        udp_loop(EventLoop::Backend::IoUring, true);
+    } catch (const exception& e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,407 @@
+#include "arp_message.hh"
+#include "lpm_table.hh"
+#include "router.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+struct Prefix {
+    uint32_t prefix;
+    uint8_t length;
+};
+
+//! A synthetic table shaped like a full BGP table: mostly /24s, then /16s to /23s, a few short and
+//! a few longer than /24, spread over the unicast address space
+static vector<Prefix>
+synthetic_table(const size_t count, mt19937& rd)
+{
+    static const vector<pair<uint8_t, unsigned>> length_weights = {
+        {8, 1},   {12, 2},  {14, 3},  {15, 4},  {16, 60}, {17, 20}, {18, 35},  {19, 60},
+        {20, 90}, {21, 100}, {22, 170}, {23, 130}, {24, 600}, {25, 3},  {26, 4}, {28, 4},
+        {29, 3},  {30, 3},  {32, 5}};
+    vector<unsigned> weights;
+    for (const auto& [length, weight] : length_weights) {
+        weights.push_back(weight);
+    }
+    discrete_distribution<size_t> pick_length{weights.begin(), weights.end()};
+
+    vector<Prefix> table;
+    table.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t length = length_weights[pick_length(rd)].first;
+        const uint32_t address = 0x01000000 + rd() % 0xdf000000;  // 1.0.0.0 to 223.255.255.255
+        table.push_back({address & (~uint32_t{0} << (32 - length)), length});
+    }
+    return table;
+}
+
+//! The route that Router found by scanning its route table: the first of the longest matches
+static optional<uint32_t>
+scan(const vector<Prefix>& table, const uint32_t address)
+{
+    optional<uint32_t> best;
+    int max_length = -1;
+    for (uint32_t i = 0; i < table.size(); i++) {
+        const uint32_t mask = table[i].length == 0 ? 0 : ~uint32_t{0} << (32 - table[i].length);
+        if ((address & mask) == table[i].prefix and int(table[i].length) > max_length) {
+            max_length = table[i].length;
+            best = i;
+        }
+    }
+    return best;
+}
+
+//! Compare lookups in an LPMTable with a scan of the same prefixes
+void
+lpm_loop(const size_t prefixes)
+{
+    constexpr size_t lookups = 10000000;
+    constexpr size_t scans = 200;
+
+    auto rd = get_random_generator();
+    const vector<Prefix> table = synthetic_table(prefixes, rd);
+
+    const auto build_start = steady_clock::now();
+    LPMTable lpm;
+    for (uint32_t i = 0; i < table.size(); i++) {
+        lpm.insert(table[i].prefix, table[i].length, i);
+    }
+    const auto build_time = duration_cast<milliseconds>(steady_clock::now() - build_start).count();
+
+    // half of the destinations fall inside some prefix, the others anywhere
+    vector<uint32_t> addresses(1 << 20);
+    for (size_t i = 0; i < addresses.size(); i++) {
+        addresses[i] = i % 2 ? uint32_t(rd()) : table[rd() % table.size()].prefix | (rd() & 0xff);
+    }
+
+    uint64_t found = 0;
+    const auto lpm_start = steady_clock::now();
+    for (size_t i = 0; i < lookups; i++) {
+        found += lpm.lookup(addresses[i & (addresses.size() - 1)]).value_or(0);
+    }
+    const auto lpm_time = duration_cast<nanoseconds>(steady_clock::now() - lpm_start).count();
+
+    const auto scan_start = steady_clock::now();
+    for (size_t i = 0; i < scans; i++) {
+        if (scan(table, addresses[i]) != lpm.lookup(addresses[i])) {
+            throw runtime_error("LPMTable and scan disagree about " + to_string(addresses[i]));
+        }
+    }
+    const auto scan_time = duration_cast<nanoseconds>(steady_clock::now() - scan_start).count();
+
+    cout << fixed << setprecision(2);
+    cout << "Route table of " << prefixes << " prefixes (LPMTable built in " << build_time << " ms, "
+         << lpm.memory_usage() / 1048576.0 << " MiB):\n"
+         << "    LPMTable: " << setw(12) << lookups * 1e9 / lpm_time << " lookups/s (checksum "
+         << found % 1000 << ")\n"
+         << "    scan:     " << setw(12) << scans * 1e9 / scan_time << " lookups/s\n";
+}
+
+static EthernetAddress
+ethernet_address(const uint8_t host, const uint8_t interface)
+{
+    return {0x02, 0, 0, 0, host, interface};
+}
+
+static string
+subnet_address(const size_t subnet, const unsigned host)
+{
+    return "10.0." + to_string(subnet) + "." + to_string(host);
+}
+
+//! Frames that the host on `from` sends to the hosts on the other subnets, through the router
+static vector<EthernetFrame>
+traffic(const size_t from, const size_t subnets)
+{
+    vector<EthernetFrame> frames;
+    for (size_t i = 0; i < 256; i++) {
+        const size_t to = subnets == 1 ? from : (from + 1 + i % (subnets - 1)) % subnets;
+        InternetDatagram dgram;
+        dgram.header().src = Address(subnet_address(from, 2)).ipv4_numeric();
+        dgram.header().dst = Address(subnet_address(to, 2)).ipv4_numeric();
+        dgram.payload() = string(64, 'x');
+        dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+
+        EthernetFrame frame;
+        frame.header() = {ethernet_address(1, from), ethernet_address(2, from), EthernetHeader::TYPE_IPv4};
+        frame.payload() = dgram.serialize().concatenate();
+        frames.push_back(move(frame));
+    }
+    return frames;
+}
+
+//! What a host does with a frame from the router: answer ARP, count datagrams
+//! \returns `true` for a datagram
+static bool
+host_receives(NetworkInterface& host, EthernetFrame& frame)
+{
+    if (frame.header().type == EthernetHeader::TYPE_IPv4) {
+        return true;
+    }
+    frame.payload() = frame.payload().concatenate();
+    host.recv_frame(frame);
+    return false;
+}
+
+//! Forward datagrams between `subnets` subnets, each with a host sending to the others as fast as
+//! the router takes them, as in network_simulator's network: by calling route() on one thread, or
+//! with a worker thread per interface (and a thread per host)
+void
+forwarding_loop(const size_t subnets, const bool workers)
+{
+    constexpr uint64_t warmup_ms = 100;
+    constexpr uint64_t duration_ms = 1000;
+    constexpr size_t burst = 32;
+
+    Router router;
+    vector<NetworkInterface> hosts;
+    vector<vector<EthernetFrame>> frames;
+    for (size_t i = 0; i < subnets; i++) {
+        router.add_interface({ethernet_address(1, i), Address(subnet_address(i, 1))});
+        router.add_routes({{Address(subnet_address(i, 0)).ipv4_numeric(), 24, {}, i}});
+        hosts.emplace_back(ethernet_address(2, i), Address(subnet_address(i, 2)));
+        frames.push_back(traffic(i, subnets));
+    }
+
+    atomic<bool> stop{false};
+    vector<atomic<uint64_t>> received(subnets);
+    const auto total = [&] {
+        uint64_t sum = 0;
+        for (const auto& count : received) {
+            sum += count.load(memory_order_relaxed);
+        }
+        return sum;
+    };
+
+    vector<thread> threads;
+    if (workers) {
+        router.start_workers();
+        for (size_t i = 0; i < subnets; i++) {
+            threads.emplace_back([&, i] {
+                size_t next = 0;
+                while (not stop.load(memory_order_relaxed)) {
+                    for (size_t k = 0; k < burst; k++) {
+                        if (not router.deliver_frame(i, EthernetFrame(frames[i][next]))) {
+                            break;
+                        }
+                        next = (next + 1) % frames[i].size();
+                    }
+                    while (auto frame = router.take_frame(i)) {
+                        if (host_receives(hosts[i], frame.value())) {
+                            received[i].fetch_add(1, memory_order_relaxed);
+                        }
+                    }
+                    while (not hosts[i].frames_out().empty()) {
+                        router.deliver_frame(i, move(hosts[i].frames_out().front()));
+                        hosts[i].frames_out().pop();
+                    }
+                    this_thread::yield();
+                }
+            });
+        }
+    } else {
+        threads.emplace_back([&] {
+            vector<size_t> next(subnets, 0);
+            while (not stop.load(memory_order_relaxed)) {
+                for (size_t i = 0; i < subnets; i++) {
+                    for (size_t k = 0; k < burst; k++) {
+                        router.interface(i).recv_frame(frames[i][next[i]]);
+                        next[i] = (next[i] + 1) % frames[i].size();
+                    }
+                }
+                router.route();
+                for (size_t i = 0; i < subnets; i++) {
+                    auto& sent = router.interface(i).frames_out();
+                    for (; not sent.empty(); sent.pop()) {
+                        if (host_receives(hosts[i], sent.front())) {
+                            received[i].fetch_add(1, memory_order_relaxed);
+                        }
+                    }
+                    for (auto& replies = hosts[i].frames_out(); not replies.empty(); replies.pop()) {
+                        router.interface(i).recv_frame(replies.front());
+                    }
+                }
+            }
+        });
+    }
+
+    this_thread::sleep_for(milliseconds(warmup_ms));
+    const uint64_t first_received = total();
+    const auto first_time = steady_clock::now();
+    this_thread::sleep_for(milliseconds(duration_ms));
+    const uint64_t forwarded = total() - first_received;
+    const auto duration = duration_cast<nanoseconds>(steady_clock::now() - first_time).count();
+
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    router.stop_workers();
+
+    cout << fixed << setprecision(2);
+    cout << "Router with " << setw(2) << subnets << " interfaces, "
+         << (workers ? "a worker per interface: " : "route() on one thread: ") << setw(8)
+         << forwarded * 1e3 / duration << " Mdatagrams/s forwarded";
+    if (workers) {
+        cout << " (" << router.dropped_datagrams() << " dropped in full queues)";
+    }
+    cout << "\n";
+}
+
+#if defined(__x86_64__)
+static constexpr const char* CYCLE_UNIT = "cycles";
+#else
+static constexpr const char* CYCLE_UNIT = "ns";
+#endif
+
+//! A cycle count where the CPU has a timestamp counter, nanoseconds elsewhere
+static uint64_t
+cycles()
+{
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//! Cycles per datagram that route() and route_batched() take to forward bursts of datagrams through
+//! a route table of `prefixes` prefixes, with every next hop already in the ARP caches
+void
+burst_loop(const size_t prefixes)
+{
+    constexpr size_t interfaces = 4;
+    constexpr size_t datagrams = 4096;
+    constexpr size_t rounds = 100;
+
+    auto rd = get_random_generator();
+    const vector<Prefix> table = synthetic_table(prefixes, rd);
+
+    Router router;
+    vector<Router::RouteEntry> routes;
+    for (size_t i = 0; i < interfaces; i++) {
+        router.add_interface({ethernet_address(1, i), Address(subnet_address(i, 1))});
+        routes.push_back({Address(subnet_address(i, 0)).ipv4_numeric(), 24, {}, i});
+    }
+    for (size_t k = 0; k < table.size(); k++) {
+        routes.push_back({table[k].prefix, table[k].length, Address(subnet_address(k % interfaces, 2)), k % interfaces});
+    }
+    router.add_routes(routes);
+
+    // each gateway introduces itself, so that no datagram waits for ARP
+    for (size_t i = 0; i < interfaces; i++) {
+        ARPMessage request;
+        request.opcode = ARPMessage::OPCODE_REQUEST;
+        request.sender_ethernet_address = ethernet_address(2, i);
+        request.sender_ip_address = Address(subnet_address(i, 2)).ipv4_numeric();
+        request.target_ip_address = Address(subnet_address(i, 1)).ipv4_numeric();
+        EthernetFrame frame;
+        frame.header() = {ETHERNET_BROADCAST, request.sender_ethernet_address, EthernetHeader::TYPE_ARP};
+        frame.payload() = request.serialize();
+        router.interface(i).recv_frame(frame);
+    }
+
+    // datagrams to hosts inside the prefixes, arriving on every interface: built in memory, so that
+    // forwarding serializes their headers from scratch, or parsed from the wire, as
+    // NetworkInterface::recv_frame() does, so that forwarding patches the bytes it parsed
+    vector<InternetDatagram> built, received;
+    for (size_t n = 0; n < datagrams; n++) {
+        InternetDatagram dgram;
+        dgram.header().src = Address(subnet_address(n % interfaces, 9)).ipv4_numeric();
+        dgram.header().dst = table[rd() % table.size()].prefix | (rd() & 0xff);
+        dgram.payload() = string(64, 'x');
+        dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+        InternetDatagram parsed;
+        if (parsed.parse(dgram.serialize().concatenate()) != ParseResult::NoError) {
+            throw runtime_error("router_benchmark: datagram does not parse");
+        }
+        built.push_back(move(dgram));
+        received.push_back(move(parsed));
+    }
+
+    const auto measure = [&](const size_t burst_size, const vector<InternetDatagram>& arriving) {
+        vector<uint64_t> round_cycles;
+        for (size_t round = 0; round < rounds; round++) {
+            for (size_t n = 0; n < arriving.size(); n++) {
+                router.interface(n % interfaces).datagrams_out().push(arriving[n]);
+            }
+            const uint64_t start = cycles();
+            if (burst_size == 0) {
+                router.route();
+            } else {
+                router.route_batched(burst_size);
+            }
+            round_cycles.push_back(cycles() - start);
+            for (size_t i = 0; i < interfaces; i++) {
+                auto& sent = router.interface(i).frames_out();
+                while (not sent.empty()) {
+                    sent.pop();
+                }
+            }
+        }
+        // the median round, since other work on the machine inflates a few rounds a lot
+        nth_element(round_cycles.begin(), round_cycles.begin() + rounds / 2, round_cycles.end());
+        return double(round_cycles[rounds / 2]) / arriving.size();
+    };
+
+    measure(0, built);  // warm up the caches and the allocator
+    cout << fixed << setprecision(1);
+    cout << "Forwarding through " << prefixes << " prefixes, " << CYCLE_UNIT
+         << " per datagram (built in memory, parsed from the wire):\n"
+         << "    route():              " << setw(8) << measure(0, built) << setw(8) << measure(0, received) << "\n";
+    for (const size_t burst_size : {32, 64, 128, 256}) {
+        cout << "    route_batched(" << setw(3) << burst_size << "):    " << setw(8) << measure(burst_size, built)
+             << setw(8) << measure(burst_size, received) << "\n";
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    try {
+        if (argc > 2) {
+            cerr << "Usage: " << argv[0] << " [MAX_INTERFACES]\n";
+            return EXIT_FAILURE;
+        }
+
+        for (const size_t prefixes : {1000, 100000, 800000}) {
+            lpm_loop(prefixes);
+        }
+
+        for (const size_t prefixes : {1000, 100000, 800000}) {
+            burst_loop(prefixes);
+        }
+
+        const size_t cores = max(1U, thread::hardware_concurrency());
+        const size_t max_interfaces = argc == 2 ? stoul(argv[1]) : max<size_t>(cores, 2);
+        cout << cores << " core(s); workers run beside one host thread per interface\n";
+        for (size_t subnets = 2; subnets <= max_interfaces; subnets++) {
+            forwarding_loop(subnets, false);
+            forwarding_loop(subnets, true);
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
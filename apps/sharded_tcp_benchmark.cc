@@ -0,0 +1,190 @@
+#include "sharded_tcp_stack.hh"
+#include "socket.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+//! Two connected UDP sockets, to join two stacks as if by a wire
+static pair<FileDescriptor, FileDescriptor>
+wire()
+{
+    UDPSocket a;
+    UDPSocket b;
+    a.bind(Address("127.0.0.1", 0));
+    b.bind(Address("127.0.0.1", 0));
+    a.connect(b.local_address());
+    b.connect(a.local_address());
+    return {move(a), move(b)};
+}
+
+static constexpr size_t connections_per_shard = 32;
+static constexpr size_t request_size = 100;  //!< Bytes in each request, and in each response
+
+//! Per-shard counters, written by the shard's thread and read by the main thread
+struct alignas(64) ShardCounters {
+    atomic<uint64_t> transactions{0};
+    atomic<size_t> finished{0};
+};
+
+//! Run `connections_per_shard` request/response loops per client shard against a server with as many
+//! shards, and report transactions per second. With `crossed` wires, each shard's fd carries the
+//! datagrams of another shard's connections, so every datagram is handed off once at each end.
+void
+sharded_loop(const size_t shards, const bool crossed)
+{
+    constexpr uint64_t warmup_ms = 200;
+    constexpr uint64_t duration_ms = 1000;
+
+    TCPConfig config;
+    config.rt_timeout = 10;
+    const Address client_address{"10.144.0.1"};
+    const Address server_address{"10.144.0.2"};
+
+    vector<FileDescriptor> client_ends;
+    vector<FileDescriptor> server_ends;
+    for (size_t i = 0; i < shards; i++) {
+        auto [client_end, server_end] = wire();
+        client_ends.push_back(move(client_end));
+        server_ends.push_back(move(server_end));
+    }
+    if (crossed) {
+        rotate(server_ends.begin(), server_ends.begin() + 1, server_ends.end());
+    }
+
+    atomic<bool> stopping{false};
+    vector<ShardCounters> counters(shards);
+
+    // echo whatever arrives, and close once the client has
+    const auto server_setup = [](TCPStack& stack, const size_t) {
+        const auto serve = [&stack](const TCPStack::ConnectionId id) {
+            const string data = stack.read(id);
+            if (not data.empty()) {
+                stack.write(id, Buffer(string(data)));
+            }
+            if (stack.inbound_eof(id)) {
+                stack.close(id);
+            }
+        };
+        stack.set_handler(serve);
+        stack.listen(80, connections_per_shard, [&stack, serve](const uint16_t port) {
+            while (const auto id = stack.accept(port)) {
+                serve(id.value());
+            }
+        });
+    };
+
+    // send a request, wait for its whole response, and repeat until told to stop
+    const auto client_setup = [&](TCPStack& stack, const size_t index) {
+        ShardCounters& counter = counters[index];
+        auto pending = make_shared<unordered_map<TCPStack::ConnectionId, size_t>>();
+        const string request(request_size, 'x');
+        stack.set_handler([&stack, &counter, &stopping, pending, request](const TCPStack::ConnectionId id) {
+            if (stack.state(id) == TCPState::State::ESTABLISHED and pending->count(id) == 0) {
+                pending->emplace(id, request_size);
+                stack.write(id, Buffer(string(request)));
+            }
+            const auto it = pending->find(id);
+            if (it == pending->end()) {
+                return;
+            }
+            size_t& awaiting = it->second;
+            awaiting -= min(awaiting, stack.read(id).size());
+            if (awaiting == 0) {
+                counter.transactions.fetch_add(1, memory_order_relaxed);
+                if (stopping.load(memory_order_relaxed)) {
+                    stack.end_output(id);
+                    awaiting = SIZE_MAX;
+                } else {
+                    awaiting = request_size;
+                    stack.write(id, Buffer(string(request)));
+                }
+            }
+            if (stack.inbound_eof(id)) {
+                counter.finished.fetch_add(1, memory_order_relaxed);
+                stack.close(id);
+            }
+        });
+        for (size_t i = 0; i < connections_per_shard; i++) {
+            stack.connect(Address{"10.144.0.2", 80});
+        }
+    };
+
+    const auto total = [&](const auto& field) {
+        uint64_t sum = 0;
+        for (const auto& counter : counters) {
+            sum += field(counter).load();
+        }
+        return sum;
+    };
+    const auto transactions = [&] {
+        return total([](const ShardCounters& c) -> const auto& { return c.transactions; });
+    };
+    const auto finished = [&] { return total([](const ShardCounters& c) -> const auto& { return c.finished; }); };
+
+    ShardedTCPStack server{move(server_ends), server_address, config, server_setup};
+    ShardedTCPStack client{move(client_ends), client_address, config, client_setup};
+
+    this_thread::sleep_for(milliseconds(warmup_ms));
+    const uint64_t first_transactions = transactions();
+    const uint64_t first_handoffs = server.handoffs() + client.handoffs();
+    const auto first_time = steady_clock::now();
+    this_thread::sleep_for(milliseconds(duration_ms));
+    const uint64_t measured = transactions() - first_transactions;
+    const uint64_t handoffs = server.handoffs() + client.handoffs() - first_handoffs;
+    const auto duration = duration_cast<nanoseconds>(steady_clock::now() - first_time).count();
+
+    // let every connection finish cleanly (including the client's lingering) before stopping
+    stopping = true;
+    const auto deadline = steady_clock::now() + seconds(10);
+    while (finished() < shards * connections_per_shard and steady_clock::now() < deadline) {
+        this_thread::sleep_for(milliseconds(1));
+    }
+    this_thread::sleep_for(milliseconds(10 * config.rt_timeout + 50));
+    server.stop();
+    client.stop();
+
+    cout << fixed << setprecision(2);
+    cout << "ShardedTCPStack, " << setw(2) << shards << " shard(s) per end, " << (crossed ? "crossed" : "aligned")
+         << " wires: " << setw(10) << measured * 1e9 / duration << " transactions/s, " << setw(10)
+         << handoffs * 1e9 / duration << " handoffs/s\n";
+}
+
+int
+main(int argc, char* argv[])
+{
+    try {
+        if (argc > 2) {
+            cerr << "Usage: " << argv[0] << " [MAX_SHARDS]\n";
+            return EXIT_FAILURE;
+        }
+        const size_t cores = max(1U, thread::hardware_concurrency());
+        const size_t max_shards = argc == 2 ? stoul(argv[1]) : cores;
+        cout << cores << " core(s); each run has twice as many shard threads (client and server)\n";
+        for (size_t shards = 1; shards <= max_shards; shards++) {
+            sharded_loop(shards, false);
+            if (shards > 1) {
+                sharded_loop(shards, true);
+            }
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,10 +1,15 @@
+#include "stream_reassembler.hh"
 #include "tcp_connection.hh"
 
 #include <chrono>
 #include <cstdlib>
+#include <deque>
 #include <iomanip>
 #include <iostream>
+#include <malloc.h>
+#include <random>
 #include <string>
+#include <utility>
 
 using namespace std;
 using namespace std::chrono;
@@ -56,7 +61,9 @@ main_loop(const bool reorder)
         // write input into x
         while (bytes_to_send.size() and x.remaining_outbound_capacity()) {
             const auto want = min(x.remaining_outbound_capacity(), bytes_to_send.size());
-            const auto written = x.write(string(bytes_to_send.str().substr(0, want)));
+            Buffer chunk = bytes_to_send;
+            chunk.remove_suffix(chunk.size() - want);
+            const auto written = x.write(move(chunk));
             if (want != written) {
                 throw runtime_error("want = " + to_string(want) +
                                     ", written = " + to_string(written));
@@ -108,12 +115,303 @@ main_loop(const bool reorder)
     }
 }
 
+//! push `len` bytes through a single ByteStream in MSS-sized writes and zero-copy reads
+void
+byte_stream_loop(const ByteStreamBackend backend)
+{
+    ByteStream stream{TCPConfig::DEFAULT_CAPACITY, backend};
+
+    string chunk(TCPConfig::MAX_PAYLOAD_SIZE, 'x');
+    for (auto& ch : chunk) {
+        ch = rand();
+    }
+
+    size_t bytes_moved = 0;
+    uint8_t checksum = 0;
+
+    const auto first_time = high_resolution_clock::now();
+
+    while (bytes_moved < len) {
+        while (stream.remaining_capacity() > 0) {
+            stream.write(chunk);
+        }
+        while (not stream.buffer_empty()) {
+            const auto view = stream.peek_view(TCPConfig::MAX_PAYLOAD_SIZE);
+            for (const auto& piece : view.views()) {
+                checksum ^= piece.back();
+            }
+            bytes_moved += view.size();
+            stream.pop_output(view.size());
+        }
+    }
+
+    const auto final_time = high_resolution_clock::now();
+
+    const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
+
+    const auto gigabits_per_second = bytes_moved * 8.0 / double(duration);
+
+    cout << fixed << setprecision(2);
+    cout << "ByteStream throughput ("
+         << (backend == ByteStreamBackend::ring ? "ring)       : " : "BufferList) : ")
+         << gigabits_per_second << " Gbit/s (checksum " << +checksum << ")\n";
+}
+
+//! push segments into a StreamReassembler so that `holes` gaps are outstanding at once,
+//! then fill the gaps from the back so every fill lands next to buffered data
+void
+reassembler_loop(const size_t holes, const ReassemblerEngine engine)
+{
+    constexpr size_t segment_size = TCPConfig::MAX_PAYLOAD_SIZE;
+    const size_t total = 2 * holes * segment_size;
+
+    string to_send(total, 'x');
+    for (auto& ch : to_send) {
+        ch = rand();
+    }
+
+    StreamReassembler reassembler{total, engine};
+
+    const auto first_time = high_resolution_clock::now();
+
+    for (size_t i = 1; i < 2 * holes; i += 2) {
+        reassembler.push_substring(to_send.substr(i * segment_size, segment_size),
+                                   i * segment_size, i == 2 * holes - 1);
+    }
+    for (size_t i = 2 * holes; i >= 2; i -= 2) {
+        // overlap the neighbours by a few bytes on each side to exercise trimming
+        const size_t start = (i - 2) * segment_size;
+        const size_t begin = start > 8 ? start - 8 : 0;
+        reassembler.push_substring(to_send.substr(begin, segment_size + 16), begin, false);
+    }
+
+    const auto final_time = high_resolution_clock::now();
+
+    if (reassembler.stream_out().read(total) != to_send or not reassembler.stream_out().eof()) {
+        throw runtime_error("reassembled stream doesn't match");
+    }
+
+    const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
+
+    const auto gigabits_per_second = total * 8.0 / double(duration);
+
+    cout << fixed << setprecision(2);
+    const char* name = engine == ReassemblerEngine::bitmap ? "bitmap" : "interval map";
+    cout << "Reassembler (" << setw(12) << name << ") with " << setw(5) << holes
+         << " holes: " << gigabits_per_second << " Gbit/s\n";
+}
+
+//! bytes currently allocated from the heap
+size_t
+heap_in_use()
+{
+#ifdef __GLIBC__
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+//! fill a `window`-byte window with `write_size`-byte writes (each its own allocation, as from an
+//! application) and report the heap the sending connection holds once everything is in flight
+void
+memory_loop(const size_t window, const size_t write_size)
+{
+    TCPConfig config;
+    config.send_capacity = window;
+    config.recv_capacity = window;
+    TCPConnection x{config}, y{config};
+
+    // handshake, then one byte so that y advertises its (scaled) window
+    vector<TCPSegment> segments;
+    x.connect();
+    move_segments(x, y, segments, false);
+    move_segments(y, x, segments, false);
+    x.write("x");
+    move_segments(x, y, segments, false);
+    move_segments(y, x, segments, false);
+
+    const size_t heap_before = heap_in_use();
+    size_t written = 0;
+    while (x.remaining_outbound_capacity() >= write_size and x.bytes_in_flight() < window) {
+        written += x.write(Buffer{string(write_size, 'x')});
+        // the segments leave for the network
+        while (not x.segments_out().empty()) {
+            x.segments_out().pop();
+        }
+    }
+    const size_t held = heap_in_use() - heap_before;
+
+    cout << fixed << setprecision(2);
+    cout << "Sender memory with " << setw(4) << window / 1024 << " KiB window, " << setw(5)
+         << write_size << "-byte writes: " << setw(6) << held / 1024 << " KiB for "
+         << setw(4) << x.bytes_in_flight() / 1024 << " KiB in flight and " << setw(4)
+         << (written - x.bytes_in_flight()) / 1024 << " KiB buffered (" << held * 1.0 / written
+         << " bytes of heap per byte written)\n";
+}
+
+//! one direction of a simulated bottleneck: a drop-tail queue drained at a fixed rate, then a
+//! fixed propagation delay; segments are also dropped at random with probability `loss_rate`
+class SimulatedLink
+{
+private:
+    static constexpr size_t SEGMENTS_PER_MS = 2;   // about 23 Mbit/s of full-sized segments
+    static constexpr size_t QUEUE_LIMIT = 32;
+    static constexpr uint64_t DELAY_MS = 10;
+
+    double _loss_rate;
+    mt19937& _rand;
+    deque<TCPSegment> _queue{};
+    deque<pair<uint64_t, TCPSegment>> _in_flight{};
+
+public:
+    SimulatedLink(const double loss_rate, mt19937& rand) : _loss_rate(loss_rate), _rand(rand) {}
+
+    void
+    send(TCPConnection& from)
+    {
+        while (not from.segments_out().empty()) {
+            const bool lost = uniform_real_distribution<double>{}(_rand) < _loss_rate;
+            if (not lost and _queue.size() < QUEUE_LIMIT) {
+                _queue.push_back(move(from.segments_out().front()));
+            }
+            from.segments_out().pop();
+        }
+    }
+
+    void
+    deliver(TCPConnection& to, const uint64_t now)
+    {
+        for (size_t i = 0; i < SEGMENTS_PER_MS and not _queue.empty(); ++i) {
+            _in_flight.emplace_back(now + DELAY_MS, move(_queue.front()));
+            _queue.pop_front();
+        }
+        while (not _in_flight.empty() and _in_flight.front().first <= now) {
+            to.segment_received(_in_flight.front().second);
+            _in_flight.pop_front();
+        }
+    }
+};
+
+//! transfer a few megabytes across a SimulatedLink with random loss in both directions and
+//! report goodput in simulated time and how the sender recovered, so congestion control
+//! algorithms and loss recovery with and without SACK can be compared
+void
+loss_loop(const CongestionControlAlgorithm algorithm, const double loss_rate, const bool sack)
+{
+    constexpr size_t transfer = 4 * 1024 * 1024;
+    constexpr uint64_t time_limit_ms = 10 * 60 * 1000;
+
+    TCPConfig config;
+    config.congestion_control = algorithm;
+    // RFC 6298 estimation brings the one second initial RTO down to suit a 20 ms path
+    config.adaptive_rto = true;
+    config.timestamps = true;
+    config.sack = sack;
+    TCPConnection x{config}, y{config};
+
+    // every algorithm sees the same loss pattern
+    mt19937 rand{12345};
+    SimulatedLink uplink{loss_rate, rand}, downlink{loss_rate, rand};
+
+    string to_send(transfer, 'x');
+    for (auto& ch : to_send) {
+        ch = rand();
+    }
+    Buffer bytes_to_send{string(to_send)};
+
+    x.connect();
+    y.end_input_stream();
+
+    string received;
+    received.reserve(transfer);
+
+    uint64_t now = 0;
+    auto loop = [&] {
+        if (++now > time_limit_ms) {
+            throw runtime_error("lossy transfer did not complete");
+        }
+
+        while (bytes_to_send.size() and x.remaining_outbound_capacity()) {
+            Buffer chunk = bytes_to_send;
+            chunk.remove_suffix(chunk.size() -
+                                min(x.remaining_outbound_capacity(), bytes_to_send.size()));
+            bytes_to_send.remove_prefix(x.write(move(chunk)));
+            if (bytes_to_send.size() == 0) {
+                x.end_input_stream();
+            }
+        }
+
+        uplink.send(x);
+        downlink.send(y);
+        uplink.deliver(y, now);
+        downlink.deliver(x, now);
+
+        received.append(y.inbound_stream().read(y.inbound_stream().buffer_size()));
+
+        x.tick(1);
+        y.tick(1);
+    };
+
+    while (not y.inbound_stream().eof()) {
+        loop();
+    }
+    const uint64_t duration = now;
+    const RTTStatistics rtt = x.rtt_statistics();
+    const RecoveryStatistics recovery = x.recovery_statistics();
+
+    if (received != to_send) {
+        throw runtime_error("strings sent vs. received don't match under loss");
+    }
+
+    const char* name = algorithm == CongestionControlAlgorithm::reno      ? "Reno"
+                       : algorithm == CongestionControlAlgorithm::newreno ? "NewReno"
+                       : algorithm == CongestionControlAlgorithm::cubic   ? "CUBIC"
+                                                                          : "none";
+    cout << fixed << setprecision(2);
+    cout << "Goodput with " << setw(4) << loss_rate * 100 << "% loss (" << setw(7) << name
+         << (sack ? "+SACK" : "     ") << "): " << setw(6)
+         << transfer * 8.0 / (duration * 1000.0) << " Mbit/s simulated (srtt " << rtt.srtt
+         << " ms, rto " << rtt.rto << " ms)\n";
+    if (algorithm != CongestionControlAlgorithm::none) {
+        cout << "    " << recovery.fast_recoveries << " fast recoveries averaging "
+             << (recovery.fast_recoveries ? recovery.recovery_ms * 1.0 / recovery.fast_recoveries
+                                          : 0.0)
+             << " ms, " << recovery.timeouts << " timeouts, " << recovery.retransmissions
+             << " segments retransmitted\n";
+    }
+
+    while (x.active() or y.active()) {
+        loop();
+    }
+}
+
 int
 main()
 {
     try {
+        byte_stream_loop(ByteStreamBackend::buffer_list);
+        byte_stream_loop(ByteStreamBackend::ring);
+        for (const auto engine : {ReassemblerEngine::interval_map, ReassemblerEngine::bitmap}) {
+            reassembler_loop(1024, engine);
+            reassembler_loop(4096, engine);
+        }
         main_loop(false);
         main_loop(true);
+        for (const size_t window : {1024 * 1024, 8 * 1024 * 1024}) {
+            memory_loop(window, 64 * 1024);
+            memory_loop(window, 1024);
+        }
+        for (const double loss_rate : {0.005, 0.02}) {
+            for (const auto algorithm : {CongestionControlAlgorithm::none,
+                                         CongestionControlAlgorithm::reno,
+                                         CongestionControlAlgorithm::newreno,
+                                         CongestionControlAlgorithm::cubic}) {
+                loss_loop(algorithm, loss_rate, false);
+            }
+            loss_loop(CongestionControlAlgorithm::newreno, loss_rate, true);
+            loss_loop(CongestionControlAlgorithm::cubic, loss_rate, true);
+        }
     } catch (const exception& e) {
         cerr << e.what() << "\n";
         return EXIT_FAILURE;
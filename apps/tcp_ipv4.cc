@@ -37,7 +37,9 @@ show_usage(const char* argv0, const char* msg)
          << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
          << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT
-         << "\n\n"
+         << "\n"
+         << "   -m              Open a queue of a multi-queue tun device        (single queue)\n"
+         << "   -o              Use TSO/checksum offload (virtio-net header)    (off)\n\n"
 
          << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
          << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
@@ -59,7 +61,7 @@ check_argc(int argc, char** argv, int curr, const char* err)
     }
 }
 
-static tuple<TCPConfig, FdAdapterConfig, bool, char*>
+static tuple<TCPConfig, FdAdapterConfig, bool, char*, bool, bool>
 get_config(int argc, char** argv)
 {
     TCPConfig c_fsm{};
@@ -68,6 +70,8 @@ get_config(int argc, char** argv)
 
     int curr = 1;
     bool listen = false;
+    bool multi_queue = false;
+    bool offload = false;
 
     string source_address = LOCAL_ADDRESS_DFLT;
     string source_port = to_string(uint16_t(random_device()()));
@@ -102,6 +106,14 @@ get_config(int argc, char** argv)
             tundev = argv[curr + 1];
             curr += 2;
 
+        } else if (strncmp("-m", argv[curr], 3) == 0) {
+            multi_queue = true;
+            curr += 1;
+
+        } else if (strncmp("-o", argv[curr], 3) == 0) {
+            offload = true;
+            curr += 1;
+
         } else if (strncmp("-Lu", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -Lu requires one argument.");
             float lossrate = strtof(argv[curr + 1], nullptr);
@@ -140,7 +152,7 @@ get_config(int argc, char** argv)
         c_filt.source = {source_address, source_port};
     }
 
-    return make_tuple(c_fsm, c_filt, listen, tundev);
+    return make_tuple(c_fsm, c_filt, listen, tundev, multi_queue, offload);
 }
 
 int
@@ -152,9 +164,10 @@ main(int argc, char** argv)
             return EXIT_FAILURE;
         }
 
-        auto [c_fsm, c_filt, listen, tun_dev_name] = get_config(argc, argv);
-        LossyTCPOverIPv4SpongeSocket tcp_socket(LossyTCPOverIPv4OverTunFdAdapter(
-            TCPOverIPv4OverTunFdAdapter(TunFD(tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name))));
+        auto [c_fsm, c_filt, listen, tun_dev_name, multi_queue, offload] = get_config(argc, argv);
+        LossyTCPOverIPv4SpongeSocket tcp_socket(
+            LossyTCPOverIPv4OverTunFdAdapter(TCPOverIPv4OverTunFdAdapter(
+                TunFD(tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name, multi_queue, offload))));
 
         if (listen) {
             tcp_socket.listen_and_accept(c_fsm, c_filt);
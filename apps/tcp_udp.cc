@@ -31,6 +31,8 @@ show_usage(const char* argv0, const char* msg)
          << "   -t <tmout>      Set rt_timeout to tmout                         "
          << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
+         << "   -o              Use UDP GSO/GRO offload (Linux 5.0 or later)    (off)\n\n"
+
          << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
          << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
 
@@ -51,7 +53,7 @@ check_argc(int argc, char** argv, int curr, const char* err)
     }
 }
 
-static tuple<TCPConfig, FdAdapterConfig, bool>
+static tuple<TCPConfig, FdAdapterConfig, bool, bool>
 get_config(int argc, char** argv)
 {
     TCPConfig c_fsm{};
@@ -59,12 +61,17 @@ get_config(int argc, char** argv)
 
     int curr = 1;
     bool listen = false;
+    bool offload = false;
 
     while (argc - curr > 2) {
         if (strncmp("-l", argv[curr], 3) == 0) {
             listen = true;
             curr += 1;
 
+        } else if (strncmp("-o", argv[curr], 3) == 0) {
+            offload = true;
+            curr += 1;
+
         } else if (strncmp("-w", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -w requires one argument.");
             c_fsm.recv_capacity = strtol(argv[curr + 1], nullptr, 0);
@@ -109,7 +116,7 @@ get_config(int argc, char** argv)
         c_filt.destination = {argv[argc - 2], argv[argc - 1]};
     }
 
-    return make_tuple(c_fsm, c_filt, listen);
+    return make_tuple(c_fsm, c_filt, listen, offload);
 }
 
 int
@@ -122,15 +129,16 @@ main(int argc, char** argv)
         }
 
         // handle configuration and UDP setup from cmdline arguments
-        auto [c_fsm, c_filt, listen] = get_config(argc, argv);
+        auto [c_fsm, c_filt, listen, offload] = get_config(argc, argv);
 
         // build a TCP FSM on top of the UDP socket
         UDPSocket udp_sock;
         if (listen) {
             udp_sock.bind(c_filt.source);
         }
-        LossyTCPOverUDPSpongeSocket tcp_socket(
-            LossyTCPOverUDPSocketAdapter(TCPOverUDPSocketAdapter(move(udp_sock))));
+        TCPOverUDPSocketAdapter udp_adapter(move(udp_sock));
+        udp_adapter.set_offload(offload);
+        LossyTCPOverUDPSpongeSocket tcp_socket(LossyTCPOverUDPSocketAdapter(move(udp_adapter)));
         if (listen) {
             tcp_socket.listen_and_accept(c_fsm, c_filt);
         } else {
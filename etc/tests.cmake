@@ -11,6 +11,7 @@ add_test(NAME t_recv_transmit COMMAND recv_transmit)
 add_test(NAME t_recv_window COMMAND recv_window)
 add_test(NAME t_recv_reorder COMMAND recv_reorder)
 add_test(NAME t_recv_close COMMAND recv_close)
+add_test(NAME t_recv_retained COMMAND recv_retained)
 
 add_test(NAME t_send_connect COMMAND send_connect)
 add_test(NAME t_send_transmit COMMAND send_transmit)
@@ -18,6 +19,9 @@ add_test(NAME t_send_retx COMMAND send_retx)
 add_test(NAME t_send_window COMMAND send_window)
 add_test(NAME t_send_ack COMMAND send_ack)
 add_test(NAME t_send_close COMMAND send_close)
+add_test(NAME t_send_congestion COMMAND send_congestion)
+add_test(NAME t_send_rtt COMMAND send_rtt)
+add_test(NAME t_send_sack COMMAND send_sack)
 
 add_test(NAME t_strm_reassem_cap COMMAND fsm_stream_reassembler_cap)
 add_test(NAME t_strm_reassem_single COMMAND fsm_stream_reassembler_single)
@@ -33,6 +37,22 @@ add_test(NAME t_byte_stream_one_write COMMAND byte_stream_one_write)
 add_test(NAME t_byte_stream_two_writes COMMAND byte_stream_two_writes)
 add_test(NAME t_byte_stream_capacity COMMAND byte_stream_capacity)
 add_test(NAME t_byte_stream_many_writes COMMAND byte_stream_many_writes)
+add_test(NAME t_byte_stream_ring COMMAND byte_stream_ring)
+add_test(NAME t_byte_stream_buffers COMMAND byte_stream_buffers)
+add_test(NAME t_byte_stream_spsc COMMAND byte_stream_spsc)
+add_test(NAME t_tcp_outbound_ring COMMAND tcp_outbound_ring)
+add_test(NAME t_tcp_stack COMMAND tcp_stack)
+add_test(NAME t_sharded_tcp_stack COMMAND sharded_tcp_stack)
+add_test(NAME t_timer_wheel COMMAND timer_wheel)
+add_test(NAME t_lpm_table COMMAND lpm_table)
+add_test(NAME t_epoch_domain COMMAND epoch_domain)
+add_test(NAME t_router_workers COMMAND router_workers)
+add_test(NAME t_router_batched COMMAND router_batched)
+add_test(NAME t_ipv4_ttl COMMAND ipv4_ttl)
+add_test(NAME t_tuntap_adapter COMMAND tuntap_adapter)
+add_test(NAME t_eventloop_backends COMMAND eventloop_backends)
+add_test(NAME t_eventloop_uring COMMAND eventloop_uring)
+add_test(NAME t_udp_batch COMMAND udp_batch)
 
 add_test(NAME t_webget COMMAND "${PROJECT_SOURCE_DIR}/tests/webget_t.sh")
 
@@ -49,6 +69,8 @@ add_test(NAME t_ack_rst_win COMMAND fsm_ack_rst_win_relaxed)
 add_test(NAME t_connect COMMAND fsm_connect_relaxed)
 add_test(NAME t_listen COMMAND fsm_listen_relaxed)
 add_test(NAME t_winsize COMMAND fsm_winsize)
+add_test(NAME t_winscale COMMAND fsm_winscale)
+add_test(NAME t_keepalive COMMAND fsm_keepalive)
 add_test(NAME t_retx COMMAND fsm_retx_relaxed)
 add_test(NAME t_retx_win COMMAND fsm_retx_win)
 add_test(NAME t_loopback COMMAND fsm_loopback)
@@ -4,9 +4,15 @@
 
 using namespace std;
 
-ByteStream::ByteStream(const size_t capacity) :
-    _size(0), _capacity(capacity), _num_write(0), _num_read(0), _if_end(false)
+//! \param[in] capacity the maximum number of bytes held by the stream at once
+//! \param[in] backend how the buffered bytes are stored; ByteStreamBackend::ring allocates
+//! `capacity` bytes immediately and never allocates again
+ByteStream::ByteStream(const size_t capacity, const ByteStreamBackend backend) :
+    _backend(backend), _size(0), _capacity(capacity), _num_write(0), _num_read(0), _if_end(false)
 {
+    if (_backend == ByteStreamBackend::ring) {
+        _ring.resize(_capacity);
+    }
 }
 
 size_t
@@ -14,26 +20,131 @@ ByteStream::write(const string& data)
 {
     // 如果超出容量限制，直接截取字符串
     size_t l = min(data.size(), _capacity - _size);
-    std::string tmp = data.substr(0, l);
-    _stream_buffer.append(BufferList(std::move(tmp)));
+    if (l == 0) {
+        return 0;
+    }
+    if (_backend == ByteStreamBackend::ring) {
+        write_ring(string_view(data).substr(0, l));
+    } else {
+        std::string tmp = data.substr(0, l);
+        _stream_buffer.append(BufferList(std::move(tmp)));
+    }
     _size += l;
     _num_write += l;
     return l;
 }
 
+size_t
+ByteStream::write(Buffer data)
+{
+    size_t l = min(data.size(), _capacity - _size);
+    if (l == 0) {
+        return 0;
+    }
+    if (_backend == ByteStreamBackend::ring) {
+        write_ring(data.str().substr(0, l));
+    } else {
+        // 超出容量的部分直接丢弃，不需要拷贝
+        data.remove_suffix(data.size() - l);
+        _stream_buffer.append(data);
+    }
+    _size += l;
+    _num_write += l;
+    return l;
+}
+
+size_t
+ByteStream::write(const BufferList& data)
+{
+    size_t total = 0;
+    for (const auto& buf : data.buffers()) {
+        const size_t l = write(buf);
+        total += l;
+        if (l < buf.size()) {
+            break;
+        }
+    }
+    return total;
+}
+
+void
+ByteStream::write_ring(string_view data)
+{
+    // 写入位置可能绕回 ring 的开头，最多拷贝两段
+    const size_t tail = (_ring_head + _size) % _capacity;
+    const size_t first = min(data.size(), _capacity - tail);
+    copy(data.begin(), data.begin() + first, _ring.begin() + tail);
+    copy(data.begin() + first, data.end(), _ring.begin());
+}
+
 //! \param[in] len bytes will be copied from the output side of the buffer
 string
 ByteStream::peek_output(const size_t len) const
 {
+    if (_backend == ByteStreamBackend::ring) {
+        const BufferViewList views = peek_view(len);
+        string ret;
+        ret.reserve(views.size());
+        for (const auto& view : views.views()) {
+            ret.append(view);
+        }
+        return ret;
+    }
     return _stream_buffer.concatenate(std::move(min(len, _size)));
 }
 
+//! \param[in] len bytes will be exposed from the output side of the buffer
+BufferViewList
+ByteStream::peek_view(const size_t len) const
+{
+    const size_t l = min(len, _size);
+    BufferViewList ret;
+    if (_backend == ByteStreamBackend::ring) {
+        const size_t first = min(l, _capacity - _ring_head);
+        ret.append({_ring.data() + _ring_head, first});
+        ret.append({_ring.data(), l - first});
+        return ret;
+    }
+    size_t remaining = l;
+    for (const auto& buf : _stream_buffer.buffers()) {
+        if (remaining == 0) {
+            break;
+        }
+        const string_view view = buf.str().substr(0, remaining);
+        ret.append(view);
+        remaining -= view.size();
+    }
+    return ret;
+}
+
+//! \param[in] len bytes will be returned from the output side of the buffer
+Buffer
+ByteStream::peek_buffer(const size_t len) const
+{
+    const size_t l = min(len, _size);
+    if (l == 0) {
+        return {};
+    }
+    if (_backend == ByteStreamBackend::buffer_list &&
+        _stream_buffer.buffers().front().size() >= l) {
+        Buffer ret = _stream_buffer.buffers().front();
+        ret.remove_suffix(ret.size() - l);
+        return ret;
+    }
+    return Buffer(peek_output(l));
+}
+
 //! \param[in] len bytes will be removed from the output side of the buffer
 void
 ByteStream::pop_output(const size_t len)
 {
     size_t l = min(len, _size);
-    _stream_buffer.remove_prefix(l);
+    if (_backend == ByteStreamBackend::ring) {
+        // 缓冲区清空时回到开头，使后续的 peek_view 尽量只有一段
+        _ring_head = (l == _size) ? 0 : (_ring_head + l) % _capacity;
+    } else {
+        _stream_buffer.remove_prefix(l);
+    }
     _size -= l;
     _num_read += l;
 }
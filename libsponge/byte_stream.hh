@@ -6,6 +6,13 @@
 #include <cstddef>
 #include <string>
 
+//! \brief Storage strategy used by a ByteStream
+enum class ByteStreamBackend
+{
+    buffer_list,   //!< queue of reference-counted Buffers, one allocation per write
+    ring           //!< contiguous ring of `capacity` bytes, allocated once at construction
+};
+
 //! \brief An in-order byte stream.
 
 //! Bytes are written on the "input" side and read from the "output"
@@ -15,7 +22,12 @@ class ByteStream
 {
 private:
     // Your code here -- add private members as necessary.
+    ByteStreamBackend _backend;
     BufferList _stream_buffer{};
+    //! storage for ByteStreamBackend::ring, sized to `_capacity` up front
+    std::string _ring{};
+    //! offset of the first unread byte inside `_ring`
+    size_t _ring_head{0};
     size_t _size;
     size_t _capacity;
     size_t _num_write;
@@ -23,9 +35,13 @@ private:
     bool _if_end;
     bool _error{};   //!< Flag indicating that the stream suffered an error.
 
+    //! copy `data` into the ring after the last buffered byte (ByteStreamBackend::ring only)
+    void write_ring(std::string_view data);
+
 public:
     //! Construct a stream with room for `capacity` bytes.
-    ByteStream(const size_t capacity);
+    ByteStream(const size_t capacity,
+               const ByteStreamBackend backend = ByteStreamBackend::buffer_list);
 
     //! \name "Input" interface for the writer
     //!@{
@@ -35,6 +51,15 @@ public:
     //! \returns the number of bytes accepted into the stream
     size_t write(const std::string& data);
 
+    //! Write a Buffer into the stream, sharing its storage instead of copying
+    //! (unless the stream uses ByteStreamBackend::ring).
+    //! \returns the number of bytes accepted into the stream
+    size_t write(Buffer data);
+
+    //! Write each Buffer of a BufferList into the stream, in order, without copying
+    //! \returns the number of bytes accepted into the stream
+    size_t write(const BufferList& data);
+
     //! \returns the number of additional bytes that the stream has space for
     size_t remaining_capacity() const;
 
@@ -56,6 +81,23 @@ public:
     //! \returns a string
     std::string peek_output(const size_t len) const;
 
+    //! Peek at next "len" bytes of the stream without copying them
+    //! \returns views into the stream's storage (at most two for ByteStreamBackend::ring),
+    //! valid until the next call to write() or pop_output()
+    BufferViewList peek_view(const size_t len) const;
+
+    //! Peek at next "len" bytes of the stream as `iovec`s, e.g. for [writev(2)](\ref man2::writev)
+    std::vector<iovec>
+    peek_iovecs(const size_t len) const
+    {
+        return peek_view(len).as_iovecs();
+    }
+
+    //! Peek at next "len" bytes of the stream as a single Buffer
+    //! \note Shares storage with the stream when the bytes were written as one Buffer
+    //! (the common case for segment-sized reads); otherwise copies them.
+    Buffer peek_buffer(const size_t len) const;
+
     //! Remove bytes from the buffer
     void pop_output(const size_t len);
 
@@ -69,6 +111,16 @@ public:
         return ret;
     }
 
+    //! Read (i.e., peek_buffer and then pop) the next "len" bytes of the stream
+    //! \returns a Buffer of the bytes read
+    Buffer
+    read_buffer(const size_t len)
+    {
+        auto ret = peek_buffer(len);
+        pop_output(ret.size());
+        return ret;
+    }
+
     //! \returns `true` if the stream input has ended
     bool input_ended() const;
 
@@ -97,6 +149,13 @@ public:
 
     //! Total number of bytes popped
     size_t bytes_read() const;
+
+    //! Storage strategy chosen at construction
+    ByteStreamBackend
+    backend() const
+    {
+        return _backend;
+    }
     //!@}
 };
 
@@ -0,0 +1,160 @@
+#include "congestion_control.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+CongestionControl::CongestionControl(const size_t mss) :
+    _mss(mss),
+    _cwnd(mss > 2190 ? 2 * mss : mss > 1095 ? 3 * mss : 4 * mss),
+    _ssthresh(numeric_limits<uint64_t>::max())
+{
+}
+
+void
+CongestionControl::slow_start(const uint64_t acked)
+{
+    _cwnd += min<uint64_t>(acked, _mss);
+}
+
+void
+RenoCongestionControl::on_ack(const uint64_t acked, const uint64_t /* ackno */,
+                              const uint64_t now_ms)
+{
+    // 第一个新的 ACK 就结束快速恢复
+    if (_in_recovery) {
+        _in_recovery = false;
+        _cwnd = _ssthresh;
+        return;
+    }
+    if (_cwnd < _ssthresh) {
+        slow_start(acked);
+    } else {
+        congestion_avoidance(acked, now_ms);
+    }
+}
+
+void
+RenoCongestionControl::on_loss(const uint64_t bytes_in_flight, const uint64_t next_seqno,
+                               const uint64_t now_ms)
+{
+    // 同一个窗口内的多次丢包只减小一次窗口
+    if (_in_recovery) {
+        return;
+    }
+    _ssthresh = reduced_ssthresh(bytes_in_flight, now_ms);
+    _cwnd = _ssthresh;
+    _bytes_acked = 0;
+    _in_recovery = true;
+    _recover = next_seqno;
+}
+
+void
+RenoCongestionControl::on_rto(const uint64_t bytes_in_flight, const uint64_t now_ms)
+{
+    _ssthresh = reduced_ssthresh(bytes_in_flight, now_ms);
+    // 超时说明 ACK 已经断流，从一个 MSS 重新开始慢启动
+    _cwnd = _mss;
+    _bytes_acked = 0;
+    _in_recovery = false;
+}
+
+void
+RenoCongestionControl::congestion_avoidance(const uint64_t acked, const uint64_t /* now_ms */)
+{
+    // 每确认一个窗口的数据，窗口增加一个 MSS (RFC 3465)
+    _bytes_acked += acked;
+    if (_bytes_acked >= _cwnd) {
+        _bytes_acked -= _cwnd;
+        _cwnd += _mss;
+    }
+}
+
+uint64_t
+RenoCongestionControl::reduced_ssthresh(const uint64_t bytes_in_flight,
+                                        const uint64_t /* now_ms */)
+{
+    return max<uint64_t>(bytes_in_flight / 2, 2 * _mss);
+}
+
+void
+NewRenoCongestionControl::on_ack(const uint64_t acked, const uint64_t ackno,
+                                 const uint64_t now_ms)
+{
+    if (not _in_recovery) {
+        RenoCongestionControl::on_ack(acked, ackno, now_ms);
+        return;
+    }
+    // 部分确认：丢包发生前发出的数据还没有全部确认，继续留在快速恢复中，窗口不变
+    if (ackno < _recover) {
+        return;
+    }
+    _in_recovery = false;
+    _cwnd = _ssthresh;
+}
+
+void
+CubicCongestionControl::congestion_avoidance(const uint64_t acked, const uint64_t now_ms)
+{
+    const double mss = _mss;
+    const double cwnd = _cwnd / mss;
+
+    if (not _epoch_started) {
+        _epoch_started = true;
+        _epoch_start = now_ms;
+        if (cwnd < _w_max) {
+            _k = cbrt((_w_max - cwnd) / C);
+        } else {
+            _k = 0;
+            _w_max = cwnd;
+        }
+        _w_est = cwnd;
+    }
+
+    // W_cubic(t) = C * (t - K)^3 + W_max，每个 RTT 最多增长到 1.5 倍
+    const double t = (now_ms - _epoch_start) / 1000.0;
+    double target = min(C * pow(t - _k, 3) + _w_max, 1.5 * cwnd);
+
+    // TCP-friendly region：不比同样条件下的 Reno 慢
+    _w_est += 3 * (1 - BETA) / (1 + BETA) * (acked / mss) / cwnd;
+    target = max(target, _w_est);
+
+    if (target > cwnd) {
+        _growth += (target - cwnd) / cwnd * acked;
+    } else {
+        _growth += 0.01 * acked / cwnd;
+    }
+    const uint64_t whole = static_cast<uint64_t>(_growth);
+    _cwnd += whole;
+    _growth -= whole;
+}
+
+uint64_t
+CubicCongestionControl::reduced_ssthresh(const uint64_t /* bytes_in_flight */,
+                                         const uint64_t /* now_ms */)
+{
+    const double cwnd = double(_cwnd) / _mss;
+    // fast convergence：窗口比上次丢包时还小，说明有新的流加入，多让出一些带宽
+    _w_max = cwnd < _w_max ? cwnd * (1 + BETA) / 2 : cwnd;
+    _epoch_started = false;
+    _growth = 0;
+    return max<uint64_t>(static_cast<uint64_t>(_cwnd * BETA), 2 * _mss);
+}
+
+unique_ptr<CongestionControl>
+make_congestion_control(const CongestionControlAlgorithm algorithm, const size_t mss)
+{
+    switch (algorithm) {
+    case CongestionControlAlgorithm::reno:
+        return make_unique<RenoCongestionControl>(mss);
+    case CongestionControlAlgorithm::newreno:
+        return make_unique<NewRenoCongestionControl>(mss);
+    case CongestionControlAlgorithm::cubic:
+        return make_unique<CubicCongestionControl>(mss);
+    case CongestionControlAlgorithm::none:
+        break;
+    }
+    return nullptr;
+}
@@ -0,0 +1,136 @@
+#ifndef SPONGE_LIBSPONGE_CONGESTION_CONTROL_HH
+#define SPONGE_LIBSPONGE_CONGESTION_CONTROL_HH
+
+#include "tcp_config.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+//! \brief Congestion window state shared by every algorithm, plus the hooks a TCPSender calls.
+
+//! All quantities are in bytes of sequence space and all times are milliseconds on the sender's
+//! clock (the sum of every `ms_since_last_tick` it has seen).
+class CongestionControl
+{
+protected:
+    size_t _mss;          //!< sender maximum segment size
+    uint64_t _cwnd;       //!< congestion window
+    uint64_t _ssthresh;   //!< slow start threshold
+
+    //! fast recovery: set by on_loss(), cleared once the loss has been repaired
+    bool _in_recovery{false};
+
+    //! next_seqno when recovery started; NewReno stays in recovery until it is acknowledged
+    uint64_t _recover{0};
+
+    //! bytes acknowledged during congestion avoidance and not yet turned into window growth
+    uint64_t _bytes_acked{0};
+
+    //! slow start: grow by at most one MSS per ACK (RFC 3465, L = 1)
+    void slow_start(uint64_t acked);
+
+public:
+    //! \param[in] mss the maximum segment size; the initial window follows RFC 5681 section 3.1
+    explicit CongestionControl(size_t mss);
+    virtual ~CongestionControl() = default;
+
+    //! \brief New data was cumulatively acknowledged
+    //! \param[in] acked bytes newly acknowledged by this ACK
+    //! \param[in] ackno the (absolute) acknowledgment number
+    //! \param[in] now_ms current time
+    virtual void on_ack(uint64_t acked, uint64_t ackno, uint64_t now_ms) = 0;
+
+    //! \brief A loss was inferred while ACKs are still arriving (e.g. duplicate ACKs or SACK)
+    //! \param[in] bytes_in_flight outstanding bytes when the loss was detected
+    //! \param[in] next_seqno the highest sequence number sent so far
+    //! \param[in] now_ms current time
+    virtual void on_loss(uint64_t bytes_in_flight, uint64_t next_seqno, uint64_t now_ms) = 0;
+
+    //! \brief The retransmission timer expired
+    //! \param[in] bytes_in_flight outstanding bytes when the timer fired
+    //! \param[in] now_ms current time
+    virtual void on_rto(uint64_t bytes_in_flight, uint64_t now_ms) = 0;
+
+    //! \name Accessors
+    //!@{
+    uint64_t
+    cwnd() const
+    {
+        return _cwnd;
+    }
+
+    uint64_t
+    ssthresh() const
+    {
+        return _ssthresh;
+    }
+
+    //! \brief Is a loss being repaired? Partial ACKs in recovery mean another segment was lost.
+    bool
+    in_recovery() const
+    {
+        return _in_recovery;
+    }
+    //!@}
+};
+
+//! \brief RFC 5681: slow start, congestion avoidance, and fast recovery that ends on the first
+//! new ACK
+class RenoCongestionControl : public CongestionControl
+{
+protected:
+    //! \brief Window growth once `_cwnd >= _ssthresh`
+    virtual void congestion_avoidance(uint64_t acked, uint64_t now_ms);
+
+    //! \brief New `_ssthresh` after a loss, also remembering whatever later growth depends on
+    virtual uint64_t reduced_ssthresh(uint64_t bytes_in_flight, uint64_t now_ms);
+
+public:
+    using CongestionControl::CongestionControl;
+
+    void on_ack(uint64_t acked, uint64_t ackno, uint64_t now_ms) override;
+    void on_loss(uint64_t bytes_in_flight, uint64_t next_seqno, uint64_t now_ms) override;
+    void on_rto(uint64_t bytes_in_flight, uint64_t now_ms) override;
+};
+
+//! \brief RFC 6582: like Reno, but a partial ACK keeps the sender in fast recovery so every
+//! segment lost from the same window is repaired without another window reduction
+class NewRenoCongestionControl : public RenoCongestionControl
+{
+public:
+    using RenoCongestionControl::RenoCongestionControl;
+
+    void on_ack(uint64_t acked, uint64_t ackno, uint64_t now_ms) override;
+};
+
+//! \brief RFC 8312: window grows as a cubic function of the time since the last reduction,
+//! with NewReno loss recovery
+class CubicCongestionControl : public NewRenoCongestionControl
+{
+private:
+    static constexpr double C = 0.4;      //!< scaling constant, in segments / s^3
+    static constexpr double BETA = 0.7;   //!< multiplicative decrease factor
+
+    double _w_max{0};          //!< window before the last reduction, in segments
+    double _w_est{0};          //!< estimate of what Reno would have reached, in segments
+    double _k{0};              //!< seconds the cubic needs to climb back to `_w_max`
+    bool _epoch_started{false};
+    uint64_t _epoch_start{0};  //!< time of the first ACK after the last reduction
+    double _growth{0};         //!< fractional bytes of growth not yet added to `_cwnd`
+
+protected:
+    void congestion_avoidance(uint64_t acked, uint64_t now_ms) override;
+    uint64_t reduced_ssthresh(uint64_t bytes_in_flight, uint64_t now_ms) override;
+
+public:
+    using NewRenoCongestionControl::NewRenoCongestionControl;
+};
+
+//! \brief Create the algorithm selected by TCPConfig::congestion_control
+//! \returns `nullptr` for CongestionControlAlgorithm::none
+std::unique_ptr<CongestionControl>
+make_congestion_control(CongestionControlAlgorithm algorithm,
+                        size_t mss = TCPConfig::MAX_PAYLOAD_SIZE);
+
+#endif   // SPONGE_LIBSPONGE_CONGESTION_CONTROL_HH
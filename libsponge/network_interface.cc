@@ -51,7 +51,8 @@ NetworkInterface::send_datagram(const InternetDatagram& dgram, const Address& ne
             frame.payload() = seg.serialize();
             _frames_out.push(std::move(frame));
             _frames_cannot_find_arp[next_hop_ip].first.push_back(dgram);
-            _frames_cannot_find_arp[next_hop_ip].second = ARP_CONSTANT::ARP_PENDING_TTL;
+            _frames_cannot_find_arp[next_hop_ip].second = _timers.schedule(
+                ARP_CONSTANT::ARP_PENDING_TTL, PENDING_REQUEST_TIMER << 32 | next_hop_ip);
         } else {
             // 对于该 dgram，过去已经发送了 ARP 报文，不需要重新发送
             if (arp_iter->second.first.size() == 0) {
@@ -62,6 +63,42 @@ NetworkInterface::send_datagram(const InternetDatagram& dgram, const Address& ne
     }
 }
 
+//! \param[in] dgrams the IPv4 datagrams to be sent
+//! \param[in] next_hops for each datagram, the numeric IP address of the interface to send it to
+void
+NetworkInterface::send_datagrams(const vector<const InternetDatagram*>& dgrams,
+                                 const vector<uint32_t>& next_hops)
+{
+    // 预取几个报文之后的报文头，让 cache miss 与当前报文的封装重叠
+    constexpr size_t PREFETCH_DISTANCE = 4;
+
+    // 连续发往同一下一跳的报文共用一次 ARP 缓存查找
+    bool looked_up = false;
+    uint32_t looked_up_ip = 0;
+    const EthernetAddress* next_hop_eth = nullptr;
+    for (size_t i = 0; i < dgrams.size(); i++) {
+        if (i + PREFETCH_DISTANCE < dgrams.size()) {
+            __builtin_prefetch(&dgrams[i + PREFETCH_DISTANCE]->header());
+        }
+        if (not looked_up or next_hops[i] != looked_up_ip) {
+            looked_up = true;
+            looked_up_ip = next_hops[i];
+            const auto iter = _arp_cache.find(looked_up_ip);
+            next_hop_eth = iter == _arp_cache.end() ? nullptr : &iter->second.eth_addr;
+        }
+
+        if (next_hop_eth == nullptr) {
+            // 没有 ARP 缓存：与单个发送一样发 ARP 请求或加入等待队列（不会修改 ARP 缓存）
+            send_datagram(*dgrams[i], Address::from_ipv4_numeric(next_hops[i]));
+            continue;
+        }
+        // 直接在队列中构造帧，省去一次移动
+        EthernetFrame& frame = _frames_out.emplace();
+        frame.header() = {*next_hop_eth, _ethernet_address, EthernetHeader::TYPE_IPv4};
+        frame.payload() = dgrams[i]->serialize();
+    }
+}
+
 //! \param[in] frame the incoming Ethernet frame
 optional<InternetDatagram>
 NetworkInterface::recv_frame(const EthernetFrame& frame)
@@ -77,10 +114,13 @@ NetworkInterface::recv_frame(const EthernetFrame& frame)
         // 收到 ARP 回复
         if (seg.opcode == ARPMessage::OPCODE_REPLY) {
             if (seg.target_ip_address == _ip_address.ipv4_numeric()) {
-                _arp_cache[seg.sender_ip_address] =
-                    ARPEntry{seg.sender_ethernet_address, ARP_CONSTANT::ARP_CACHE_TTL};
+                learn(seg.sender_ip_address, seg.sender_ethernet_address);
                 // 该发送的 dgram 全部都要发送出去
                 auto dgram_iter = _frames_cannot_find_arp.find(seg.sender_ip_address);
+                if (dgram_iter == _frames_cannot_find_arp.end()) {
+                    return nullopt;
+                }
+                _timers.cancel(dgram_iter->second.second);
                 for (auto dgram : dgram_iter->second.first) {
                     EthernetFrame tmp;
                     tmp.header() = {
@@ -94,8 +134,7 @@ NetworkInterface::recv_frame(const EthernetFrame& frame)
             // 发送 ARP 回复
             if (seg.target_ip_address == _ip_address.ipv4_numeric()) {
                 // 即使只是收到了 ARP 请求消息，也要更新 ARP 缓存
-                _arp_cache[seg.sender_ip_address] =
-                    ARPEntry{seg.sender_ethernet_address, ARP_CONSTANT::ARP_CACHE_TTL};
+                learn(seg.sender_ip_address, seg.sender_ethernet_address);
                 ARPMessage arp_reply;
                 arp_reply.opcode = ARPMessage::OPCODE_REPLY;
                 arp_reply.sender_ethernet_address = _ethernet_address;
@@ -120,28 +159,28 @@ NetworkInterface::recv_frame(const EthernetFrame& frame)
     return nullopt;
 }
 
+void
+NetworkInterface::learn(const uint32_t ip, const EthernetAddress& eth_addr)
+{
+    auto iter = _arp_cache.find(ip);
+    if (iter != _arp_cache.end()) {
+        _timers.cancel(iter->second.expiry);
+    }
+    _arp_cache[ip] = ARPEntry{
+        eth_addr, _timers.schedule(ARP_CONSTANT::ARP_CACHE_TTL, CACHE_ENTRY_TIMER << 32 | ip)};
+}
+
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void
 NetworkInterface::tick(const size_t ms_since_last_tick)
 {
-    auto arp_iter = _arp_cache.begin();
-    while (arp_iter != _arp_cache.end()) {
-        arp_iter->second.ttl -= ms_since_last_tick;
-        if (arp_iter->second.ttl <= 0) {
-            _arp_cache.erase(arp_iter++);
+    // 只处理到期的缓存与请求，不再遍历整个缓存
+    _timers.advance(ms_since_last_tick, [this](TimerWheel::TimerId, const uint64_t tag) {
+        const auto ip = static_cast<uint32_t>(tag);
+        if (tag >> 32 == CACHE_ENTRY_TIMER) {
+            _arp_cache.erase(ip);
         } else {
-            // 必须要这样写，否则会有bug
-            arp_iter++;
+            _frames_cannot_find_arp.erase(ip);
         }
-    }
-    auto dgram_iter = _frames_cannot_find_arp.begin();
-    while (dgram_iter != _frames_cannot_find_arp.end()) {
-        dgram_iter->second.second -= ms_since_last_tick;
-        if (dgram_iter->second.second <= 0) {
-            _frames_cannot_find_arp.erase(dgram_iter++);
-        } else {
-            // 必须要这样写，否则会有bug
-            dgram_iter++;
-        }
-    }
+    });
 }
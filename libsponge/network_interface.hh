@@ -4,11 +4,13 @@
 #include "arp_message.hh"
 #include "ethernet_frame.hh"
 #include "tcp_over_ip.hh"
+#include "timer_wheel.hh"
 #include "tun.hh"
 
 #include <map>
 #include <optional>
 #include <queue>
+#include <vector>
 
 struct ARP_CONSTANT
 {
@@ -43,12 +45,20 @@ private:
     struct ARPEntry
     {
         EthernetAddress eth_addr;
-        int ttl = ARP_CONSTANT::ARP_CACHE_TTL;
+        TimerWheel::TimerId expiry;   //!< ARP_CACHE_TTL 后过期
     };
 
     //! ARP 缓存，IP到MAC地址的映射
     std::map<uint32_t, ARPEntry> _arp_cache;
 
+    //! ARP 缓存与等待中的 ARP 请求的过期时间，定时器的 tag 为 `类型 << 32 | ip`
+    TimerWheel _timers{};
+    static constexpr uint64_t CACHE_ENTRY_TIMER = 0;
+    static constexpr uint64_t PENDING_REQUEST_TIMER = 1;
+
+    //! 记录 `ip` 到 `eth_addr` 的映射，并重新开始计时
+    void learn(uint32_t ip, const EthernetAddress& eth_addr);
+
     //! Ethernet (known as hardware, network-access-layer, or link-layer) address of the interface
     EthernetAddress _ethernet_address;
 
@@ -59,8 +69,10 @@ private:
     //! 这里只存储找到 ARP 缓存的报文和 ARP 请求报文
     std::queue<EthernetFrame> _frames_out{};
 
-    //! 与 _frames_out 类似，但只存储未找到 ARP 缓存的报文，使用vector是因为有可能同一个ip请求多次
-    std::map<uint32_t, std::pair<std::vector<InternetDatagram>, int>> _frames_cannot_find_arp{};
+    //! 与 _frames_out 类似，但只存储未找到 ARP 缓存的报文，使用vector是因为有可能同一个ip请求多次；
+    //! ARP 请求在 ARP_PENDING_TTL 后过期
+    std::map<uint32_t, std::pair<std::vector<InternetDatagram>, TimerWheel::TimerId>>
+        _frames_cannot_find_arp{};
 
 public:
     //! \brief Construct a network interface with given Ethernet (network-access-layer) and IP
@@ -81,6 +93,12 @@ public:
     //! ("Sending" is accomplished by pushing the frame onto the frames_out queue.)
     void send_datagram(const InternetDatagram& dgram, const Address& next_hop);
 
+    //! \brief Sends a burst of datagrams, `*dgrams[i]` to the next hop whose numeric IPv4 address is
+    //! `next_hops[i]`, as send_datagram() would. The ARP cache is looked up once per run of datagrams
+    //! to the same next hop.
+    void send_datagrams(const std::vector<const InternetDatagram*>& dgrams,
+                        const std::vector<uint32_t>& next_hops);
+
     //! \brief Receives an Ethernet frame and responds appropriately.
     //! If type is IPv4, returns the datagram.
     //! If type is ARP request, learn a mapping from the "sender" fields, and send an ARP reply.
@@ -89,6 +107,14 @@ public:
 
     //! \brief Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
+
+    //! \brief Milliseconds until tick() may expire a cache entry or a pending ARP request, or
+    //! `nullopt` if there are neither
+    std::optional<uint64_t>
+    time_until_next_timer() const
+    {
+        return _timers.time_until_next_expiration();
+    }
 };
 
 #endif   // SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
@@ -1,6 +1,16 @@
 #include "router.hh"
 
+#include "util.hh"
+
+#include <algorithm>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -38,48 +48,66 @@ Router::add_route(const uint32_t route_prefix, const uint8_t prefix_length,
     cerr << "DEBUG: adding route " << Address::from_ipv4_numeric(route_prefix).ip() << "/"
          << int(prefix_length) << " => " << (next_hop.has_value() ? next_hop->ip() : "(direct)")
          << " on interface " << interface_num << "\n";
-    _route_table.push_back({route_prefix, prefix_length, next_hop, interface_num});
+    add_routes({{route_prefix, prefix_length, next_hop, interface_num}});
 }
 
-//! \param[in] dgram The datagram to be routed
+//! \param[in] routes the routes to add, in order
 void
-Router::route_one_datagram(InternetDatagram& dgram)
+Router::add_routes(const vector<RouteEntry>& routes)
+{
+    // 先检查整批路由，出错时什么都不发布；此后各条转发路径都不必再检查出接口
+    for (const auto& route : routes) {
+        if (route.interface_num >= _interfaces.size()) {
+            throw out_of_range("Router: route to interface " + to_string(route.interface_num)
+                               + ", which has not been added");
+        }
+    }
+
+    // 写者之间互斥；读者始终看到某个完整的版本
+    lock_guard<mutex> lock{_route_update_mutex};
+    const RouteTable* old_table = _route_table.load();
+    auto new_table = make_unique<RouteTable>(*old_table);
+    for (const auto& route : routes) {
+        new_table->lpm.insert(route.dst, route.prefix_length, new_table->routes.size());
+        new_table->routes.push_back(route);
+        new_table->next_hops.push_back(route.next_hop.has_value() ? route.next_hop->ipv4_numeric() : 0);
+    }
+    _route_table.store(new_table.release());
+    _epochs.retire(old_table);
+}
+
+//! \param[in] table The version of the route table to use
+//! \param[in] dgram The datagram to be routed
+optional<pair<size_t, Address>>
+Router::next_hop_of(const RouteTable& table, InternetDatagram& dgram) const
 {
     if (dgram.header().ttl > 0) {
-        dgram.header().ttl--;
+        dgram.decrement_ttl();
     }
     if (dgram.header().ttl == 0) {
-        return;
-    }
-    if (_route_table.size() == 0) {
-        return;
+        return nullopt;
     }
 
-    auto best_route = *_route_table.begin();
-    // 最长前缀
-    int max_prefix_mask = 0;
-    // 是否找到路由
-    bool if_find_route = false;
+    const auto route_index = table.lpm.lookup(dgram.header().dst);
+    if (not route_index.has_value()) {
+        return nullopt;
+    }
 
-    for (auto route_iter : _route_table) {
-        int mask = ~((1 << (32 - route_iter.prefix_length)) - 1);
-        if ((route_iter.prefix_length == 0) || ((dgram.header().dst & mask) == route_iter.dst)) {
-            if_find_route = true;
-            if (route_iter.prefix_length > max_prefix_mask) {
-                max_prefix_mask = route_iter.prefix_length;
-                best_route = route_iter;
-            }
-        }
+    const RouteEntry& best_route = table.routes[route_index.value()];
+    if (best_route.next_hop.has_value()) {
+        return make_pair(best_route.interface_num, best_route.next_hop.value());
     }
+    return make_pair(best_route.interface_num, Address::from_ipv4_numeric(dgram.header().dst));
+}
 
-    if (if_find_route) {
-        Address next_hop;
-        if (best_route.next_hop.has_value()) {
-            next_hop = best_route.next_hop.value();
-        } else {
-            next_hop = Address::from_ipv4_numeric(dgram.header().dst);
-        }
-        interface(best_route.interface_num).send_datagram(dgram, next_hop);
+//! \param[in] table The version of the route table to use
+//! \param[in] dgram The datagram to be routed
+void
+Router::route_one_datagram(const RouteTable& table, InternetDatagram& dgram)
+{
+    const auto hop = next_hop_of(table, dgram);
+    if (hop.has_value()) {
+        interface(hop->first).send_datagram(dgram, hop->second);
     }
 }
 
@@ -88,11 +116,239 @@ Router::route()
 {
     // Go through all the interfaces, and route every incoming datagram to its proper outgoing
     // interface.
+    // 整轮使用同一个版本的路由表；Guard 结束前它不会被释放
+    EpochDomain::Guard guard{_epochs};
+    const RouteTable& table = *_route_table.load();
     for (auto& interface : _interfaces) {
         auto& queue = interface.datagrams_out();
         while (not queue.empty()) {
-            route_one_datagram(queue.front());
+            route_one_datagram(table, queue.front());
             queue.pop();
         }
     }
 }
+
+//! std::queue 的底层容器是 protected 成员 `c`，借助派生类取得它，以便按下标访问队首的一批报文
+static std::deque<InternetDatagram>&
+queued_datagrams(std::queue<InternetDatagram>& queue)
+{
+    struct Access : std::queue<InternetDatagram>
+    {
+        static std::deque<InternetDatagram>& of(std::queue<InternetDatagram>& q) { return q.*&Access::c; }
+    };
+    return Access::of(queue);
+}
+
+//! \param[in] burst_size the most datagrams from one interface to route together
+void
+Router::route_batched(const size_t burst_size)
+{
+    if (burst_size == 0) {
+        throw runtime_error("Router: bursts must hold at least one datagram");
+    }
+
+    EpochDomain::Guard guard{_epochs};
+    const RouteTable& table = *_route_table.load();
+    Burst& burst = _burst;
+    burst.out_dgrams.resize(_interfaces.size());
+    burst.out_next_hops.resize(_interfaces.size());
+
+    for (auto& interface : _interfaces) {
+        auto& queue = interface.datagrams_out();
+        std::deque<InternetDatagram>& queued = queued_datagrams(queue);
+        while (not queue.empty()) {
+            // 1. 在队列中原地处理一批报文：TTL 减一，跳过 TTL 耗尽的报文
+            const size_t count = min(burst_size, queued.size());
+            burst.dgrams.clear();
+            burst.dsts.clear();
+            for (size_t i = 0; i < count; i++) {
+                InternetDatagram& dgram = queued[i];
+                if (dgram.header().ttl > 1) {
+                    dgram.decrement_ttl();
+                    burst.dsts.push_back(dgram.header().dst);
+                    burst.dgrams.push_back(&dgram);
+                }
+            }
+
+            // 2. 整批查最长前缀匹配表
+            burst.routes.resize(burst.dgrams.size());
+            table.lpm.lookup_batch(burst.dsts.data(), burst.routes.data(), burst.dgrams.size());
+
+            // 3. 按出接口分组，并确定下一跳
+            for (size_t i = 0; i < burst.dgrams.size(); i++) {
+                if (burst.routes[i] == LPMTable::NO_VALUE) {
+                    continue;
+                }
+                const size_t out = table.routes[burst.routes[i]].interface_num;
+                const uint32_t next_hop = table.next_hops[burst.routes[i]];
+                burst.out_next_hops[out].push_back(next_hop != 0 ? next_hop : burst.dsts[i]);
+                burst.out_dgrams[out].push_back(burst.dgrams[i]);
+            }
+
+            // 4. 每个出接口整批封装发送
+            for (size_t out = 0; out < _interfaces.size(); out++) {
+                if (not burst.out_dgrams[out].empty()) {
+                    _interfaces[out].send_datagrams(burst.out_dgrams[out], burst.out_next_hops[out]);
+                    burst.out_dgrams[out].clear();
+                    burst.out_next_hops[out].clear();
+                }
+            }
+
+            // 报文都已复制进帧或 ARP 等待队列，出队
+            for (size_t i = 0; i < count; i++) {
+                queue.pop();
+            }
+        }
+    }
+}
+
+//! \param[in] queue_capacity room in each queue of each interface
+//! \param[in] clock milliseconds by which the workers tick their interfaces (timestamp_ms() if empty)
+void
+Router::start_workers(const size_t queue_capacity, function<uint64_t()> clock)
+{
+    if (_workers_running.exchange(true)) {
+        throw runtime_error("Router: workers already started");
+    }
+    _worker_clock = clock ? move(clock) : timestamp_ms;
+    _ports.clear();
+    for (size_t i = 0; i < _interfaces.size(); i++) {
+        _ports.push_back(make_unique<Port>(
+            queue_capacity, FileDescriptor(SystemCall("eventfd", ::eventfd(0, EFD_CLOEXEC)))));
+    }
+    // 所有队列建好之后再启动线程，工作线程之间才能互相转交报文
+    for (size_t i = 0; i < _interfaces.size(); i++) {
+        _ports[i]->worker = thread(&Router::work, this, i);
+    }
+}
+
+void
+Router::stop_workers()
+{
+    if (not _workers_running.exchange(false)) {
+        return;
+    }
+    for (auto& port : _ports) {
+        wake(*port, true);
+        port->worker.join();
+    }
+}
+
+//! \param[in] port the worker's port
+//! \param[in] force wake the worker even if it does not seem to be sleeping
+void
+Router::wake(Port& port, const bool force)
+{
+    // 与 work() 中设置 sleeping 之后的屏障配对：要么生产者看到 sleeping，要么工作线程看到新数据
+    atomic_thread_fence(memory_order_seq_cst);
+    if (force or port.sleeping.load(memory_order_relaxed)) {
+        const uint64_t one = 1;
+        SystemCall("write", ::write(port.doorbell.fd_num(), &one, sizeof(one)));
+    }
+}
+
+//! \param[in] interface_num the interface the frame was received on
+//! \param[in] frame the received frame
+bool
+Router::deliver_frame(const size_t interface_num, EthernetFrame&& frame)
+{
+    Port& port = *_ports.at(interface_num);
+    if (not port.frames_in.push(move(frame))) {
+        port.dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    wake(port);
+    return true;
+}
+
+//! \param[in] interface_num the interface to take a frame from
+optional<EthernetFrame>
+Router::take_frame(const size_t interface_num)
+{
+    return _ports.at(interface_num)->frames_out.pop();
+}
+
+uint64_t
+Router::dropped_datagrams() const
+{
+    uint64_t dropped = 0;
+    for (const auto& port : _ports) {
+        dropped += port->dropped.load(memory_order_relaxed);
+    }
+    return dropped;
+}
+
+//! \param[in] interface_num the interface that this worker owns
+void
+Router::work(const size_t interface_num)
+{
+    Port& port = *_ports[interface_num];
+    AsyncNetworkInterface& own_interface = _interfaces[interface_num];
+    uint64_t last_tick = _worker_clock();
+
+    while (_workers_running.load(memory_order_relaxed)) {
+        bool busy = false;
+
+        // 先推进时间：睡眠期间过期的 ARP 缓存必须在转发之前清除，与 route() 模式由所有者先 tick 一致
+        const uint64_t now = _worker_clock();
+        own_interface.tick(now - last_tick);
+        last_tick = now;
+
+        // 收帧；IPv4 报文进入 datagrams_out，ARP 在这里处理
+        while (auto frame = port.frames_in.pop()) {
+            if (frame->payload().buffers().size() > 1) {
+                frame->payload() = frame->payload().concatenate();
+            }
+            own_interface.recv_frame(frame.value());
+            busy = true;
+        }
+
+        // 路由收到的报文：从本接口发出的直接发送，其余交给出接口的工作线程
+        auto& received = own_interface.datagrams_out();
+        if (not received.empty()) {
+            EpochDomain::Guard guard{_epochs};
+            const RouteTable& table = *_route_table.load();
+            while (not received.empty()) {
+                const auto hop = next_hop_of(table, received.front());
+                if (hop.has_value() and hop->first == interface_num) {
+                    own_interface.send_datagram(received.front(), hop->second);
+                } else if (hop.has_value()) {
+                    Port& out = *_ports.at(hop->first);
+                    pair<InternetDatagram, Address> handoff{move(received.front()), hop->second};
+                    if (out.handoffs.push(move(handoff))) {
+                        wake(out);
+                    } else {
+                        port.dropped.fetch_add(1, memory_order_relaxed);
+                    }
+                }
+                received.pop();
+            }
+        }
+
+        // 发送其他工作线程转交过来的报文
+        while (auto handoff = port.handoffs.pop()) {
+            own_interface.send_datagram(handoff->first, handoff->second);
+            busy = true;
+        }
+
+        // 发出的帧放进 frames_out 队列；队列满时留在接口里，等取走之后再放
+        auto& sent = own_interface.frames_out();
+        while (not sent.empty() and port.frames_out.push(move(sent.front()))) {
+            sent.pop();
+        }
+        if (not sent.empty()) {
+            this_thread::yield();
+            continue;
+        }
+
+        if (not busy) {
+            // 先声明要睡眠，再检查一次队列，避免错过睡眠前到达的数据
+            port.sleeping.store(true);
+            atomic_thread_fence(memory_order_seq_cst);
+            if (port.frames_in.empty() and port.handoffs.empty() and _workers_running.load()) {
+                port.doorbell.read(sizeof(uint64_t));
+            }
+            port.sleeping.store(false);
+        }
+    }
+}
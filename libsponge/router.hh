@@ -1,10 +1,22 @@
 #ifndef SPONGE_LIBSPONGE_ROUTER_HH
 #define SPONGE_LIBSPONGE_ROUTER_HH
 
+#include "epoch.hh"
+#include "file_descriptor.hh"
+#include "lpm_table.hh"
+#include "mpsc_queue.hh"
 #include "network_interface.hh"
+#include "spsc_queue.hh"
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
 
 //! \brief A wrapper for NetworkInterface that makes the host-side
 //! interface asynchronous: instead of returning received datagrams
@@ -49,6 +61,8 @@ public:
 //! performs longest-prefix-match routing between them.
 class Router
 {
+public:
+    //! A forwarding rule (see add_route())
     struct RouteEntry
     {
         uint32_t dst;
@@ -57,16 +71,89 @@ class Router
         std::optional<Address> next_hop;
         size_t interface_num;
     };
+
+private:
+    //! 路由表的一个版本：发布之后不再修改，只会被整体替换
+    struct RouteTable
+    {
+        std::vector<RouteEntry> routes{};
+        //! 每条路由数值形式的下一跳，直连为 0（供批量路由使用，免去逐个转换 Address）
+        std::vector<uint32_t> next_hops{};
+        //! 由 routes 编译的最长前缀匹配表，值为 `routes` 的下标
+        LPMTable lpm{};
+    };
+
     //! The router's collection of network interfaces
     std::vector<AsyncNetworkInterface> _interfaces{};
 
+    //! Decrement the datagram's TTL and find the interface and next hop of the route with the
+    //! longest prefix_length that matches its destination address in `table`
+    //! \returns nothing if the TTL ran out or no route matches
+    std::optional<std::pair<size_t, Address>> next_hop_of(const RouteTable& table,
+                                                           InternetDatagram& dgram) const;
+
     //! Send a single datagram from the appropriate outbound interface to the next hop,
     //! as specified by the route with the longest prefix_length that matches the
-    //! datagram's destination address.
-    void route_one_datagram(InternetDatagram& dgram);
-    std::vector<RouteEntry> _route_table;
+    //! datagram's destination address in `table`.
+    void route_one_datagram(const RouteTable& table, InternetDatagram& dgram);
+
+    //! route_batched() 各阶段之间传递的一批报文；跨调用复用，稳定之后不再分配内存
+    struct Burst
+    {
+        //! 仍在输入队列中的报文（移动 InternetDatagram 要为其 BufferList 分配内存，所以只取指针）
+        std::vector<const InternetDatagram*> dgrams{};
+        std::vector<uint32_t> dsts{};     //!< dgrams[i] 的目的地址
+        std::vector<uint32_t> routes{};   //!< dgrams[i] 的路由下标，或 LPMTable::NO_VALUE
+        //! 按出接口分组的报文与下一跳
+        std::vector<std::vector<const InternetDatagram*>> out_dgrams{};
+        std::vector<std::vector<uint32_t>> out_next_hops{};
+    };
+    Burst _burst{};
+
+    //! 当前的路由表。route() 在 EpochDomain::Guard 内无锁地读取，
+    //! add_route() 复制一份、修改后原子地替换，旧版本交给 `_epochs` 回收
+    std::atomic<const RouteTable*> _route_table;
+    EpochDomain _epochs{};
+    std::mutex _route_update_mutex{};   //!< 串行化写者
+
+    //! 并行转发模式下每个接口的工作线程与它的队列。接口只由自己的工作线程访问，
+    //! 其他线程只通过这些队列与它交互
+    struct Port
+    {
+        MPSCQueue<EthernetFrame> frames_in;   //!< 交给 deliver_frame() 的帧
+        //! 其他工作线程路由到本接口的报文与下一跳
+        MPSCQueue<std::pair<InternetDatagram, Address>> handoffs;
+        SPSCQueue<EthernetFrame> frames_out;   //!< 等待 take_frame() 取走的帧
+
+        FileDescriptor doorbell;   //!< eventfd，工作线程空闲时阻塞在上面
+        std::atomic<bool> sleeping{false};
+        std::atomic<uint64_t> dropped{0};   //!< 因队列已满而丢弃的报文
+
+        std::thread worker{};
+
+        Port(const size_t capacity, FileDescriptor&& eventfd) :
+            frames_in(capacity), handoffs(capacity), frames_out(capacity), doorbell(std::move(eventfd))
+        {
+        }
+    };
+    std::vector<std::unique_ptr<Port>> _ports{};
+    std::atomic<bool> _workers_running{false};
+    std::function<uint64_t()> _worker_clock{};   //!< 工作线程驱动 tick() 的时钟（毫秒）
+
+    //! 工作线程的主循环
+    void work(const size_t interface_num);
+
+    //! 唤醒正在睡眠的工作线程（`force` 时总是唤醒）
+    static void wake(Port& port, const bool force = false);
 
 public:
+    Router() : _route_table(new RouteTable) {}
+    ~Router()
+    {
+        stop_workers();
+        delete _route_table.load();
+    }
+
     //! Add an interface to the router
     //! \param[in] interface an already-constructed network interface
     //! \returns The index of the interface after it has been added to the router
@@ -85,11 +172,58 @@ public:
     }
 
     //! Add a route (a forwarding rule)
+    //! \note Safe to call from another thread while route() runs
+    //! \throws std::out_of_range if interface `interface_num` has not been added
     void add_route(const uint32_t route_prefix, const uint8_t prefix_length,
                    const std::optional<Address> next_hop, const size_t interface_num);
 
+    //! Add many routes, publishing them together as one new version of the route table
+    //! \note Safe to call from another thread while route() runs
+    //! \throws std::out_of_range (adding none of the routes) if a route's interface has not been added
+    void add_routes(const std::vector<RouteEntry>& routes);
+
     //! Route packets between the interfaces
     void route();
+
+    //! Route packets between the interfaces, like route(), but in bursts of up to `burst_size`
+    //! datagrams per input interface that pass through each stage together: TTL, route lookup
+    //! (LPMTable::lookup_batch), grouping by output interface, and NetworkInterface::send_datagrams()
+    void route_batched(const size_t burst_size = 64);
+
+    //! \name Parallel forwarding
+    //! Between start_workers() and stop_workers(), every interface is owned by a worker thread that
+    //! receives its frames, routes the datagrams it receives, and sends the datagrams that any worker
+    //! routes to it. interface() and route() must not be used meanwhile; frames go in through
+    //! deliver_frame() and come out through take_frame().
+
+    //!@{
+
+    //! Start a worker thread per interface
+    //! \param[in] queue_capacity room in each queue of each interface
+    //! \param[in] clock milliseconds by which the workers tick their interfaces (timestamp_ms() if empty)
+    void start_workers(const size_t queue_capacity = 1024, std::function<uint64_t()> clock = {});
+
+    //! Stop the worker threads; interface() and route() can be used again
+    void stop_workers();
+
+    //! Hand a frame received on an interface to its worker (from any thread)
+    //! \returns `false` if the interface's queue is full and the frame was dropped
+    bool deliver_frame(const size_t interface_num, EthernetFrame&& frame);
+
+    //! Take a frame that an interface's worker sent (from one thread per interface)
+    std::optional<EthernetFrame> take_frame(const size_t interface_num);
+
+    //! Datagrams dropped because a worker's queue was full
+    uint64_t dropped_datagrams() const;
+    //!@}
+
+    //! \name
+    //! Interfaces, the route table and the workers are owned by the router, which cannot be copied or moved
+
+    //!@{
+    Router(const Router&) = delete;
+    Router& operator=(const Router&) = delete;
+    //!@}
 };
 
 #endif   // SPONGE_LIBSPONGE_ROUTER_HH
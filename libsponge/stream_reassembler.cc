@@ -1,16 +1,29 @@
 #include "stream_reassembler.hh"
+
+#include <algorithm>
+#include <iterator>
 #include <string>
+#include <utility>
 
 using namespace std;
 
-StreamReassembler::StreamReassembler(const size_t capacity) :
+//! \param[in] capacity the maximum number of bytes held, assembled or not
+//! \param[in] engine how out-of-order bytes are stored; ReassemblerEngine::bitmap allocates
+//! `capacity` bytes plus one bit per byte immediately
+StreamReassembler::StreamReassembler(const size_t capacity, const ReassemblerEngine engine) :
+    _engine(engine),
     _output(capacity),
     _unassembled(),
     _first_unassemble_byte(0),
     _num_unassembled_byte(0),
     _capacity(capacity),
-    _eof(false)
+    _eof(false),
+    _eof_index(0)
 {
+    if (_engine == ReassemblerEngine::bitmap) {
+        _ring.resize(_capacity);
+        _present.resize((_capacity + 63) / 64);
+    }
 }
 
 //! \details This function accepts a substring (aka a segment) of bytes,
@@ -20,116 +33,301 @@ StreamReassembler::StreamReassembler(const size_t capacity) :
 void
 StreamReassembler::push_substring(const std::string& data, const size_t index, const bool eof)
 {
-    _eof |= eof;
-
-    // 如果 data 为空或收到的数据已经属于已经被排好序的
-    if (data.empty() || index + data.size() <= _first_unassemble_byte) {
-        // 如果所有数据已经被排好序 且 输入结束，告诉 byteStream 结束
-        if (_num_unassembled_byte == 0 && _eof) {
-            _output.end_input();
+    const auto [begin, end] = accept_range(index, data.size(), eof);
+    if (begin < end) {
+        if (_engine == ReassemblerEngine::bitmap && begin != _first_unassemble_byte) {
+            // 乱序的字节直接拷贝进 ring 中的最终位置
+            insert_bitmap(begin, string_view(data).substr(begin - index, end - begin));
+        } else {
+            // 只拷贝窗口内的部分
+            insert_in_window(begin, Buffer(data.substr(begin - index, end - begin)));
         }
-        return;
     }
+    assemble();
+}
+
+void
+StreamReassembler::push_substring(Buffer data, const uint64_t index, const bool eof)
+{
+    const auto [begin, end] = accept_range(index, data.size(), eof);
+    if (begin < end) {
+        data.remove_prefix(begin - index);
+        data.remove_suffix(data.size() - (end - begin));
+        insert_in_window(begin, std::move(data));
+    }
+    assemble();
+}
 
+pair<uint64_t, uint64_t>
+StreamReassembler::accept_range(const uint64_t index, const size_t size, const bool eof)
+{
     // 第一个需要被直接丢弃的 index
-    size_t first_unacceptable_byte = _first_unassemble_byte + _capacity - _output.buffer_size();
+    const uint64_t first_unacceptable_byte =
+        _first_unassemble_byte + _capacity - _output.buffer_size();
+
+    // 只有整个子串都能被接受时才记录 EOF
+    if (eof && index + size <= first_unacceptable_byte) {
+        _eof = true;
+        _eof_index = index + size;
+    }
 
     // 相对于0，尚未排序的第一个序号
-    size_t resIndex = index;
-    // 相对于字符串的起始，字符串中能够被接受的第一个字符的下标
-    size_t beginIndex = 0;
-    // 字符串中能够被接受的最后一个字符的下标
-    size_t endIndex = data.size();
-    if (index < _first_unassemble_byte) {
-        resIndex = _first_unassemble_byte;
-        beginIndex = _first_unassemble_byte - index;
-    }
-    if (index + data.size() >= first_unacceptable_byte) {
-        endIndex = first_unacceptable_byte - index;
-    }
-    std::string resData(data.begin() + beginIndex, data.begin() + endIndex);
-    //           | resData |
-    //        <---|iter|
-    auto iter = _unassembled.lower_bound(typeUnassembled(resIndex, std::move("")));
-    // 可能出现如下情况，因此需要用 while
-    // 后面的大量数据因乱序到达这里，需要用 set 保存起来
-    while (iter != _unassembled.begin()) {
-        // resIndex > _firstUnassembled
-        if (iter == _unassembled.end()) {
-            iter--;
+    return {max(index, _first_unassemble_byte), min(index + size, first_unacceptable_byte)};
+}
+
+void
+StreamReassembler::insert_in_window(const uint64_t index, Buffer data)
+{
+    const uint64_t end = index + data.size();
+
+    // 要保留的切片不能拖住整块接收缓冲区（bitmap 引擎会把乱序字节拷贝进 ring，不需要紧凑）
+    if (_engine != ReassemblerEngine::bitmap || index == _first_unassemble_byte) {
+        data.compact_if_sparse();
+    }
+
+    // 按序到达：直接把 Buffer 交给 `_output`，并丢掉被它覆盖的未排序字节
+    if (index == _first_unassemble_byte) {
+        if (_engine == ReassemblerEngine::bitmap) {
+            const size_t slot = index % _capacity;
+            const size_t first = min(data.size(), _capacity - slot);
+            _num_unassembled_byte -= clear_bits(slot, slot + first);
+            _num_unassembled_byte -= clear_bits(0, data.size() - first);
+            _first_unassemble_byte += _output.write(std::move(data));
+            return;
         }
-        if (merge_substring(
-                resIndex, resData, (*iter).index, (*iter).data)) {   // 返回值是删掉重合的bytes数
-            _num_unassembled_byte -= (*iter).data.size();
-            // 还多余一个字符
-            if (iter != _unassembled.begin()) {
-                _unassembled.erase(iter--);
-            } else {
-                _unassembled.erase(iter);
-                break;
-            }
-        } else {
-            // 没有重叠，说明前方的数据还未到达，直接退出
-            break;
+        if (_unassembled.empty() || _unassembled.begin()->first >= end) {
+            _first_unassemble_byte += _output.write(std::move(data));
+            return;
+        }
+    }
+
+    if (_engine == ReassemblerEngine::bitmap) {
+        insert_bitmap(index, data.str());
+    } else {
+        insert_unassembled(index, std::move(data));
+    }
+}
+
+void
+StreamReassembler::assemble()
+{
+    if (_engine == ReassemblerEngine::bitmap) {
+        assemble_bitmap();
+    } else {
+        assemble_contiguous();
+    }
+
+    // 如果所有数据已经被排好序 且 输入结束，告诉 byteStream 结束
+    if (_eof && _first_unassemble_byte == _eof_index) {
+        _output.end_input();
+    }
+}
+
+void
+StreamReassembler::insert_unassembled(uint64_t index, Buffer data)
+{
+    uint64_t end = index + data.size();
+
+    //   | prev |
+    //       | data |    ---> 去掉 data 前面重叠的部分
+    auto iter = _unassembled.upper_bound(index);
+    if (iter != _unassembled.begin()) {
+        const auto prev = std::prev(iter);
+        const uint64_t prev_end = prev->first + prev->second.size();
+        if (prev_end >= end) {
+            // 已经完整地保存过了
+            return;
+        }
+        if (prev_end > index) {
+            data.remove_prefix(prev_end - index);
+            index = prev_end;
         }
     }
 
-    //         ｜resData |
-    //          | iter ... | --->
-    iter = _unassembled.lower_bound(typeUnassembled(resIndex, std::move("")));
-    // 集合中即使序号最小的元素也比当前元素 data 的序号要大
-    // 向后遍历，看哪些字符串能被合并
-    while (iter != _unassembled.end()) {
-        if (merge_substring(resIndex, resData, (*iter).index, (*iter).data)) {
-            _num_unassembled_byte -= (*iter).data.size();
-            _unassembled.erase(iter++);
+    //   | data          |
+    //      | iter |  | iter ... |   ---> 删掉被完全覆盖的区间，裁掉与最后一个区间重叠的部分
+    while (iter != _unassembled.end() && iter->first < end) {
+        const uint64_t iter_end = iter->first + iter->second.size();
+        if (iter_end <= end) {
+            _num_unassembled_byte -= iter->second.size();
+            iter = _unassembled.erase(iter);
         } else {
+            data.remove_suffix(end - iter->first);
+            end = iter->first;
             break;
         }
     }
 
-    // 合并完了所有set中的元素后写入
-    if (resIndex == _first_unassemble_byte) {
-        size_t wSize = _output.write(resData);
-        if ((wSize == resData.size()) && eof) {
-            _eof = true;
-            _output.end_input();
-        }
+    if (data.size() > 0) {
+        _num_unassembled_byte += data.size();
+        _unassembled.emplace_hint(iter, index, std::move(data));
+    }
+}
+
+void
+StreamReassembler::assemble_contiguous()
+{
+    auto iter = _unassembled.begin();
+    while (iter != _unassembled.end() && iter->first == _first_unassemble_byte) {
+        // 窗口保证了这里一定能完整写入
+        const size_t wSize = _output.write(iter->second);
+        _num_unassembled_byte -= iter->second.size();
         _first_unassemble_byte += wSize;
+        iter = _unassembled.erase(iter);
+    }
+}
+
+void
+StreamReassembler::insert_bitmap(uint64_t index, string_view data)
+{
+    // 窗口不超过 _capacity，所以每个字节都有唯一的位置；最多绕回一次
+    const size_t slot = index % _capacity;
+    const size_t first = min(data.size(), _capacity - slot);
+    copy(data.begin(), data.begin() + first, _ring.begin() + slot);
+    copy(data.begin() + first, data.end(), _ring.begin());
+    _num_unassembled_byte += set_bits(slot, slot + first);
+    _num_unassembled_byte += set_bits(0, data.size() - first);
+}
+
+void
+StreamReassembler::assemble_bitmap()
+{
+    // 没有乱序字节时无事可做；容量为 0 的 ring 也从这里返回，不会对 0 取模
+    if (_num_unassembled_byte == 0) {
+        return;
+    }
+    const size_t slot = _first_unassemble_byte % _capacity;
+    size_t run = count_run(slot);
+    if (run == 0) {
+        return;
     }
-    if (!resData.empty() && resIndex > _first_unassemble_byte) {
-        _unassembled.insert(typeUnassembled(resIndex, resData));
-        _num_unassembled_byte += resData.size();
+    size_t wrapped = 0;
+    if (slot + run == _capacity) {
+        wrapped = min(count_run(0), slot);
     }
 
-    if (empty() && _eof) {
-        _output.end_input();
+    string bytes;
+    bytes.reserve(run + wrapped);
+    bytes.append(_ring, slot, run);
+    bytes.append(_ring, 0, wrapped);
+    clear_bits(slot, slot + run);
+    clear_bits(0, wrapped);
+
+    // 窗口保证了这里一定能完整写入
+    const size_t wSize = _output.write(Buffer(std::move(bytes)));
+    _num_unassembled_byte -= wSize;
+    _first_unassemble_byte += wSize;
+}
+
+size_t
+StreamReassembler::set_bits(size_t from, const size_t to)
+{
+    size_t newly_set = 0;
+    while (from < to) {
+        const size_t bit = from % 64;
+        const size_t width = min(to - from, 64 - bit);
+        const uint64_t mask = (width == 64 ? ~uint64_t(0) : ((uint64_t(1) << width) - 1)) << bit;
+        uint64_t& word = _present[from / 64];
+        newly_set += __builtin_popcountll(mask & ~word);
+        word |= mask;
+        from += width;
     }
-    return;
+    return newly_set;
 }
 
-bool
-StreamReassembler::merge_substring(size_t& index, std::string& data, size_t index2,
-                                   const std::string& data2)
-{
-    size_t l1 = index, r1 = l1 + data.size() - 1;
-    size_t l2 = index2, r2 = l2 + data2.size() - 1;
-    if (l2 > r1 + 1 || l1 > r2 + 1) {
-        return false;
-    }
-    index = min(l1, l2);
-    if (l1 <= l2) {
-        if (r2 > r1) {
-            data += std::string(data2.begin() + r1 - l2 + 1, data2.end());
+size_t
+StreamReassembler::clear_bits(size_t from, const size_t to)
+{
+    size_t cleared = 0;
+    while (from < to) {
+        const size_t bit = from % 64;
+        const size_t width = min(to - from, 64 - bit);
+        const uint64_t mask = (width == 64 ? ~uint64_t(0) : ((uint64_t(1) << width) - 1)) << bit;
+        uint64_t& word = _present[from / 64];
+        cleared += __builtin_popcountll(mask & word);
+        word &= ~mask;
+        from += width;
+    }
+    return cleared;
+}
+
+size_t
+StreamReassembler::count_run(const size_t from) const
+{
+    // 一次检查一个 64 位字：取反后 ctz 就是从当前位开始连续为 1 的位数
+    size_t pos = from;
+    while (pos < _capacity) {
+        const size_t bit = pos % 64;
+        const uint64_t missing = ~(_present[pos / 64] >> bit);
+        if (missing == 0) {
+            pos += 64;
+            continue;
         }
-    } else {
-        if (r1 > r2) {
-            data = data2 + std::string(data.begin() + r2 - l1 + 1, data.end());
+        const size_t ones = __builtin_ctzll(missing);
+        pos += ones;
+        if (ones < 64 - bit) {
+            break;
+        }
+    }
+    return min(pos, _capacity) - from;
+}
+
+size_t
+StreamReassembler::count_gap(const size_t from) const
+{
+    size_t pos = from;
+    while (pos < _capacity) {
+        const size_t bit = pos % 64;
+        const uint64_t present = _present[pos / 64] >> bit;
+        if (present == 0) {
+            pos += 64 - bit;
+            continue;
+        }
+        pos += __builtin_ctzll(present);
+        break;
+    }
+    return min(pos, _capacity) - from;
+}
+
+vector<pair<uint64_t, uint64_t>>
+StreamReassembler::unassembled_ranges() const
+{
+    vector<pair<uint64_t, uint64_t>> ranges;
+    if (_num_unassembled_byte == 0) {
+        return ranges;
+    }
+
+    // 相邻的区间合并成一个
+    const auto add = [&ranges](const uint64_t begin, const uint64_t end) {
+        if (!ranges.empty() && ranges.back().second == begin) {
+            ranges.back().second = end;
+        } else {
+            ranges.emplace_back(begin, end);
+        }
+    };
+
+    if (_engine == ReassemblerEngine::interval_map) {
+        for (const auto& [index, data] : _unassembled) {
+            add(index, index + data.size());
+        }
+        return ranges;
+    }
+
+    // 扫描窗口对应的位，每一步不越过 ring 的末尾
+    const uint64_t end = _first_unassemble_byte + _capacity - _output.buffer_size();
+    uint64_t index = _first_unassemble_byte;
+    while (index < end) {
+        const size_t pos = index % _capacity;
+        const size_t limit = min<uint64_t>(end - index, _capacity - pos);
+        const size_t run = min(count_run(pos), limit);
+        if (run > 0) {
+            add(index, index + run);
+            index += run;
         } else {
-            data = data2;
+            index += min(count_gap(pos), limit);
         }
     }
-    return true;
+    return ranges;
 }
 
 size_t
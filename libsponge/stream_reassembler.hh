@@ -1,23 +1,20 @@
 #ifndef SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
 #define SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
 
+#include "buffer.hh"
 #include "byte_stream.hh"
 
 #include <cstdint>
-#include <queue>
-#include <set>
+#include <map>
 #include <string>
-class typeUnassembled
+#include <utility>
+#include <vector>
+
+//! \brief Data structure used by a StreamReassembler to hold out-of-order bytes
+enum class ReassemblerEngine
 {
-public:
-    size_t index;
-    std::string data;
-    typeUnassembled(size_t _index, std::string _data) : index(_index), data(_data) {}
-    bool
-    operator<(const typeUnassembled& t1) const
-    {
-        return index < t1.index;
-    }
+    interval_map,   //!< ordered map of non-overlapping Buffer slices
+    bitmap          //!< `capacity`-byte ring plus a presence bitmap, allocated once
 };
 
 //! \brief A class that assembles a series of excerpts from a byte stream (possibly out of order,
@@ -25,28 +22,65 @@ public:
 class StreamReassembler
 {
 private:
+    ReassemblerEngine _engine;
     ByteStream _output;   //!< The reassembled in-order byte stream
-    // 所有未排序的字符串的集合
-    std::set<typeUnassembled> _unassembled;
+    //! 所有未排序的子串，key 为起始序号；各区间互不重叠，也不与已排序的字节重叠。
+    //! 子串是共享存储的 Buffer，裁剪重叠部分只需移动偏移量，不需要拷贝
+    std::map<uint64_t, Buffer> _unassembled;
     size_t _first_unassemble_byte;
     // 未被排序的字符个数，注意：集合 _unassembled 中有多少个字符这就是多少
     size_t _num_unassembled_byte;
     size_t _capacity;   //!< The maximum number of bytes
     bool _eof;
+    //! 流结束的位置（仅当 `_eof` 为 true 时有效）
+    uint64_t _eof_index;
+
+    //! 把 [index, index + data.size()) 放入 `_unassembled`，裁掉与已有区间重叠的部分
+    void insert_unassembled(uint64_t index, Buffer data);
+
+    //! 把从 `_first_unassemble_byte` 开始连续的子串写入 `_output`
+    void assemble_contiguous();
+
+    //! 记录 EOF，并把 [index, index + size) 裁剪到窗口内
+    std::pair<uint64_t, uint64_t> accept_range(uint64_t index, size_t size, bool eof);
+
+    //! 保存窗口内的子串；按序到达时直接写入 `_output`，不经过未排序的存储
+    void insert_in_window(uint64_t index, Buffer data);
+
+    //! 写出新连续的字节，并在需要时结束 `_output`
+    void assemble();
+
+    //! \name ReassemblerEngine::bitmap
+    //! 序号为 i 的字节保存在 `_ring[i % _capacity]`，`_present` 的第 i % _capacity 位表示它是否已到达
+    //!@{
+    std::string _ring{};
+    std::vector<uint64_t> _present{};
 
-    // 合并两个_Unassembled的子串
-    /*
-            l1 |      | r1
-            l2 |      | r2    --->  l |           | r
-    */
-    // \return 如果合并失败，返回 false，成功则返回 true
-    bool merge_substring(size_t& index, std::string& data, size_t index2, const std::string& data2);
+    //! 把 [index, index + data.size()) 拷贝到 ring 中的最终位置并标记
+    void insert_bitmap(uint64_t index, std::string_view data);
+
+    //! 把从 `_first_unassemble_byte` 开始连续存在的字节写入 `_output`
+    void assemble_bitmap();
+
+    //! 标记 [from, to) 位（不绕回），返回新标记的位数
+    size_t set_bits(size_t from, size_t to);
+
+    //! 清除 [from, to) 位（不绕回），返回原本被标记的位数
+    size_t clear_bits(size_t from, size_t to);
+
+    //! 从第 `from` 位开始（不绕回）连续被标记的位数
+    size_t count_run(size_t from) const;
+
+    //! 从第 `from` 位开始（不绕回）连续未被标记的位数
+    size_t count_gap(size_t from) const;
+    //!@}
 
 public:
     //! \brief Construct a `StreamReassembler` that will store up to `capacity` bytes.
     //! \note This capacity limits both the bytes that have been reassembled,
     //! and those that have not yet been reassembled.
-    StreamReassembler(const size_t capacity);
+    StreamReassembler(const size_t capacity,
+                      const ReassemblerEngine engine = ReassemblerEngine::interval_map);
 
     //! \brief Receives a substring and writes any newly contiguous bytes into the stream.
     //!
@@ -60,6 +94,11 @@ public:
     //! \param eof whether or not this segment ends with the end of the stream
     void push_substring(const std::string& data, const uint64_t index, const bool eof);
 
+    //! \brief Like push_substring(const std::string&, uint64_t, bool), but shares `data`'s storage.
+    //! \details A substring that starts at first_unassembled_byte() goes straight into the
+    //! output stream without being copied.
+    void push_substring(Buffer data, const uint64_t index, const bool eof);
+
     //! \name Access the reassembled byte stream
     //!@{
     const ByteStream&
@@ -90,9 +129,20 @@ public:
         return _eof;
     }
 
+    //! \brief Stored but not yet reassembled bytes, as maximal [begin, end) ranges of stream
+    //! indices in increasing order (what a receiver reports in SACK blocks)
+    std::vector<std::pair<uint64_t, uint64_t>> unassembled_ranges() const;
+
     //! \brief Is the internal state empty (other than the output stream)?
     //! \returns `true` if no substrings are waiting to be assembled
     bool empty() const;
+
+    //! \brief Data structure chosen at construction
+    ReassemblerEngine
+    engine() const
+    {
+        return _engine;
+    }
 };
 
 #endif   // SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
@@ -29,6 +29,48 @@ TCPConnection::time_since_last_segment_received() const
     return _time_since_last_segment_received;
 }
 
+optional<uint64_t>
+TCPConnection::time_until_next_timer() const
+{
+    if (!active()) {
+        return nullopt;
+    }
+    // tick() 一被调用就会处理这两种情况
+    if (closed_without_linger() || (streams_finished() && !_linger_timer.has_value())) {
+        return 0;
+    }
+    const auto sender = _sender.time_until_next_timer();
+    const auto linger = _timers.time_until_next_expiration();
+    if (sender.has_value() && linger.has_value()) {
+        return min(sender.value(), linger.value());
+    }
+    return sender.has_value() ? sender : linger;
+}
+
+bool
+TCPConnection::closed_without_linger() const
+{
+    return !_linger_after_streams_finish && _sender.fin_sent() && _sender.bytes_in_flight() == 0;
+}
+
+bool
+TCPConnection::streams_finished() const
+{
+    return _receiver.stream_out().eof() && _sender.stream_in().eof() && _sender.fin_sent() &&
+           _sender.bytes_in_flight() == 0;
+}
+
+uint8_t
+TCPConnection::window_shift() const
+{
+    uint8_t shift = 0;
+    while (shift < TCPHeader::MAX_WSCALE &&
+           (_cfg.recv_capacity >> shift) > numeric_limits<uint16_t>::max()) {
+        shift++;
+    }
+    return shift;
+}
+
 void
 TCPConnection::set_ack_and_window(TCPSegment& seg)
 {
@@ -37,11 +79,32 @@ TCPConnection::set_ack_and_window(TCPSegment& seg)
         seg.header().ackno = _receiver.ackno().value();
     }
 
-    if (_receiver.window_size() < numeric_limits<uint16_t>::max()) {
-        seg.header().win = _receiver.window_size();
+    // SYN 中的窗口从不扩大
+    const size_t window = _receiver.window_size() >> (seg.header().syn ? 0 : _rcv_wscale);
+    if (window < numeric_limits<uint16_t>::max()) {
+        seg.header().win = window;
     } else {
         seg.header().win = numeric_limits<uint16_t>::max();
     }
+
+    // 主动打开时在 SYN 中提议使用选项；被动打开时只有对方提议了才回应
+    const bool active_syn = seg.header().syn && !_receiver.ackno().has_value();
+    if (seg.header().syn && (_window_scaling || (active_syn && _cfg.window_scaling))) {
+        seg.header().ws = true;
+        seg.header().wscale = window_shift();
+    }
+    if (_timestamps || (active_syn && _cfg.timestamps)) {
+        seg.header().ts = true;
+        seg.header().tsval = _sender.timestamp();
+        seg.header().tsecr = _ts_recent;
+    }
+    if (seg.header().syn && (_sack || (active_syn && _cfg.sack))) {
+        seg.header().sack_permitted = true;
+    }
+    if (_sack && seg.header().ack) {
+        seg.header().sack = _receiver.sack_blocks(
+            seg.header().ts ? TCPHeader::MAX_SACK_BLOCKS_WITH_TS : TCPHeader::MAX_SACK_BLOCKS);
+    }
 }
 
 void
@@ -49,6 +112,23 @@ TCPConnection::segment_received(const TCPSegment& seg)
 {
     // 收到报文，计时器置零
     _time_since_last_segment_received = 0;
+    // 用于判断本次是否已经回复过 ACK
+    const size_t segments_queued = _segments_out.size();
+    if (_linger_timer.has_value() && _timers.cancel(_linger_timer.value())) {
+        _linger_timer = _timers.schedule(10 * _cfg.rt_timeout);
+    }
+
+    // 时间戳、窗口扩大 (RFC 7323) 与 SACK (RFC 2018) 只有双方的 SYN 中都带有时才启用
+    if (seg.header().syn) {
+        _timestamps = _cfg.timestamps && seg.header().ts;
+        _sack = _cfg.sack && seg.header().sack_permitted;
+        _window_scaling = _cfg.window_scaling && seg.header().ws;
+        _rcv_wscale = _window_scaling ? window_shift() : 0;
+        _snd_wscale = _window_scaling ? seg.header().wscale : 0;
+    }
+    if (_timestamps && seg.header().ts) {
+        _ts_recent = seg.header().tsval;
+    }
 
     // 收到报文，需要将其转交给receiver程序，更新ACK
     _receiver.segment_received(seg);
@@ -107,12 +187,22 @@ TCPConnection::segment_received(const TCPSegment& seg)
         if (!_sender.syn_sent()) {
             return;
         }
-        if (_sender.ack_received(seg.header().ackno, seg.header().win)) {
+        AckExtras extras{};
+        if (_timestamps && seg.header().ts) {
+            extras.echoed_timestamp = seg.header().tsecr;
+        }
+        if (_sack) {
+            extras.sack = seg.header().sack;
+        }
+        extras.carries_data = seg.length_in_sequence_space() > 0;
+        const uint64_t window = uint64_t{seg.header().win}
+                                << (seg.header().syn ? 0 : _snd_wscale);
+        if (_sender.ack_received(seg.header().ackno, window, extras)) {
             _sender.fill_window();
             while (!_sender.segments_out().empty()) {
-                TCPSegment segment = _sender.segments_out().front();
+                TCPSegment segment = std::move(_sender.segments_out().front());
                 _sender.segments_out().pop();
-                send_segment(segment);
+                send_segment(std::move(segment));
             }
         } else {
             // 根据测试用例：fsm_ack_rst_relaxed: ack/rst in SYN_SENT
@@ -121,10 +211,10 @@ TCPConnection::segment_received(const TCPSegment& seg)
             }
             // 根据测试用例：fsm_ack_rst_relaxed: ack in the future -> sent ack back
             _sender.send_empty_segment();
-            TCPSegment segment = _sender.segments_out().front();
+            TCPSegment segment = std::move(_sender.segments_out().front());
             _sender.segments_out().pop();
             set_ack_and_window(segment);
-            _segments_out.push(segment);
+            _segments_out.push(std::move(segment));
         }
     }
 
@@ -134,17 +224,27 @@ TCPConnection::segment_received(const TCPSegment& seg)
 
         if (_sender.segments_out().empty()) {
             _sender.send_empty_segment();
-            TCPSegment segment = _sender.segments_out().front();
+            TCPSegment segment = std::move(_sender.segments_out().front());
             _sender.segments_out().pop();
             set_ack_and_window(segment);
-            _segments_out.push(segment);
+            _segments_out.push(std::move(segment));
         } else {
             while (!_sender.segments_out().empty()) {
-                TCPSegment segment = _sender.segments_out().front();
+                TCPSegment segment = std::move(_sender.segments_out().front());
                 _sender.segments_out().pop();
-                send_segment(segment);
+                send_segment(std::move(segment));
             }
         }
+    } else if (_receiver.ackno().has_value() && seg.header().seqno == _receiver.ackno().value() - 1
+               && _segments_out.size() == segments_queued) {
+        // keep-alive 或零窗口探测报文：序号在 ackno 之前一字节且不占序号空间，
+        // 回复一个 ACK 告知当前窗口，否则对端在窗口打开后也不会再发送数据。
+        // 上面已经发出过报文（例如对未来 ACK 的回复）时，它已带有 ACK 与窗口，不再重复
+        _sender.send_empty_segment();
+        TCPSegment segment = std::move(_sender.segments_out().front());
+        _sender.segments_out().pop();
+        set_ack_and_window(segment);
+        _segments_out.push(std::move(segment));
     }
 }
 
@@ -161,19 +261,31 @@ TCPConnection::write(const string& data)
     _sender.fill_window();
     // 能取的都取出去
     while (!_sender.segments_out().empty()) {
-        TCPSegment segment = _sender.segments_out().front();
+        TCPSegment segment = std::move(_sender.segments_out().front());
         _sender.segments_out().pop();
-        send_segment(segment);
+        send_segment(std::move(segment));
+    }
+    return length;
+}
+
+size_t
+TCPConnection::write(Buffer data)
+{
+    size_t length = _sender.stream_in().write(std::move(data));
+    _sender.fill_window();
+    while (!_sender.segments_out().empty()) {
+        TCPSegment segment = std::move(_sender.segments_out().front());
+        _sender.segments_out().pop();
+        send_segment(std::move(segment));
     }
     return length;
 }
 
 void
-TCPConnection::send_segment(const TCPSegment& segment)
+TCPConnection::send_segment(TCPSegment segment)
 {
-    TCPSegment seg = segment;
-    set_ack_and_window(seg);
-    _segments_out.push(seg);
+    set_ack_and_window(segment);
+    _segments_out.push(std::move(segment));
 }
 
 void
@@ -185,12 +297,12 @@ TCPConnection::send_reset_segment()
     }
     _sender.send_empty_segment();
     // 取出空的报文
-    auto segment = _sender.segments_out().front();
+    auto segment = std::move(_sender.segments_out().front());
     _sender.segments_out().pop();
 
     segment.header().rst = true;
 
-    send_segment(segment);
+    send_segment(std::move(segment));
     _if_active = false;
     _receiver.stream_out().set_error();
     _sender.stream_in().set_error();
@@ -206,7 +318,7 @@ TCPConnection::tick(const size_t ms_since_last_tick)
 
     // 超时重传
     if (!_sender.segments_out().empty()) {
-        TCPSegment segment = _sender.segments_out().front();
+        TCPSegment segment = std::move(_sender.segments_out().front());
         _sender.segments_out().pop();
         set_ack_and_window(segment);
         if (_sender.consecutive_retransmissions() > TCPConfig::MAX_RETX_ATTEMPTS) {
@@ -215,14 +327,14 @@ TCPConnection::tick(const size_t ms_since_last_tick)
             _sender.stream_in().set_error();
             segment.header().rst = true;
         }
-        _segments_out.push(segment);
+        _segments_out.push(std::move(segment));
     }
 
     // 半连接关闭，需要满足以下条件：
     // 1. 接收端先关闭（半连接，由 _linger_after_streams_finish 负责）
     // 2. 发送端已经发送 FIN
     // 3. 发送端缓冲区为0
-    if (!_linger_after_streams_finish && _sender.fin_sent() && _sender.bytes_in_flight() == 0) {
+    if (closed_without_linger()) {
         _if_active = false;
     }
 
@@ -230,12 +342,15 @@ TCPConnection::tick(const size_t ms_since_last_tick)
     // 1. receiver 中字节流已经被全部整流并且收到了 EOF
     // 2. sender 已经被关闭并且全部字节流发送给了另一个端点
     // 3. sender 中所有字节被确认
-    if (_receiver.stream_out().eof() && _sender.stream_in().eof() && _sender.fin_sent() &&
-        _sender.bytes_in_flight() == 0) {
-        if (_time_since_last_segment_received >= 10 * _cfg.rt_timeout) {
-            _if_active = false;
-        }
+    // 从最后一次收到报文的时间开始计时
+    if (streams_finished() && !_linger_timer.has_value()) {
+        const uint64_t last_received =
+            _timers.now() + ms_since_last_tick - _time_since_last_segment_received;
+        _linger_timer = _timers.schedule_at(last_received + 10 * _cfg.rt_timeout);
     }
+    _timers.advance(ms_since_last_tick, [this](TimerWheel::TimerId, uint64_t) {
+        _if_active = false;
+    });
 }
 
 void
@@ -244,9 +359,9 @@ TCPConnection::end_input_stream()
     _sender.stream_in().end_input();
     _sender.fill_window();
     while (!_sender.segments_out().empty()) {
-        TCPSegment segment = _sender.segments_out().front();
+        TCPSegment segment = std::move(_sender.segments_out().front());
         _sender.segments_out().pop();
-        send_segment(segment);
+        send_segment(std::move(segment));
     }
 }
 
@@ -255,7 +370,7 @@ TCPConnection::connect()
 {
     _sender.fill_window();
     while (!_sender.segments_out().empty()) {
-        send_segment(_sender.segments_out().front());
+        send_segment(std::move(_sender.segments_out().front()));
         _sender.segments_out().pop();
     }
 }
@@ -5,6 +5,7 @@
 #include "tcp_receiver.hh"
 #include "tcp_sender.hh"
 #include "tcp_state.hh"
+#include "timer_wheel.hh"
 
 //! \brief A complete endpoint of a TCP connection
 class TCPConnection
@@ -12,7 +13,7 @@ class TCPConnection
 private:
     TCPConfig _cfg;
     TCPReceiver _receiver{_cfg.recv_capacity};
-    TCPSender _sender{_cfg.send_capacity, _cfg.rt_timeout, _cfg.fixed_isn};
+    TCPSender _sender{_cfg};
 
     //! outbound queue of segments that the TCPConnection wants sent
     std::queue<TCPSegment> _segments_out{};
@@ -28,14 +29,44 @@ private:
     //! the time interval since last segment received.
     size_t _time_since_last_segment_received{};
 
+    //! 定时器，随 tick 推进
+    TimerWheel _timers{};
+
+    //! 两个字节流都结束后开始的 linger 计时（10 * rt_timeout），每收到一个报文就重新计时
+    std::optional<TimerWheel::TimerId> _linger_timer{};
+
+    //! 双方的 SYN 都带有时间戳选项，之后每个报文都携带时间戳
+    bool _timestamps{false};
+
+    //! 最近收到的对方时间戳，作为 tsecr 回显
+    uint32_t _ts_recent{0};
+
+    //! 双方的 SYN 都带有 SACK-permitted 选项，之后的 ACK 携带 SACK 块
+    bool _sack{false};
+
+    //! 双方的 SYN 都带有窗口扩大选项 (RFC 7323)：
+    //! 通告窗口时右移 `_rcv_wscale` 位，收到的窗口左移 `_snd_wscale` 位
+    bool _window_scaling{false};
+    uint8_t _rcv_wscale{0};
+    uint8_t _snd_wscale{0};
+
+    //! 使 `recv_capacity` 能用 16 位窗口表示的最小移位数
+    uint8_t window_shift() const;
+
     //! \brief the helper function for setting the sending segments'
     //! acknowledge number and window size
     void set_ack_and_window(TCPSegment& seg);
 
-    void send_segment(const TCPSegment& segment);
+    void send_segment(TCPSegment segment);
 
     void send_reset_segment();
 
+    //! 对方先关闭、无需 linger：自己的 FIN 被确认后即可结束
+    bool closed_without_linger() const;
+
+    //! 两个字节流都已结束且全部确认，可以开始 linger 计时
+    bool streams_finished() const;
+
 public:
     //! \name "Input" interface for the writer
     //!@{
@@ -47,6 +78,10 @@ public:
     //! \returns the number of bytes from `data` that were actually written.
     size_t write(const std::string& data);
 
+    //! \brief Write a Buffer to the outbound byte stream without copying it
+    //! \returns the number of bytes from `data` that were actually written.
+    size_t write(Buffer data);
+
     //! \returns the number of `bytes` that can be written right now.
     size_t remaining_outbound_capacity() const;
 
@@ -63,6 +98,11 @@ public:
     {
         return _receiver.stream_out();
     }
+    const ByteStream&
+    inbound_stream() const
+    {
+        return _receiver.stream_out();
+    }
     //!@}
 
     //! \name Accessors used for testing
@@ -74,6 +114,21 @@ public:
     size_t unassembled_bytes() const;
     //! \brief Number of milliseconds since the last segment was received
     size_t time_since_last_segment_received() const;
+    //! \brief Milliseconds until tick() may have work to do (a retransmission, or the end of
+    //! lingering), or `nullopt` if nothing will happen until a segment arrives or data is written
+    std::optional<uint64_t> time_until_next_timer() const;
+    //! \brief Round-trip time measurements and the current RTO of the sender
+    RTTStatistics
+    rtt_statistics() const
+    {
+        return _sender.rtt_statistics();
+    }
+    //! \brief Fast recoveries, timeouts and retransmissions of the sender
+    RecoveryStatistics
+    recovery_statistics() const
+    {
+        return _sender.recovery_statistics();
+    }
     //!< \brief summarize the state of the sender, receiver, and the connection
     TCPState
     state() const
@@ -7,7 +7,9 @@
 using namespace std;
 
 //! \details This function first attempts to parse a TCP segment from the next UDP
-//! payload recv()d from the socket.
+//! payload recv()d from the socket. Datagrams are received in batches; while read_pending()
+//! is `true`, read() returns the rest of the batch without a system call. A GRO-coalesced
+//! payload is split back into its datagrams without copying.
 //!
 //! If this succeeds, it then checks that the received segment is related to the
 //! current connection. When a TCP connection has been established, this means
@@ -21,23 +23,42 @@ using namespace std;
 optional<TCPSegment>
 TCPOverUDPSocketAdapter::read()
 {
-    auto datagram = _sock.recv();
+    if (_coalesced.size() == 0) {
+        if (not read_pending()) {
+            _next_received = 0;
+            _received_count = _sock.recv_batch(_received);
+            if (_received_count == 0) {
+                return {};
+            }
+        }
+        auto& datagram = _received[_next_received++];
+        _segment_size = datagram.segment_size != 0 ? datagram.segment_size : datagram.payload.size();
+        _coalesced_source = datagram.source_address;
+        _coalesced = Buffer(move(datagram.payload));
+    }
+
+    // the next datagram is a slice of the (possibly coalesced) payload
+    Buffer payload = _coalesced;
+    if (payload.size() > _segment_size) {
+        payload.remove_suffix(payload.size() - _segment_size);
+    }
+    _coalesced.remove_prefix(payload.size());
 
     // is it for us?
-    if (not listening() and (datagram.source_address != config().destination)) {
+    if (not listening() and (_coalesced_source != config().destination)) {
         return {};
     }
 
     // is the payload a valid TCP segment?
     TCPSegment seg;
-    if (ParseResult::NoError != seg.parse(move(datagram.payload), 0)) {
+    if (ParseResult::NoError != seg.parse(payload, 0)) {
         return {};
     }
 
     // should we target this source in all future replies?
     if (listening()) {
         if (seg.header().syn and not seg.header().rst) {
-            config_mutable().destination = datagram.source_address;
+            config_mutable().destination = _coalesced_source;
             set_listening(false);
         } else {
             return {};
@@ -47,14 +68,68 @@ TCPOverUDPSocketAdapter::read()
     return seg;
 }
 
-//! Serialize a TCP segment and send it as the payload of a UDP datagram.
+//! Serialize a TCP segment and queue it as the payload of a UDP datagram.
 //! \param[in] seg is the TCP segment to write
 void
 TCPOverUDPSocketAdapter::write(TCPSegment& seg)
 {
     seg.header().sport = config().source.port();
     seg.header().dport = config().destination.port();
-    _sock.sendto(config().destination, seg.serialize(0));
+    _unsent.push_back(seg.serialize(0));
+    if (_unsent.size() == BATCH_SIZE) {
+        flush();
+    }
+}
+
+//! \details With offload on, each run of equal-size segments (which may end in one shorter
+//! segment, e.g. the end of a window) goes to the kernel as one payload that UDP GSO cuts back
+//! into datagrams.
+void
+TCPOverUDPSocketAdapter::flush()
+{
+    if (_unsent.empty()) {
+        return;
+    }
+    if (not _offload) {
+        const vector<BufferViewList> payloads(_unsent.begin(), _unsent.end());
+        _sock.send_batch(config().destination, payloads);
+        _unsent.clear();
+        return;
+    }
+
+    vector<BufferViewList> payloads;
+    vector<uint16_t> segment_sizes;
+    for (size_t first = 0; first < _unsent.size();) {
+        const size_t size = _unsent[first].size();
+        BufferViewList payload{_unsent[first]};
+        size_t total = size;
+        size_t last = first + 1;
+        while (last < _unsent.size() and last - first < MAX_GSO_SEGMENTS and
+               _unsent[last].size() <= size and total + _unsent[last].size() <= MAX_GSO_PAYLOAD) {
+            for (const auto& buffer : _unsent[last].buffers()) {
+                payload.append(buffer);
+            }
+            total += _unsent[last].size();
+            // a shorter segment ends the run
+            if (_unsent[last++].size() < size) {
+                break;
+            }
+        }
+        payloads.push_back(move(payload));
+        segment_sizes.push_back(last - first > 1 ? static_cast<uint16_t>(size) : 0);
+        first = last;
+    }
+    _sock.send_batch(config().destination, payloads, segment_sizes);
+    _unsent.clear();
+}
+
+//! \param[in] offload whether to use UDP GSO for sending and GRO for receiving
+//! \note Throws unix_error if the kernel lacks UDP GRO (before Linux 5.0)
+void
+TCPOverUDPSocketAdapter::set_offload(const bool offload)
+{
+    _sock.set_gro(offload);
+    _offload = offload;
 }
 
 //! Specialize LossyFdAdapter to TCPOverUDPSocketAdapter
@@ -8,8 +8,10 @@
 #include "tcp_header.hh"
 #include "tcp_segment.hh"
 
+#include <cstddef>
 #include <optional>
 #include <utility>
+#include <vector>
 
 //! \brief Basic functionality for file descriptor adaptors
 //! \details See TCPOverUDPSocketAdapter and TCPOverIPv4OverTunFdAdapter for more information.
@@ -40,13 +42,51 @@ class FdAdapterBase {
 
     //! Called periodically when time elapses
     void tick(const size_t) {}
+
+    //! Milliseconds until tick() has work to do; plain adapters never do
+    std::optional<uint64_t> time_until_next_timer() const { return {}; }
+
+    //! Has the adapter already received datagrams that read() has not returned yet?
+    bool read_pending() const { return false; }
+
+    //! Send whatever write() has held back; plain adapters send right away
+    void flush() {}
 };
 
 //! \brief A FD adaptor that reads and writes TCP segments in UDP payloads
 class TCPOverUDPSocketAdapter : public FdAdapterBase {
   private:
+    //! Datagrams received and sent per system call
+    static constexpr size_t BATCH_SIZE = 64;
+
+    //! \name Limits on one payload handed to the kernel for GSO (Linux allows 64 segments, 128 since 6.2)
+    //!@{
+    static constexpr size_t MAX_GSO_SEGMENTS = 64;
+    static constexpr size_t MAX_GSO_PAYLOAD = 65000;
+    //!@}
+
     UDPSocket _sock;
 
+    //! Send runs of equal-size segments as one GSO payload, and receive GRO-coalesced ones?
+    bool _offload = false;
+
+    //! \name Datagrams received by the last recv_batch(), of which read() has returned the first `_next_received`
+    //!@{
+    std::vector<UDPSocket::received_datagram> _received = std::vector<UDPSocket::received_datagram>(BATCH_SIZE);
+    size_t _received_count = 0;
+    size_t _next_received = 0;
+    //!@}
+
+    //! \name The rest of the received payload that read() is splitting into `_segment_size` datagrams
+    //!@{
+    Buffer _coalesced{};
+    size_t _segment_size = 0;
+    Address _coalesced_source{};
+    //!@}
+
+    //! Serialized segments that write() has held back until the next flush()
+    std::vector<BufferList> _unsent{};
+
   public:
     //! Construct from a UDPSocket sliced into a FileDescriptor
     explicit TCPOverUDPSocketAdapter(UDPSocket &&sock) : _sock(std::move(sock)) {}
@@ -54,9 +94,18 @@ class TCPOverUDPSocketAdapter : public FdAdapterBase {
     //! Attempts to read and return a TCP segment related to the current connection from a UDP payload
     std::optional<TCPSegment> read();
 
-    //! Writes a TCP segment into a UDP payload
+    //! Writes a TCP segment into a UDP payload, sent at the next flush() (or once a batch is full)
     void write(TCPSegment &seg);
 
+    //! Are datagrams from the last batch still waiting to be read()?
+    bool read_pending() const { return _next_received < _received_count or _coalesced.size() > 0; }
+
+    //! Turn UDP GSO and GRO on or off (see UDPSocket::set_gro)
+    void set_offload(const bool offload);
+
+    //! Send the segments write() has held back, with one system call per batch
+    void flush();
+
     //! Access the underlying UDP socket
     operator UDPSocket &() { return _sock; }
 
@@ -3,6 +3,7 @@
 #include "parser.hh"
 #include "util.hh"
 
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 
@@ -12,9 +13,15 @@ ParseResult
 IPv4Datagram::parse(const Buffer buffer)
 {
     NetParser p{buffer};
-    _header.parse(p);
+    const ParseResult header_result = _header.parse(p);
     _payload = p.buffer();
 
+    _wire_fields.reset();
+    if (header_result == ParseResult::NoError and _header.hlen * 4 == IPv4Header::LENGTH) {
+        _wire_fields = _header;
+        copy_n(buffer.str().data(), IPv4Header::LENGTH, _wire_header.begin());
+    }
+
     if (_payload.size() != _header.payload_length()) {
         return ParseResult::PacketTooShort;
     }
@@ -22,6 +29,20 @@ IPv4Datagram::parse(const Buffer buffer)
     return p.get_error();
 }
 
+//! \details The checksum field is not compared: serialize() recomputes it anyway when the wire format
+//! cannot be used, and the wire format's checksum is always correct.
+bool
+IPv4Datagram::wire_matches() const
+{
+    if (not _wire_fields.has_value()) {
+        return false;
+    }
+    const IPv4Header& w = _wire_fields.value();
+    return w.ver == _header.ver and w.hlen == _header.hlen and w.tos == _header.tos and w.len == _header.len
+           and w.id == _header.id and w.df == _header.df and w.mf == _header.mf and w.offset == _header.offset
+           and w.ttl == _header.ttl and w.proto == _header.proto and w.src == _header.src and w.dst == _header.dst;
+}
+
 BufferList
 IPv4Datagram::serialize() const
 {
@@ -29,6 +50,12 @@ IPv4Datagram::serialize() const
         throw runtime_error("IPv4Datagram::serialize: payload is wrong size");
     }
 
+    if (wire_matches()) {
+        BufferList ret{string(_wire_header.data(), _wire_header.size())};
+        ret.append(_payload);
+        return ret;
+    }
+
     IPv4Header header_out = _header;
     header_out.cksum = 0;
     const string header_zero_checksum = header_out.serialize();
@@ -43,3 +70,29 @@ IPv4Datagram::serialize() const
     ret.append(_payload);
     return ret;
 }
+
+void
+IPv4Datagram::decrement_ttl()
+{
+    const bool kept = wire_matches();
+
+    // RFC 1624, eqn. 3: HC' = ~(~HC + ~m + m'), where m is the 16-bit word holding TTL and protocol
+    const uint16_t old_word = (uint16_t{_header.ttl} << 8) | _header.proto;
+    _header.ttl--;
+    const uint16_t new_word = (uint16_t{_header.ttl} << 8) | _header.proto;
+    const uint16_t old_cksum = kept ? _wire_fields->cksum : _header.cksum;
+    uint32_t sum = uint16_t(~old_cksum) + uint16_t(~old_word) + uint32_t{new_word};
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    _header.cksum = ~sum;
+
+    if (not kept) {
+        _wire_fields.reset();
+        return;
+    }
+    // patch the wire format in place: TTL is byte 8, the checksum bytes 10 and 11
+    _wire_fields = _header;
+    _wire_header[8] = static_cast<char>(_header.ttl);
+    _wire_header[10] = static_cast<char>(_header.cksum >> 8);
+    _wire_header[11] = static_cast<char>(_header.cksum & 0xff);
+}
@@ -4,12 +4,27 @@
 #include "buffer.hh"
 #include "ipv4_header.hh"
 
+#include <array>
+#include <optional>
+
 //! \brief [IPv4](\ref rfc::rfc791) Internet datagram
 class IPv4Datagram {
   private:
     IPv4Header _header{};
     BufferList _payload{};
 
+    //! \name Wire format of a parsed header
+    //! The header fields as parse() found them (or as decrement_ttl() left them), and their
+    //! serialized bytes. serialize() copies the bytes instead of rebuilding the header and its
+    //! checksum, as long as `_header` still has the same fields. Not kept for headers with options.
+    //!@{
+    std::optional<IPv4Header> _wire_fields{};
+    std::array<char, IPv4Header::LENGTH> _wire_header{};
+    //!@}
+
+    //! \brief Whether `_wire_header` is the serialization of `_header`
+    bool wire_matches() const;
+
   public:
     //! \brief Parse the segment from a string
     ParseResult parse(const Buffer buffer);
@@ -17,6 +32,10 @@ class IPv4Datagram {
     //! \brief Serialize the segment to a string
     BufferList serialize() const;
 
+    //! \brief Decrement the TTL (which must be positive), and update the checksum incrementally
+    //! (RFC 1624) in the header and in the wire format kept from parse()
+    void decrement_ttl();
+
     //! \name Accessors
     //!@{
     const IPv4Header &header() const { return _header; }
@@ -66,6 +66,11 @@ class LossyFdAdapter {
     void tick(const size_t ms_since_last_tick) {
         _adapter.tick(ms_since_last_tick);
     }  //!< FdAdapterBase::tick passthrough
+    std::optional<uint64_t> time_until_next_timer() const {
+        return _adapter.time_until_next_timer();
+    }  //!< FdAdapterBase::time_until_next_timer passthrough
+    bool read_pending() const { return _adapter.read_pending(); }        //!< FdAdapterBase::read_pending passthrough
+    void flush() { _adapter.flush(); }                                   //!< FdAdapterBase::flush passthrough
     //!@}
 };
 
@@ -0,0 +1,145 @@
+#include "sharded_tcp_stack.hh"
+
+#include "ipv4_datagram.hh"
+#include "parser.hh"
+#include "util.hh"
+
+#include <iostream>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+ShardedTCPStack::ShardedTCPStack(vector<FileDescriptor>&& datagrams, const Address& local_address,
+                                 const TCPConfig& config, const Setup& setup)
+{
+    if (datagrams.empty()) {
+        throw runtime_error("ShardedTCPStack: needs at least one fd");
+    }
+
+    // every queue exists before any thread starts, so that the first datagrams can be handed off
+    for (auto& fd : datagrams) {
+        _shards.push_back(make_unique<Shard>(
+            move(fd), FileDescriptor(SystemCall("eventfd", ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)))));
+    }
+    for (auto& shard : _shards) {
+        for (size_t source = 0; source < _shards.size(); source++) {
+            shard->inbound.push_back(make_unique<SPSCQueue<string>>(HANDOFF_CAPACITY));
+        }
+    }
+
+    for (size_t i = 0; i < _shards.size(); i++) {
+        _shards[i]->thread = thread(&ShardedTCPStack::run, this, i, local_address, config, setup);
+    }
+}
+
+ShardedTCPStack::~ShardedTCPStack()
+{
+    try {
+        stop();
+    } catch (const exception& e) {
+        cerr << "Exception destructing ShardedTCPStack: " << e.what() << endl;
+    }
+}
+
+void
+ShardedTCPStack::ring(const Shard& shard)
+{
+    const uint64_t one = 1;
+    SystemCall("write", ::write(shard.doorbell.fd_num(), &one, sizeof(one)));
+}
+
+void
+ShardedTCPStack::stop()
+{
+    _stop.store(true);
+    for (auto& shard : _shards) {
+        if (shard->thread.joinable()) {
+            ring(*shard);
+            shard->thread.join();
+        }
+    }
+    if (_error) {
+        rethrow_exception(exchange(_error, nullptr));
+    }
+}
+
+//! \param[in] from the shard that read the datagram
+//! \param[in] tuple the datagram's connection, as seen by this end
+//! \param[in] datagram the serialized IPv4 datagram
+void
+ShardedTCPStack::hand_off(const size_t from, const FourTuple& tuple, string&& datagram)
+{
+    Shard& owner = *_shards[shard_of(tuple, _shards.size())];
+    SPSCQueue<string>& queue = *owner.inbound[from];
+    if (not queue.push(move(datagram))) {
+        _shards[from]->dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    _shards[from]->handed_off.fetch_add(1, memory_order_relaxed);
+    if (queue.pushed_into_empty()) {
+        ring(owner);
+    }
+}
+
+void
+ShardedTCPStack::run(const size_t index, const Address& local_address, const TCPConfig& config,
+                     const Setup& setup)
+{
+    try {
+        Shard& shard = *_shards[index];
+        TCPStack stack{move(shard.datagrams), local_address, config};
+        const size_t shard_count = _shards.size();
+        stack.set_steering(
+            [index, shard_count](const FourTuple& tuple) { return shard_of(tuple, shard_count) == index; },
+            [this, index](const FourTuple& tuple, string&& datagram) {
+                hand_off(index, tuple, move(datagram));
+            });
+
+        // datagrams handed off by the other shards (or just a wakeup from stop())
+        stack.event_loop().add_rule(shard.doorbell, Direction::In, [&] {
+            shard.doorbell.read(sizeof(uint64_t));
+            for (auto& queue : shard.inbound) {
+                while (auto datagram = queue->pop()) {
+                    InternetDatagram dgram;
+                    if (dgram.parse(Buffer(move(datagram.value()))) == ParseResult::NoError) {
+                        stack.datagram_received(dgram);
+                    }
+                }
+            }
+        });
+
+        setup(stack, index);
+        while (not _stop.load()) {
+            stack.wait_next_event(-1);
+        }
+    } catch (const exception& e) {
+        cerr << "Exception in ShardedTCPStack shard " << index << ": " << e.what() << "\n";
+        // the first error is rethrown by stop(); the other shards keep going until then
+        if (not _failed.exchange(true)) {
+            _error = current_exception();
+        }
+    }
+}
+
+uint64_t
+ShardedTCPStack::handoffs() const
+{
+    uint64_t total = 0;
+    for (const auto& shard : _shards) {
+        total += shard->handed_off.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t
+ShardedTCPStack::handoff_drops() const
+{
+    uint64_t total = 0;
+    for (const auto& shard : _shards) {
+        total += shard->dropped.load(memory_order_relaxed);
+    }
+    return total;
+}
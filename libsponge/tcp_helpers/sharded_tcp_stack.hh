@@ -0,0 +1,110 @@
+#ifndef SPONGE_LIBSPONGE_SHARDED_TCP_STACK_HH
+#define SPONGE_LIBSPONGE_SHARDED_TCP_STACK_HH
+
+#include "address.hh"
+#include "file_descriptor.hh"
+#include "spsc_queue.hh"
+#include "tcp_config.hh"
+#include "tcp_stack.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! TCPStacks on N threads ("shards"), each owning the connections whose FourTuple hashes to it
+class ShardedTCPStack {
+  public:
+    //! Called on each shard's thread with its TCPStack and index, before the shard starts its event
+    //! loop, to add listeners, handlers and connections. A shard's TCPStack (and everything its
+    //! handlers touch) must only be used from that shard's thread.
+    using Setup = std::function<void(TCPStack &, size_t)>;
+
+  private:
+    //! Datagrams that may wait in each queue from one shard to another; the rest are dropped
+    static constexpr size_t HANDOFF_CAPACITY = 4096;
+
+    struct Shard {
+        FileDescriptor datagrams;  //!< Handed to the shard's TCPStack when its thread starts
+        FileDescriptor doorbell;   //!< eventfd rung by other shards when they hand off datagrams
+
+        //! Datagrams handed off to this shard, one queue per source shard
+        std::vector<std::unique_ptr<SPSCQueue<std::string>>> inbound{};
+
+        std::atomic<uint64_t> handed_off{0};  //!< Datagrams this shard read and passed to another
+        std::atomic<uint64_t> dropped{0};     //!< Datagrams this shard could not pass on (queue full)
+
+        std::thread thread{};
+
+        Shard(FileDescriptor &&fd, FileDescriptor &&eventfd) : datagrams(std::move(fd)), doorbell(std::move(eventfd)) {}
+    };
+
+    std::vector<std::unique_ptr<Shard>> _shards{};
+
+    std::atomic<bool> _stop{false};
+    std::atomic<bool> _failed{false};  //!< Has a shard's thread stored `_error`?
+    std::exception_ptr _error{};       //!< The first exception thrown on a shard's thread
+
+    //! Body of each shard's thread
+    void run(const size_t index, const Address &local_address, const TCPConfig &config, const Setup &setup);
+
+    //! Hand a datagram read by shard `from` to the shard that owns `tuple`
+    void hand_off(const size_t from, const FourTuple &tuple, std::string &&datagram);
+
+    //! Add one to a shard's doorbell, from any thread
+    static void ring(const Shard &shard);
+
+  public:
+    //! \param[in] datagrams one fd of IPv4 datagrams per shard (e.g. the queues of a multi-queue TunFD)
+    //! \param[in] local_address the IPv4 address of this end
+    //! \param[in] config used for every connection
+    //! \param[in] setup called on each shard's thread before it starts
+    ShardedTCPStack(std::vector<FileDescriptor> &&datagrams,
+                    const Address &local_address,
+                    const TCPConfig &config,
+                    const Setup &setup);
+
+    //! Stop the shards (see stop())
+    ~ShardedTCPStack();
+
+    //! Stop each shard's event loop and wait for its thread; connections still open are reset
+    //! \throws the first exception that a shard's thread ran into
+    void stop();
+
+    size_t shard_count() const { return _shards.size(); }
+
+    //! The shard that owns connections with `tuple`, the same at both ends of a connection
+    static size_t shard_of(const FourTuple &tuple, const size_t shard_count) { return tuple.hash() % shard_count; }
+
+    //! Datagrams read by one shard and passed to the shard that owns their connection
+    uint64_t handoffs() const;
+
+    //! Datagrams that could not be passed on because the owner's queue was full
+    uint64_t handoff_drops() const;
+
+    //! \name
+    //! The shards' threads refer to the object, so it cannot be copied or moved
+
+    //!@{
+    ShardedTCPStack(const ShardedTCPStack &) = delete;
+    ShardedTCPStack &operator=(const ShardedTCPStack &) = delete;
+    ShardedTCPStack(ShardedTCPStack &&) = delete;
+    ShardedTCPStack &operator=(ShardedTCPStack &&) = delete;
+    //!@}
+};
+
+//! \class ShardedTCPStack
+//! Flows are steered as with receive-side scaling: FourTuple::hash() picks the shard that owns a
+//! connection, and each shard runs its connections and their timers on its own EventLoop, without
+//! locks. A shard reads datagrams from its own fd; those of connections it does not own (because the
+//! device steered them by a different hash) go through a lock-free SPSCQueue to the owner, whose
+//! doorbell is only rung when the queue was empty. Each shard writes its own connections' segments
+//! to its own fd. connect() on a shard picks a local port that hashes to that shard, so with a device
+//! that steers by the same (symmetric) hash, no datagram ever changes shards.
+
+#endif  // SPONGE_LIBSPONGE_SHARDED_TCP_STACK_HH
@@ -8,6 +8,14 @@
 #include <cstdint>
 #include <optional>
 
+//! Congestion control algorithm used by a TCPSender (see congestion_control.hh)
+enum class CongestionControlAlgorithm {
+    none,     //!< no congestion window: send whatever the peer's window allows
+    reno,     //!< RFC 5681
+    newreno,  //!< RFC 6582
+    cubic     //!< RFC 8312
+};
+
 //! Config for TCP sender and receiver
 class TCPConfig {
   public:
@@ -15,11 +23,19 @@ class TCPConfig {
     static constexpr size_t MAX_PAYLOAD_SIZE = 1452;   //!< Max TCP payload that fits in either IPv4 or UDP datagram
     static constexpr uint16_t TIMEOUT_DFLT = 1000;     //!< Default re-transmit timeout is 1 second
     static constexpr unsigned MAX_RETX_ATTEMPTS = 8;   //!< Maximum re-transmit attempts before giving up
+    static constexpr uint16_t MIN_RTO_DFLT = 200;      //!< Default lower bound on an estimated RTO
+    static constexpr uint32_t MAX_RTO = 60000;         //!< Upper bound on the RTO, backoff included
 
     uint16_t rt_timeout = TIMEOUT_DFLT;       //!< Initial value of the retransmission timeout, in milliseconds
     size_t recv_capacity = DEFAULT_CAPACITY;  //!< Receive capacity, in bytes
     size_t send_capacity = DEFAULT_CAPACITY;  //!< Sender capacity, in bytes
     std::optional<WrappingInt32> fixed_isn{};
+    CongestionControlAlgorithm congestion_control = CongestionControlAlgorithm::none;  //!< Sender congestion control
+    bool adaptive_rto = false;        //!< Estimate the RTO from measured RTTs ([RFC 6298](\ref rfc::rfc6298))
+    uint16_t min_rto = MIN_RTO_DFLT;  //!< Lower bound on the estimated RTO, in milliseconds
+    bool timestamps = false;          //!< Offer the TCP timestamps option (RFC 7323) in the SYN
+    bool sack = false;                //!< Offer selective acknowledgments (RFC 2018) in the SYN
+    bool window_scaling = true;       //!< Offer window scaling (RFC 7323) so `recv_capacity` may exceed 64 KiB
 };
 
 //! Config for classes derived from FdAdapter
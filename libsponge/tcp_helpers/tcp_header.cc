@@ -1,9 +1,20 @@
 #include "tcp_header.hh"
 
+#include <algorithm>
 #include <sstream>
 
 using namespace std;
 
+//! \name TCP option kinds
+//!@{
+static constexpr uint8_t OPT_END = 0;
+static constexpr uint8_t OPT_NOP = 1;
+static constexpr uint8_t OPT_WINDOW_SCALE = 3;
+static constexpr uint8_t OPT_SACK_PERMITTED = 4;
+static constexpr uint8_t OPT_SACK = 5;
+static constexpr uint8_t OPT_TIMESTAMPS = 8;
+//!@}
+
 //! \param[in,out] p is a NetParser from which the TCP fields will be extracted
 //! \returns a ParseResult indicating success or the reason for failure
 //! \details It is important to check for (at least) the following potential errors
@@ -40,8 +51,46 @@ TCPHeader::parse(NetParser& p)
         return ParseResult::HeaderTooShort;
     }
 
-    // skip any options or anything extra in the header
-    p.remove_prefix(doff * 4 - TCPHeader::LENGTH);
+    // parse the options we understand and skip the rest
+    ts = false;
+    ws = false;
+    sack_permitted = false;
+    sack.clear();
+    size_t remaining = doff * 4 - TCPHeader::LENGTH;
+    while (remaining > 0 and not p.error()) {
+        const uint8_t kind = p.u8();
+        remaining--;
+        if (kind == OPT_END) {
+            break;
+        }
+        if (kind == OPT_NOP) {
+            continue;
+        }
+        const uint8_t len = remaining > 0 ? p.u8() : 0;
+        if (len < 2 or size_t(len - 1) > remaining) {
+            break;
+        }
+        remaining -= len - 1;
+        if (kind == OPT_TIMESTAMPS and len == 10) {
+            ts = true;
+            tsval = p.u32();
+            tsecr = p.u32();
+        } else if (kind == OPT_WINDOW_SCALE and len == 3) {
+            // RFC 7323 section 2.3: larger shift counts are treated as 14
+            ws = true;
+            wscale = min(p.u8(), TCPHeader::MAX_WSCALE);
+        } else if (kind == OPT_SACK_PERMITTED and len == 2) {
+            sack_permitted = true;
+        } else if (kind == OPT_SACK and len % 8 == 2) {
+            for (size_t i = 0; i < size_t(len / 8); i++) {
+                const WrappingInt32 begin{p.u32()};
+                sack.push_back({begin, WrappingInt32{p.u32()}});
+            }
+        } else {
+            p.remove_prefix(len - 2);
+        }
+    }
+    p.remove_prefix(remaining);
 
     if (p.error()) {
         return p.get_error();
@@ -50,7 +99,55 @@ TCPHeader::parse(NetParser& p)
     return ParseResult::NoError;
 }
 
+//! \returns the options in wire format, padded with NOPs to a multiple of four bytes
+static string
+serialize_options(const TCPHeader& header)
+{
+    string ret;
+    if (header.ts) {
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_TIMESTAMPS);
+        NetUnparser::u8(ret, 10);
+        NetUnparser::u32(ret, header.tsval);
+        NetUnparser::u32(ret, header.tsecr);
+    }
+    if (header.ws) {
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_WINDOW_SCALE);
+        NetUnparser::u8(ret, 3);
+        NetUnparser::u8(ret, header.wscale);
+    }
+    if (header.sack_permitted) {
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_SACK_PERMITTED);
+        NetUnparser::u8(ret, 2);
+    }
+    if (not header.sack.empty()) {
+        const size_t max_blocks =
+            header.ts ? TCPHeader::MAX_SACK_BLOCKS_WITH_TS : TCPHeader::MAX_SACK_BLOCKS;
+        const size_t blocks = min(header.sack.size(), max_blocks);
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_NOP);
+        NetUnparser::u8(ret, OPT_SACK);
+        NetUnparser::u8(ret, 2 + 8 * blocks);
+        for (size_t i = 0; i < blocks; i++) {
+            NetUnparser::u32(ret, header.sack[i].begin.raw_value());
+            NetUnparser::u32(ret, header.sack[i].end.raw_value());
+        }
+    }
+    return ret;
+}
+
+size_t
+TCPHeader::length() const
+{
+    return max<size_t>(4 * doff, LENGTH + serialize_options(*this).size());
+}
+
 //! Serialize the TCPHeader to a string (does not recompute the checksum)
+//! \note `doff` is raised if needed to make room for the options
 string
 TCPHeader::serialize() const
 {
@@ -59,14 +156,17 @@ TCPHeader::serialize() const
         throw runtime_error("TCP header too short");
     }
 
+    const string options = serialize_options(*this);
+    const size_t header_length = max<size_t>(4 * doff, LENGTH + options.size());
+
     string ret;
-    ret.reserve(4 * doff);
+    ret.reserve(header_length);
 
     NetUnparser::u16(ret, sport);               // source port
     NetUnparser::u16(ret, dport);               // destination port
     NetUnparser::u32(ret, seqno.raw_value());   // sequence number
     NetUnparser::u32(ret, ackno.raw_value());   // ack number
-    NetUnparser::u8(ret, doff << 4);            // data offset
+    NetUnparser::u8(ret, (header_length / 4) << 4);   // data offset
 
     const uint8_t fl_b = (urg ? 0b0010'0000 : 0) | (ack ? 0b0001'0000 : 0) |
                          (psh ? 0b0000'1000 : 0) | (rst ? 0b0000'0100 : 0) |
@@ -78,7 +178,8 @@ TCPHeader::serialize() const
 
     NetUnparser::u16(ret, uptr);   // urgent pointer
 
-    ret.resize(4 * doff);   // expand header to advertised size
+    ret.append(options);
+    ret.resize(header_length);   // expand header to advertised size
 
     return ret;
 }
@@ -98,6 +199,18 @@ TCPHeader::to_string() const
        << "TCP winsize: " << +win << '\n'
        << "TCP cksum: " << +cksum << '\n'
        << "TCP uptr: " << +uptr << '\n';
+    if (ts) {
+        ss << "TCP timestamps: " << tsval << ' ' << tsecr << '\n';
+    }
+    if (ws) {
+        ss << "TCP window scale: " << dec << +wscale << hex << '\n';
+    }
+    if (sack_permitted) {
+        ss << "TCP SACK permitted\n";
+    }
+    for (const auto& block : sack) {
+        ss << "TCP SACK: " << block.begin << '-' << block.end << '\n';
+    }
     return ss.str();
 }
 
@@ -114,7 +227,14 @@ bool
 TCPHeader::operator==(const TCPHeader& other) const
 {
     // TODO(aozdemir) more complete check (right now we omit cksum, src, dst
+    const auto same_block = [](const SACKBlock& a, const SACKBlock& b) {
+        return a.begin == b.begin && a.end == b.end;
+    };
     return seqno == other.seqno && ackno == other.ackno && doff == other.doff && urg == other.urg &&
            ack == other.ack && psh == other.psh && rst == other.rst && syn == other.syn &&
-           fin == other.fin && win == other.win && uptr == other.uptr;
+           fin == other.fin && win == other.win && uptr == other.uptr && ts == other.ts &&
+           (not ts || (tsval == other.tsval && tsecr == other.tsecr)) &&
+           ws == other.ws && (not ws || wscale == other.wscale) &&
+           sack_permitted == other.sack_permitted &&
+           equal(sack.begin(), sack.end(), other.sack.begin(), other.sack.end(), same_block);
 }
@@ -4,8 +4,16 @@
 #include "parser.hh"
 #include "wrapping_integers.hh"
 
+#include <vector>
+
+//! \brief One block of the SACK option (RFC 2018): the peer holds the sequence numbers [begin, end)
+struct SACKBlock {
+    WrappingInt32 begin{0};  //!< first sequence number of the block
+    WrappingInt32 end{0};    //!< sequence number just past the block
+};
+
 //! \brief [TCP](\ref rfc::rfc793) segment header
-//! \note TCP options are not supported
+//! \note Only the options listed under "TCP options" are understood; others are skipped when parsing
 struct TCPHeader {
     static constexpr size_t LENGTH = 20;  //!< [TCP](\ref rfc::rfc793) header length, not including options
 
@@ -50,6 +58,27 @@ struct TCPHeader {
     uint16_t uptr = 0;          //!< urgent pointer
     //!@}
 
+    //! \name TCP options
+    //!@{
+    bool ts = false;     //!< timestamps option present (RFC 7323)
+    uint32_t tsval = 0;  //!< timestamp value: the sender's clock when the segment was sent
+    uint32_t tsecr = 0;  //!< timestamp echo reply: the most recent `tsval` received from the peer
+    bool ws = false;              //!< window scale option present (RFC 7323), only sent with SYN
+    uint8_t wscale = 0;           //!< shift count the sender applies to the windows it advertises
+    bool sack_permitted = false;  //!< SACK-permitted option present (RFC 2018), only sent with SYN
+    std::vector<SACKBlock> sack{};  //!< SACK blocks, most recently changed first
+    //!@}
+
+    //! Largest shift count allowed in the window scale option
+    static constexpr uint8_t MAX_WSCALE = 14;
+
+    //! Most SACK blocks that fit in the option space, with or without timestamps
+    static constexpr size_t MAX_SACK_BLOCKS = 4;
+    static constexpr size_t MAX_SACK_BLOCKS_WITH_TS = 3;
+
+    //! Length of the header in bytes including options; at least `4 * doff`
+    size_t length() const;
+
     //! Parse the TCP fields from the provided NetParser
     ParseResult parse(NetParser &p);
 
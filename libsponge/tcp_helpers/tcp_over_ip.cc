@@ -24,7 +24,7 @@ using namespace std;
 //! from the TCP header; it uses this information to filter future reads.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
 optional<TCPSegment>
-TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram& ip_dgram)
+TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram& ip_dgram, const bool checksum_offloaded)
 {
     // is the IPv4 datagram for us?
     // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
@@ -44,8 +44,8 @@ TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram& ip_dgram)
 
     // is the payload a valid TCP segment?
     TCPSegment tcp_seg;
-    if (ParseResult::NoError !=
-        tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum())) {
+    if (ParseResult::NoError != tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum(),
+                                              not checksum_offloaded)) {
         return {};
     }
 
@@ -89,7 +89,7 @@ TCPOverIPv4Adapter::wrap_tcp_in_ip(TCPSegment& seg)
     ip_dgram.header().src = config().source.ipv4_numeric();
     ip_dgram.header().dst = config().destination.ipv4_numeric();
     ip_dgram.header().len =
-        ip_dgram.header().hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+        ip_dgram.header().hlen * 4 + seg.header().length() + seg.payload().size();
 
     // set payload, calculating TCP checksum using information from IP header
     ip_dgram.payload() = seg.serialize(ip_dgram.header().pseudo_cksum());
@@ -11,7 +11,9 @@
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase {
   public:
-    std::optional<TCPSegment> unwrap_tcp_in_ip(const InternetDatagram &ip_dgram);
+    //! \param[in] ip_dgram the received datagram
+    //! \param[in] checksum_offloaded whether the device has taken care of the TCP checksum
+    std::optional<TCPSegment> unwrap_tcp_in_ip(const InternetDatagram &ip_dgram, const bool checksum_offloaded = false);
 
     InternetDatagram wrap_tcp_in_ip(TCPSegment &seg);
 };
@@ -9,13 +9,17 @@ using namespace std;
 
 //! \param[in] buffer string/Buffer to be parsed
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
+//! \param[in] verify_checksum whether to reject a segment whose checksum is wrong
 ParseResult
-TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum)
+TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum,
+                  const bool verify_checksum)
 {
-    InternetChecksum check(datagram_layer_checksum);
-    check.add(buffer);
-    if (check.value()) {
-        return ParseResult::BadChecksum;
+    if (verify_checksum) {
+        InternetChecksum check(datagram_layer_checksum);
+        check.add(buffer);
+        if (check.value()) {
+            return ParseResult::BadChecksum;
+        }
     }
 
     NetParser p{buffer};
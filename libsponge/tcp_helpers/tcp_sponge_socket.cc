@@ -10,6 +10,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -18,27 +19,30 @@
 
 using namespace std;
 
-static constexpr size_t TCP_TICK_MS = 10;
-
 //! \param[in] condition is a function returning true if loop should continue
 template<typename AdaptT>
 void
 TCPSpongeSocket<AdaptT>::_tcp_loop(const function<bool()>& condition)
 {
-    auto base_time = timestamp_ms();
+    // no fixed tick: the timer added in _initialize_TCP wakes the loop when TCP has work to do
     while (condition()) {
-        auto ret = _eventloop.wait_next_event(TCP_TICK_MS);
+        auto ret = _eventloop.wait_next_event(-1);
         if (ret == EventLoop::Result::Exit or _abort) {
             break;
         }
+    }
+}
 
-        if (_tcp.value().active()) {
-            const auto next_time = timestamp_ms();
-            _tcp.value().tick(next_time - base_time);
-            _datagram_adapter.tick(next_time - base_time);
-            base_time = next_time;
-        }
+template<typename AdaptT>
+void
+TCPSpongeSocket<AdaptT>::_tick()
+{
+    const auto next_time = timestamp_ms();
+    if (_tcp.value().active()) {
+        _tcp.value().tick(next_time - _last_tick_time);
+        _datagram_adapter.tick(next_time - _last_tick_time);
     }
+    _last_tick_time = next_time;
 }
 
 //! \param[in] data_socket_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
@@ -48,7 +52,8 @@ TCPSpongeSocket<AdaptT>::TCPSpongeSocket(pair<FileDescriptor, FileDescriptor> da
                                          AdaptT&& datagram_interface) :
     LocalStreamSocket(move(data_socket_pair.first)),
     _thread_data(move(data_socket_pair.second)),
-    _datagram_adapter(move(datagram_interface))
+    _datagram_adapter(move(datagram_interface)),
+    _abort_doorbell(SystemCall("eventfd", ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)))
 {
     _thread_data.set_blocking(false);
 }
@@ -58,6 +63,7 @@ void
 TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig& config)
 {
     _tcp.emplace(config);
+    _last_tick_time = timestamp_ms();
 
     // Set up the event loop
 
@@ -76,19 +82,27 @@ TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig& config)
     //
     // 4) Outbound segment generated by TCP (needs to be
     //    given to underlying datagram socket)
+    //
+    // Rules 1 and 2 tick the TCPConnection first, so that it sees the
+    // segment or the bytes at the right time (e.g. to start the
+    // retransmission timer).
 
     // rule 1: read from filtered packet stream and dump into TCPConnection
     _eventloop.add_rule(
         _datagram_adapter,
         Direction::In,
         [&] {
-            auto seg = _datagram_adapter.read();
-            if (seg) {
-                _tcp->segment_received(move(seg.value()));
-            }
+            _tick();
+            // drain the adapter's batch, so nothing received waits for the fd to become readable again
+            do {
+                auto seg = _datagram_adapter.read();
+                if (seg) {
+                    _tcp->segment_received(move(seg.value()));
+                }
+            } while (_tcp->active() and _datagram_adapter.read_pending());
 
             // debugging output:
-            if (_thread_data.eof() and _tcp.value().bytes_in_flight() == 0 and not _fully_acked) {
+            if (_outbound_shutdown and _tcp.value().bytes_in_flight() == 0 and not _fully_acked) {
                 cerr << "DEBUG: Outbound stream to "
                      << _datagram_adapter.config().destination.to_string()
                      << " has been fully acknowledged.\n";
@@ -97,37 +111,83 @@ TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig& config)
         },
         [&] { return _tcp->active(); });
 
-    // rule 2: read from pipe into outbound buffer
-    _eventloop.add_rule(
-        _thread_data,
-        Direction::In,
-        [&] {
-            const auto data = _thread_data.read(_tcp->remaining_outbound_capacity());
-            const auto len = data.size();
-            const auto amount_written = _tcp->write(move(data));
-            if (amount_written != len) {
-                throw runtime_error("TCPConnection::write() accepted less than advertised length");
-            }
+    // rule 2: read from pipe (or the outbound ring) into outbound buffer
+    if (_outbound_ring) {
+        _eventloop.add_rule(
+            _outbound_ring->readable_doorbell(),
+            Direction::In,
+            [&] {
+                _tick();
+                // one copy from the ring into the TCP ByteStream, no syscalls unless it drains
+                SPSCByteStream& ring = *_outbound_ring;
+                while (not ring.buffer_empty() and _tcp->remaining_outbound_capacity() > 0) {
+                    const BufferViewList data =
+                        ring.peek_view(_tcp->remaining_outbound_capacity());
+                    size_t amount_written = 0;
+                    for (const auto& piece : data.views()) {
+                        amount_written += _tcp->write(Buffer(string(piece)));
+                    }
+                    if (amount_written != data.size()) {
+                        throw runtime_error(
+                            "TCPConnection::write() accepted less than advertised length");
+                    }
+                    ring.pop_output(amount_written);
+                }
+                if (ring.buffer_empty()) {
+                    ring.acknowledge_readable();
+                }
 
-            if (_thread_data.eof()) {
+                if (ring.eof()) {
+                    _tcp->end_input_stream();
+                    _outbound_shutdown = true;
+
+                    // debugging output:
+                    cerr << "DEBUG: Outbound stream to "
+                         << _datagram_adapter.config().destination.to_string() << " finished ("
+                         << _tcp.value().bytes_in_flight() << " byte"
+                         << (_tcp.value().bytes_in_flight() == 1 ? "" : "s")
+                         << " still in flight).\n";
+                }
+            },
+            [&] {
+                return (_tcp->active()) and (not _outbound_shutdown) and
+                       (_tcp->remaining_outbound_capacity() > 0);
+            });
+    } else {
+        _eventloop.add_rule(
+            _thread_data,
+            Direction::In,
+            [&] {
+                _tick();
+                Buffer data{_thread_data.read(_tcp->remaining_outbound_capacity())};
+                const auto len = data.size();
+                const auto amount_written = _tcp->write(move(data));
+                if (amount_written != len) {
+                    throw runtime_error(
+                        "TCPConnection::write() accepted less than advertised length");
+                }
+
+                if (_thread_data.eof()) {
+                    _tcp->end_input_stream();
+                    _outbound_shutdown = true;
+
+                    // debugging output:
+                    cerr << "DEBUG: Outbound stream to "
+                         << _datagram_adapter.config().destination.to_string() << " finished ("
+                         << _tcp.value().bytes_in_flight() << " byte"
+                         << (_tcp.value().bytes_in_flight() == 1 ? "" : "s")
+                         << " still in flight).\n";
+                }
+            },
+            [&] {
+                return (_tcp->active()) and (not _outbound_shutdown) and
+                       (_tcp->remaining_outbound_capacity() > 0);
+            },
+            [&] {
                 _tcp->end_input_stream();
                 _outbound_shutdown = true;
-
-                // debugging output:
-                cerr << "DEBUG: Outbound stream to "
-                     << _datagram_adapter.config().destination.to_string() << " finished ("
-                     << _tcp.value().bytes_in_flight() << " byte"
-                     << (_tcp.value().bytes_in_flight() == 1 ? "" : "s") << " still in flight).\n";
-            }
-        },
-        [&] {
-            return (_tcp->active()) and (not _outbound_shutdown) and
-                   (_tcp->remaining_outbound_capacity() > 0);
-        },
-        [&] {
-            _tcp->end_input_stream();
-            _outbound_shutdown = true;
-        });
+            });
+    }
 
     // rule 3: read from inbound buffer into pipe
     _eventloop.add_rule(
@@ -139,8 +199,8 @@ TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig& config)
             // the pipe, handling the possibility of a partial
             // write (i.e., only pop what was actually written).
             const size_t amount_to_write = min(size_t(65536), inbound.buffer_size());
-            const std::string buffer = inbound.peek_output(amount_to_write);
-            const auto bytes_written = _thread_data.write(move(buffer), false);
+            const auto bytes_written =
+                _thread_data.write(inbound.peek_view(amount_to_write), false);
             inbound.pop_output(bytes_written);
 
             if (inbound.eof() or inbound.error()) {
@@ -172,8 +232,34 @@ TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig& config)
                 _datagram_adapter.write(_tcp->segments_out().front());
                 _tcp->segments_out().pop();
             }
+            _datagram_adapter.flush();
         },
         [&] { return not _tcp->segments_out().empty(); });
+
+    // timer: wake up for the next retransmission, the end of lingering, or an ARP timeout
+    _eventloop.add_timer(
+        [&]() -> optional<uint64_t> {
+            if (not _tcp->active()) {
+                return nullopt;
+            }
+            auto until = _tcp->time_until_next_timer();
+            const auto adapter_until = _datagram_adapter.time_until_next_timer();
+            if (adapter_until.has_value() and (not until.has_value() or adapter_until < until)) {
+                until = adapter_until;
+            }
+            if (not until.has_value()) {
+                return nullopt;
+            }
+            return _last_tick_time + until.value();
+        },
+        [&] { _tick(); });
+
+    // rule 5: wake up when the owner aborts the connection, while any other rule may still wait
+    _eventloop.add_rule(
+        _abort_doorbell,
+        Direction::In,
+        [&] { _abort_doorbell.read(sizeof(uint64_t)); },
+        [&] { return _tcp->active() or not _inbound_shutdown; });
 }
 
 //! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of
@@ -201,6 +287,8 @@ template<typename AdaptT> TCPSpongeSocket<AdaptT>::~TCPSpongeSocket()
             cerr << "Warning: unclean shutdown of TCPSpongeSocket\n";
             // force the other side to exit
             _abort.store(true);
+            const uint64_t one = 1;
+            _abort_doorbell.write(string_view(reinterpret_cast<const char*>(&one), sizeof(one)));
             _tcp_thread.join();
         }
     } catch (const exception& e) {
@@ -212,6 +300,9 @@ template<typename AdaptT>
 void
 TCPSpongeSocket<AdaptT>::wait_until_closed()
 {
+    if (_outbound_ring) {
+        _outbound_ring->end_input();
+    }
     shutdown(SHUT_RDWR);
     if (_tcp_thread.joinable()) {
         cerr << "DEBUG: Waiting for clean shutdown... ";
@@ -220,6 +311,46 @@ TCPSpongeSocket<AdaptT>::wait_until_closed()
     }
 }
 
+//! \param[in] capacity is the size of the lock-free ring between the owner and the TCP thread
+template<typename AdaptT>
+void
+TCPSpongeSocket<AdaptT>::use_outbound_ring(const size_t capacity)
+{
+    if (_tcp) {
+        throw runtime_error("use_outbound_ring() with TCPConnection already initialized");
+    }
+    _outbound_ring = make_unique<SPSCByteStream>(capacity);
+}
+
+//! \param[in] data is copied into the outbound ring; the TCP thread is only woken if it was idle
+template<typename AdaptT>
+void
+TCPSpongeSocket<AdaptT>::write_outbound(string_view data)
+{
+    if (not _outbound_ring) {
+        throw runtime_error("write_outbound() without use_outbound_ring()");
+    }
+    while (not data.empty()) {
+        if (_outbound_ring->error()) {
+            throw runtime_error("write_outbound(): TCP connection has finished");
+        }
+        data.remove_prefix(_outbound_ring->write(data));
+        if (not data.empty()) {
+            _outbound_ring->wait_writable();
+        }
+    }
+}
+
+template<typename AdaptT>
+void
+TCPSpongeSocket<AdaptT>::end_outbound()
+{
+    if (not _outbound_ring) {
+        throw runtime_error("end_outbound() without use_outbound_ring()");
+    }
+    _outbound_ring->end_input();
+}
+
 //! \param[in] c_tcp is the TCPConfig for the TCPConnection
 //! \param[in] c_ad is the FdAdapterConfig for the FdAdapter
 template<typename AdaptT>
@@ -286,6 +417,10 @@ TCPSpongeSocket<AdaptT>::_tcp_main()
         }
         _tcp_loop([] { return true; });
         shutdown(SHUT_RDWR);
+        if (_outbound_ring) {
+            // release an owner blocked in write_outbound()
+            _outbound_ring->set_error();
+        }
         if (not _tcp.value().active()) {
             cerr << "DEBUG: TCP connection finished "
                  << (_tcp.value().state() == TCPState::State::RESET ? "uncleanly" : "cleanly.\n");
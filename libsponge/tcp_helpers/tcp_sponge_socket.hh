@@ -6,13 +6,16 @@
 #include "fd_adapter.hh"
 #include "file_descriptor.hh"
 #include "network_interface.hh"
+#include "spsc_byte_stream.hh"
 #include "tcp_config.hh"
 #include "tcp_connection.hh"
 #include "tuntap_adapter.hh"
 
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -23,6 +26,9 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! Stream socket for reads and writes between owner and TCP thread
     LocalStreamSocket _thread_data;
 
+    //! Lock-free alternative to `_thread_data` for outbound bytes (see use_outbound_ring())
+    std::unique_ptr<SPSCByteStream> _outbound_ring{};
+
   protected:
     //! Adapter to underlying datagram socket (e.g., UDP or IP)
     AdaptT _datagram_adapter;
@@ -40,6 +46,12 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! Process events while specified condition is true
     void _tcp_loop(const std::function<bool()> &condition);
 
+    //! timestamp_ms() when the TCPConnection was last told how much time had passed
+    uint64_t _last_tick_time{0};
+
+    //! Tell the TCPConnection and the adapter how much time has passed since the last call
+    void _tick();
+
     //! Main loop of TCPConnection thread
     void _tcp_main();
 
@@ -51,6 +63,8 @@ class TCPSpongeSocket : public LocalStreamSocket {
 
     std::atomic_bool _abort{false};  //!< Flag used by the owner to force the TCPConnection thread to shut down
 
+    FileDescriptor _abort_doorbell;  //!< eventfd rung with `_abort`, so that an idle TCPConnection thread wakes up
+
     bool _inbound_shutdown{false};  //!< Has TCPSpongeSocket shut down the incoming data to the owner?
 
     bool _outbound_shutdown{false};  //!< Has the owner shut down the outbound data to the TCP connection?
@@ -72,6 +86,20 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
     void listen_and_accept(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad);
 
+    //! \name
+    //! Outbound data path that bypasses the socketpair (must be chosen before connecting)
+
+    //!@{
+    //! Send outbound bytes through a lock-free SPSCByteStream of `capacity` bytes instead of write()
+    void use_outbound_ring(const size_t capacity = TCPConfig::DEFAULT_CAPACITY);
+
+    //! Hand `data` to the TCP thread, blocking while the outbound ring is full
+    void write_outbound(std::string_view data);
+
+    //! End the outbound stream written with write_outbound() (like shutdown(SHUT_WR))
+    void end_outbound();
+    //!@}
+
     //! When a connected socket is destructed, it will send a RST
     ~TCPSpongeSocket();
 
@@ -122,6 +150,8 @@ using LossyTCPOverIPv4SpongeSocket = TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAd
 //!   and [accept(2)](\ref man2::accept)
 //! - if TCPSpongeSocket is destructed while a TCP connection is open, the connection is
 //!   immediately terminated with a RST (call `wait_until_closed` to avoid this)
+//! - after use_outbound_ring(), outbound bytes are written with write_outbound() and
+//!   end_outbound() rather than write() and shutdown(); inbound bytes are still read with read()
 
 //! Helper class that makes a TCPOverIPv4SpongeSocket behave more like a (kernel) TCPSocket
 class CS144TCPSocket : public TCPOverIPv4SpongeSocket {
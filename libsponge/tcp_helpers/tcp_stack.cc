@@ -0,0 +1,401 @@
+#include "tcp_stack.hh"
+
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+#include <tuple>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+uint64_t
+FourTuple::hash() const
+{
+    // one multiply-xorshift round per endpoint, combined in an order that does not depend on
+    // which end is local
+    const auto mix = [](uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return x;
+    };
+    const uint64_t local = (uint64_t{local_address} << 16) | local_port;
+    const uint64_t remote = (uint64_t{remote_address} << 16) | remote_port;
+    return mix(mix(min(local, remote)) ^ (max(local, remote) * 0x9e3779b97f4a7c15ULL));
+}
+
+optional<FourTuple>
+FourTuple::of_datagram(const string_view datagram)
+{
+    const auto byte = [&](const size_t i) { return uint8_t(datagram[i]); };
+    const auto u16 = [&](const size_t i) { return uint16_t((byte(i) << 8) | byte(i + 1)); };
+    const auto u32 = [&](const size_t i) { return (uint32_t{u16(i)} << 16) | u16(i + 2); };
+
+    if (datagram.size() < IPv4Header::LENGTH or (byte(0) >> 4) != 4 or
+        byte(9) != IPv4Header::PROTO_TCP) {
+        return {};
+    }
+    const size_t header_length = size_t{byte(0) & 0xfU} * 4;
+    if (datagram.size() < header_length + 4) {
+        return {};
+    }
+    return FourTuple{u32(16), u16(header_length + 2), u32(12), u16(header_length)};
+}
+
+//! \param[in] datagrams is made non-blocking; a datagram that does not fit in its queue is dropped
+TCPStack::TCPStack(FileDescriptor&& datagrams, const Address& local_address,
+                   const TCPConfig& config) :
+    _datagrams(move(datagrams)),
+    _local_address(local_address.ipv4_numeric()),
+    _config(config),
+    _eventloop(EventLoop::Backend::Epoll),
+    _timers(timestamp_ms())
+{
+    _datagrams.set_blocking(false);
+
+    // up to READ_BATCH datagrams per round; the first read is the one the EventLoop counts
+    _eventloop.add_rule(_datagrams, Direction::In, [&] {
+        string datagram = _datagrams.read();
+        for (size_t count = 1;; count++) {
+            InternetDatagram dgram;
+            const auto tuple = _owns ? FourTuple::of_datagram(datagram) : nullopt;
+            if (tuple.has_value() and not _owns(tuple.value())) {
+                _hand_off(tuple.value(), move(datagram));
+            } else if (dgram.parse(Buffer(move(datagram))) == ParseResult::NoError) {
+                datagram_received(dgram);
+            }
+            if (count == READ_BATCH) {
+                break;
+            }
+            datagram.resize(numeric_limits<uint16_t>::max());
+            const ssize_t bytes_read =
+                ::read(_datagrams.fd_num(), datagram.data(), datagram.size());
+            if (SystemCall("read", bytes_read, EAGAIN) < 0) {
+                break;
+            }
+            datagram.resize(bytes_read);
+        }
+    });
+
+    // the timers of all connections: tick each one whose deadline has passed
+    _eventloop.add_timer([&]() -> optional<uint64_t> { return _timers.next_expiration(); },
+                         [&] {
+                             const uint64_t now = timestamp_ms();
+                             const auto fire = [&](TimerWheel::TimerId, uint64_t id) {
+                                 lookup(id).timer.reset();
+                                 service(id, [](TCPConnection&) {}, true);
+                             };
+                             _timers.advance(now - min(now, _timers.now()), fire);
+                         });
+}
+
+TCPStack::Connection&
+TCPStack::lookup(const ConnectionId id)
+{
+    const auto it = _connections.find(id);
+    if (it == _connections.end()) {
+        throw runtime_error("TCPStack: no connection " + to_string(id));
+    }
+    return it->second;
+}
+
+const TCPStack::Connection&
+TCPStack::lookup(const ConnectionId id) const
+{
+    const auto it = _connections.find(id);
+    if (it == _connections.end()) {
+        throw runtime_error("TCPStack: no connection " + to_string(id));
+    }
+    return it->second;
+}
+
+TCPStack::ConnectionId
+TCPStack::add_connection(const FourTuple& tuple)
+{
+    const ConnectionId id = _next_id++;
+    _connections.emplace(piecewise_construct, forward_as_tuple(id),
+                         forward_as_tuple(_config, tuple, timestamp_ms()));
+    _demux.emplace(tuple, id);
+    return id;
+}
+
+void
+TCPStack::tick(Connection& connection)
+{
+    const uint64_t now = timestamp_ms();
+    if (connection.tcp.active()) {
+        connection.tcp.tick(now - connection.last_tick);
+    }
+    connection.last_tick = now;
+}
+
+void
+TCPStack::service(const ConnectionId id, const function<void(TCPConnection&)>& action,
+                  const bool notify)
+{
+    Connection& connection = lookup(id);
+    TCPConnection& tcp = connection.tcp;
+    tick(connection);
+    action(tcp);
+
+    while (not tcp.segments_out().empty()) {
+        send(connection.tuple, tcp.segments_out().front());
+        tcp.segments_out().pop();
+    }
+
+    if (connection.timer.has_value()) {
+        _timers.cancel(connection.timer.value());
+        connection.timer.reset();
+    }
+    if (const auto until = tcp.time_until_next_timer(); until.has_value()) {
+        connection.timer = _timers.schedule_at(connection.last_tick + until.value(), id);
+    }
+
+    const TCPState state = tcp.state();
+    if (connection.listener.has_value() and not connection.queued and tcp.active() and
+        state != TCPState::State::LISTEN and state != TCPState::State::SYN_RCVD) {
+        Listener& listener = _listeners.at(connection.listener.value());
+        listener.embryonic--;
+        listener.accept_queue.push_back(id);
+        connection.queued = true;
+        listener.on_accept(connection.listener.value());
+        return;
+    }
+
+    if (not tcp.active() and (connection.closed or connection.listener.has_value())) {
+        reap(id);
+        return;
+    }
+
+    if (notify and not connection.listener.has_value() and not connection.closed and _on_change) {
+        _on_change(id);
+    }
+}
+
+//! \param[in] tuple gives the ports and addresses, with this end as the source
+//! \param[in] seg the segment to send; its ports are filled in
+void
+TCPStack::send(const FourTuple& tuple, TCPSegment& seg)
+{
+    seg.header().sport = tuple.local_port;
+    seg.header().dport = tuple.remote_port;
+
+    InternetDatagram dgram;
+    dgram.header().src = tuple.local_address;
+    dgram.header().dst = tuple.remote_address;
+    dgram.header().len = dgram.header().hlen * 4 + seg.header().length() + seg.payload().size();
+    dgram.payload() = seg.serialize(dgram.header().pseudo_cksum());
+
+    const BufferList serialized = dgram.serialize();
+    const auto iovecs = BufferViewList(serialized).as_iovecs();
+
+    // a full queue drops the datagram, as a full device would; TCP retransmits it
+    const ssize_t written = ::writev(_datagrams.fd_num(), iovecs.data(), iovecs.size());
+    if (SystemCall("writev", written, EAGAIN) < 0) {
+        _dropped_datagrams++;
+    }
+}
+
+//! \details As in RFC 793 ("Reset Generation"): the RST takes its sequence number from the
+//! offending segment's ACK, or else acknowledges everything the segment occupied.
+void
+TCPStack::send_reset(const FourTuple& tuple, const TCPSegment& seg)
+{
+    TCPSegment reset;
+    reset.header().rst = true;
+    if (seg.header().ack) {
+        reset.header().seqno = seg.header().ackno;
+    } else {
+        reset.header().ack = true;
+        reset.header().ackno = seg.header().seqno + seg.length_in_sequence_space();
+    }
+    send(tuple, reset);
+}
+
+void
+TCPStack::reap(const ConnectionId id)
+{
+    Connection& connection = lookup(id);
+    if (connection.timer.has_value()) {
+        _timers.cancel(connection.timer.value());
+    }
+    if (connection.listener.has_value()) {
+        Listener& listener = _listeners.at(connection.listener.value());
+        if (connection.queued) {
+            auto& queue = listener.accept_queue;
+            queue.erase(find(queue.begin(), queue.end(), id));
+        } else {
+            listener.embryonic--;
+        }
+    }
+    _demux.erase(connection.tuple);
+    _connections.erase(id);
+}
+
+void
+TCPStack::datagram_received(const InternetDatagram& dgram)
+{
+    if (dgram.header().proto != IPv4Header::PROTO_TCP or dgram.header().dst != _local_address) {
+        return;
+    }
+
+    TCPSegment seg;
+    if (seg.parse(dgram.payload(), dgram.header().pseudo_cksum()) != ParseResult::NoError) {
+        return;
+    }
+
+    const FourTuple tuple{dgram.header().dst, seg.header().dport, dgram.header().src,
+                          seg.header().sport};
+    if (const auto it = _demux.find(tuple); it != _demux.end()) {
+        service(it->second, [&](TCPConnection& tcp) { tcp.segment_received(seg); }, true);
+        return;
+    }
+
+    const auto listener = _listeners.find(seg.header().dport);
+    if (listener != _listeners.end() and seg.header().syn and not seg.header().ack and
+        not seg.header().rst) {
+        Listener& l = listener->second;
+        // like a full backlog in Linux, ignore the SYN; the peer will retransmit it
+        if (l.embryonic + l.accept_queue.size() >= l.backlog) {
+            return;
+        }
+        const ConnectionId id = add_connection(tuple);
+        lookup(id).listener = seg.header().dport;
+        l.embryonic++;
+        service(id, [&](TCPConnection& tcp) { tcp.segment_received(seg); }, true);
+        return;
+    }
+
+    if (not seg.header().rst) {
+        send_reset(tuple, seg);
+    }
+}
+
+//! \param[in] port the local port to accept connections to
+//! \param[in] backlog how many connections may wait for accept(), counting those still in the
+//! handshake
+//! \param[in] on_accept called when a connection joins the accept queue
+void
+TCPStack::listen(const uint16_t port, const size_t backlog, const AcceptHandler& on_accept)
+{
+    if (not _listeners.emplace(port, Listener{backlog, on_accept}).second) {
+        throw runtime_error("TCPStack: already listening on port " + to_string(port));
+    }
+}
+
+optional<TCPStack::ConnectionId>
+TCPStack::accept(const uint16_t port)
+{
+    const auto it = _listeners.find(port);
+    if (it == _listeners.end()) {
+        throw runtime_error("TCPStack: not listening on port " + to_string(port));
+    }
+    auto& queue = it->second.accept_queue;
+    if (queue.empty()) {
+        return {};
+    }
+    const ConnectionId id = queue.front();
+    queue.pop_front();
+    Connection& connection = lookup(id);
+    connection.listener.reset();
+    connection.queued = false;
+    return id;
+}
+
+//! \param[in] peer the address and port to connect to
+//! \returns the new connection, in SYN_SENT
+TCPStack::ConnectionId
+TCPStack::connect(const Address& peer)
+{
+    FourTuple tuple{_local_address, 0, peer.ipv4_numeric(), peer.port()};
+    for (unsigned tries = 0; tries <= EPHEMERAL_LAST - EPHEMERAL_FIRST; tries++) {
+        tuple.local_port = _next_port;
+        _next_port = _next_port == EPHEMERAL_LAST ? EPHEMERAL_FIRST : _next_port + 1;
+        if (_demux.count(tuple) == 0 and (not _owns or _owns(tuple))) {
+            const ConnectionId id = add_connection(tuple);
+            service(id, [](TCPConnection& tcp) { tcp.connect(); }, false);
+            return id;
+        }
+    }
+    throw runtime_error("TCPStack: no free local port to connect to " + peer.to_string());
+}
+
+//! \param[in] owns decides which connections belong to this stack
+//! \param[in] hand_off called with each datagram read from the fd that belongs to another stack
+void
+TCPStack::set_steering(const FlowOwner& owns, const HandOff& hand_off)
+{
+    _owns = owns;
+    _hand_off = hand_off;
+}
+
+size_t
+TCPStack::write(const ConnectionId id, Buffer data)
+{
+    size_t written = 0;
+    service(id, [&](TCPConnection& tcp) { written = tcp.write(move(data)); }, false);
+    return written;
+}
+
+size_t
+TCPStack::remaining_outbound_capacity(const ConnectionId id) const
+{
+    return lookup(id).tcp.remaining_outbound_capacity();
+}
+
+void
+TCPStack::end_output(const ConnectionId id)
+{
+    service(id, [](TCPConnection& tcp) { tcp.end_input_stream(); }, false);
+}
+
+string
+TCPStack::read(const ConnectionId id, const size_t limit)
+{
+    return lookup(id).tcp.inbound_stream().read(limit);
+}
+
+bool
+TCPStack::inbound_eof(const ConnectionId id) const
+{
+    return lookup(id).tcp.inbound_stream().eof();
+}
+
+TCPState
+TCPStack::state(const ConnectionId id) const
+{
+    return lookup(id).tcp.state();
+}
+
+bool
+TCPStack::active(const ConnectionId id) const
+{
+    return lookup(id).tcp.active();
+}
+
+const FourTuple&
+TCPStack::tuple(const ConnectionId id) const
+{
+    return lookup(id).tuple;
+}
+
+void
+TCPStack::close(const ConnectionId id)
+{
+    Connection& connection = lookup(id);
+    connection.closed = true;
+    if (not connection.tcp.active()) {
+        reap(id);
+        return;
+    }
+    service(id, [](TCPConnection& tcp) { tcp.end_input_stream(); }, false);
+}
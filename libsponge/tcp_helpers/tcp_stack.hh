@@ -0,0 +1,224 @@
+#ifndef SPONGE_LIBSPONGE_TCP_STACK_HH
+#define SPONGE_LIBSPONGE_TCP_STACK_HH
+
+#include "address.hh"
+#include "buffer.hh"
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "tcp_segment.hh"
+#include "tcp_state.hh"
+#include "timer_wheel.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+//! The addresses and ports of a TCP connection, as seen from this end
+struct FourTuple {
+    uint32_t local_address;   //!< Numeric IPv4 address (see Address::ipv4_numeric)
+    uint16_t local_port;
+    uint32_t remote_address;  //!< Numeric IPv4 address
+    uint16_t remote_port;
+
+    bool operator==(const FourTuple &other) const {
+        return local_address == other.local_address and local_port == other.local_port and
+               remote_address == other.remote_address and remote_port == other.remote_port;
+    }
+
+    //! A well-mixed hash of all four fields, for hash tables and for steering flows. Like a symmetric
+    //! RSS key, it is the same at both ends of a connection (with local and remote swapped).
+    uint64_t hash() const;
+
+    //! The FourTuple, as seen by its receiver, of a serialized IPv4 datagram that carries TCP,
+    //! read straight from the headers (without checking them)
+    static std::optional<FourTuple> of_datagram(std::string_view datagram);
+};
+
+//! Hash functor for std::unordered_map keyed by FourTuple
+struct FourTupleHash {
+    size_t operator()(const FourTuple &tuple) const { return tuple.hash(); }
+};
+
+//! Many TCP connections over one file descriptor of IPv4 datagrams, run on one EventLoop
+class TCPStack {
+  public:
+    //! Identifies a connection; never reused by the same TCPStack
+    using ConnectionId = uint64_t;
+
+    //! Called with a connection that may have changed: data arrived, room to write, or a new state
+    using ConnectionHandler = std::function<void(ConnectionId)>;
+
+    //! Called with the port of a listener whose accept queue has a new connection
+    using AcceptHandler = std::function<void(uint16_t)>;
+
+    //! Does this stack own connections with the given FourTuple? (see set_steering())
+    using FlowOwner = std::function<bool(const FourTuple &)>;
+
+    //! Takes a datagram, read from the fd, of a connection that this stack does not own
+    using HandOff = std::function<void(const FourTuple &, std::string &&)>;
+
+  private:
+    //! Most datagrams read from the fd per round of the event loop
+    static constexpr size_t READ_BATCH = 64;
+
+    //! First and last local port handed out by connect()
+    static constexpr uint16_t EPHEMERAL_FIRST = 49152;
+    static constexpr uint16_t EPHEMERAL_LAST = 65535;
+
+    struct Connection {
+        TCPConnection tcp;
+        FourTuple tuple;
+        uint64_t last_tick;                          //!< timestamp_ms() of the last tick()
+        std::optional<TimerWheel::TimerId> timer{};  //!< In `_timers`, for the next tick() with work to do
+        std::optional<uint16_t> listener{};          //!< Port of the listener that has not handed it out yet
+        bool queued{false};                          //!< In its listener's accept queue (established)
+        bool closed{false};                          //!< Released by the application with close()
+
+        //! Constructed in place: a TCPConnection that is moved from still warns when destroyed
+        Connection(const TCPConfig &config, const FourTuple &four_tuple, const uint64_t now)
+            : tcp(config), tuple(four_tuple), last_tick(now) {}
+    };
+
+    struct Listener {
+        size_t backlog;
+        AcceptHandler on_accept;
+        std::deque<ConnectionId> accept_queue{};  //!< Established connections that accept() has not returned
+        size_t embryonic{0};                      //!< Connections that have not finished the handshake yet
+    };
+
+    FileDescriptor _datagrams;  //!< Reads and writes whole IPv4 datagrams (e.g., a TunFD)
+    uint32_t _local_address;
+    TCPConfig _config;
+
+    EventLoop _eventloop;
+    TimerWheel _timers;  //!< One timer per connection with a deadline, tagged with its ConnectionId
+
+    std::unordered_map<ConnectionId, Connection> _connections{};
+    std::unordered_map<FourTuple, ConnectionId, FourTupleHash> _demux{};
+    std::unordered_map<uint16_t, Listener> _listeners{};
+
+    ConnectionHandler _on_change{};
+    FlowOwner _owns{};
+    HandOff _hand_off{};
+    ConnectionId _next_id{1};
+    uint16_t _next_port{EPHEMERAL_FIRST};
+
+    uint64_t _dropped_datagrams{0};  //!< Written while the fd's queue was full
+
+    Connection &lookup(const ConnectionId id);
+    const Connection &lookup(const ConnectionId id) const;
+
+    //! Start a connection with `tuple` (not yet connected or listening)
+    ConnectionId add_connection(const FourTuple &tuple);
+
+    //! Tell a connection how much time has passed since its last tick
+    void tick(Connection &connection);
+
+    //! Tick a connection, run `action` on it, and then send its segments, reschedule its timer,
+    //! move it along its listener's queue and reap it if it is done
+    //! \param[in] notify call the ConnectionHandler afterwards (not for the application's own calls)
+    void service(const ConnectionId id, const std::function<void(TCPConnection &)> &action, const bool notify);
+
+    //! Wrap a segment in an IPv4 datagram from the local to the remote end of `tuple`, and write it
+    void send(const FourTuple &tuple, TCPSegment &seg);
+
+    //! Answer a segment that belongs to no connection or listener with a RST
+    void send_reset(const FourTuple &tuple, const TCPSegment &seg);
+
+    //! Forget a connection and everything that refers to it
+    void reap(const ConnectionId id);
+
+  public:
+    //! \param[in] datagrams fd for reading and writing IPv4 datagrams (e.g. a TunFD without a vnet header)
+    //! \param[in] local_address the IPv4 address of this end (the port is ignored)
+    //! \param[in] config used for every connection
+    TCPStack(FileDescriptor &&datagrams, const Address &local_address, const TCPConfig &config = {});
+
+    //! \name Listening
+    //!@{
+
+    //! Accept connections to `port`, queueing up to `backlog` of them (established or not) for accept()
+    void listen(const uint16_t port, const size_t backlog = 128, const AcceptHandler &on_accept = [](uint16_t) {});
+
+    //! The oldest established connection to `port` that has not been accepted yet, if any
+    std::optional<ConnectionId> accept(const uint16_t port);
+    //!@}
+
+    //! Connect from an ephemeral port to `peer`; the handler hears when the handshake is done
+    ConnectionId connect(const Address &peer);
+
+    //! \name Per-connection operations, like those of TCPConnection
+    //!@{
+    size_t write(const ConnectionId id, Buffer data);
+    size_t remaining_outbound_capacity(const ConnectionId id) const;
+    void end_output(const ConnectionId id);  //!< Like shutdown(SHUT_WR)
+
+    //! Take up to `limit` bytes of inbound data
+    std::string read(const ConnectionId id, const size_t limit = std::numeric_limits<size_t>::max());
+    bool inbound_eof(const ConnectionId id) const;  //!< Has all inbound data been read?
+
+    TCPState state(const ConnectionId id) const;
+    bool active(const ConnectionId id) const;
+    const FourTuple &tuple(const ConnectionId id) const;
+
+    //! Give up the connection: ends its output, and it is forgotten once it is no longer active
+    void close(const ConnectionId id);
+    //!@}
+
+    //! Call `handler` whenever a connection may have changed
+    void set_handler(const ConnectionHandler &handler) { _on_change = handler; }
+
+    //! Share the connections with other stacks: datagrams read from the fd for connections that
+    //! `owns` rejects go to `hand_off` instead, and connect() only picks local ports that `owns` accepts
+    void set_steering(const FlowOwner &owns, const HandOff &hand_off);
+
+    //! Parse a TCP segment out of `dgram` and hand it to its connection (or listener)
+    void datagram_received(const InternetDatagram &dgram);
+
+    //! Run one round of the event loop, waiting up to `timeout_ms` (-1: until something happens)
+    EventLoop::Result wait_next_event(const int timeout_ms) { return _eventloop.wait_next_event(timeout_ms); }
+
+    //! The event loop, to which the application may add its own rules (e.g. for sockets it proxies to)
+    EventLoop &event_loop() { return _eventloop; }
+
+    //! Number of connections, including ones that have not been accepted or are lingering
+    size_t connection_count() const { return _connections.size(); }
+
+    //! Datagrams dropped because the fd's queue was full
+    uint64_t dropped_datagrams() const { return _dropped_datagrams; }
+
+    //! \name
+    //! The EventLoop's rules refer to the stack, so it cannot be copied or moved
+
+    //!@{
+    TCPStack(const TCPStack &) = delete;
+    TCPStack &operator=(const TCPStack &) = delete;
+    TCPStack(TCPStack &&) = delete;
+    TCPStack &operator=(TCPStack &&) = delete;
+    //!@}
+};
+
+//! \class TCPStack
+//! Unlike TCPSpongeSocket, which runs one TCPConnection on its own thread, a TCPStack runs every
+//! connection on the caller's thread. Each datagram read from the fd is demultiplexed by its
+//! FourTuple through a hash table; a SYN that matches no connection but a listening port starts a
+//! new one, and anything else that matches nothing is answered with a RST.
+//!
+//! The connections' timers share one TimerWheel, and one EventLoop timer wakes the loop for the
+//! earliest of them, so connections that are idle cost nothing per round of the event loop.
+//!
+//! The application does not poll connections: after a segment or a timer has changed a connection,
+//! the ConnectionHandler is called with it, and the application reads, writes or closes it from
+//! there. Connections in an accept queue belong to the stack (and the handler does not hear about
+//! them) until accept() hands them out.
+
+#endif  // SPONGE_LIBSPONGE_TCP_STACK_HH
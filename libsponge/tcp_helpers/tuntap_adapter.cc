@@ -1,7 +1,142 @@
 #include "tuntap_adapter.hh"
 
+#include <cstring>
+#include <limits>
+#include <string>
+
 using namespace std;
 
+//! Largest TCP segment (header included) that one TSO super-segment may carry in an IPv4 datagram
+static constexpr size_t MAX_TSO_SEGMENT = numeric_limits<uint16_t>::max() - IPv4Header::LENGTH;
+
+//! \details With a vnet header, the datagram may be a TCP segment of up to 64 KiB that the kernel
+//! has not cut into MSS-sized pieces; it goes to TCPConnection whole.
+optional<TCPSegment>
+TCPOverIPv4OverTunFdAdapter::read()
+{
+    if (not _tun.vnet_hdr()) {
+        InternetDatagram ip_dgram;
+        if (ip_dgram.parse(_tun.read()) != ParseResult::NoError) {
+            return {};
+        }
+        return unwrap_tcp_in_ip(ip_dgram);
+    }
+
+    Buffer packet{_tun.read(sizeof(VirtioNetHeader) + numeric_limits<uint16_t>::max())};
+    if (packet.size() < sizeof(VirtioNetHeader)) {
+        return {};
+    }
+    VirtioNetHeader vnet{};
+    memcpy(&vnet, packet.str().data(), sizeof(vnet));
+    packet.remove_prefix(sizeof(vnet));
+
+    InternetDatagram ip_dgram;
+    if (ip_dgram.parse(packet) != ParseResult::NoError) {
+        return {};
+    }
+    // NEEDS_CSUM: the kernel left the TCP checksum to the "device"; only the pseudo-header's sum is there
+    return unwrap_tcp_in_ip(ip_dgram,
+                            vnet.flags & (VirtioNetHeader::F_NEEDS_CSUM | VirtioNetHeader::F_DATA_VALID));
+}
+
+//! \param[in] seg the TCPSegment to send
+void
+TCPOverIPv4OverTunFdAdapter::write(TCPSegment& seg)
+{
+    if (not _tun.vnet_hdr()) {
+        _tun.write(wrap_tcp_in_ip(seg).serialize());
+        return;
+    }
+    _unsent.push_back(seg);
+}
+
+void
+TCPOverIPv4OverTunFdAdapter::flush()
+{
+    for (size_t first = 0; first < _unsent.size();) {
+        size_t length = _unsent[first].header().length() + _unsent[first].payload().size();
+        size_t last = first + 1;
+        while (last < _unsent.size() and continues_run(_unsent[first], _unsent[last - 1], _unsent[last]) and
+               length + _unsent[last].payload().size() <= MAX_TSO_SEGMENT) {
+            length += _unsent[last++].payload().size();
+        }
+        write_run(first, last);
+        first = last;
+    }
+    _unsent.clear();
+}
+
+//! \details The kernel cuts a super-segment's payload into pieces the size of the first segment's,
+//! and copies the TCP header onto each (advancing the sequence number, and keeping FIN and PSH
+//! for the last piece only). So the run may only grow by a segment whose header would come out
+//! the same way.
+bool
+TCPOverIPv4OverTunFdAdapter::continues_run(const TCPSegment& first, const TCPSegment& previous,
+                                           const TCPSegment& next)
+{
+    const TCPHeader& a = previous.header();
+    const TCPHeader& b = next.header();
+    if (a.syn or a.rst or a.urg or a.fin or b.syn or b.rst or b.urg) {
+        return false;
+    }
+    if (first.payload().size() == 0 or previous.payload().size() != first.payload().size() or
+        next.payload().size() == 0 or next.payload().size() > first.payload().size()) {
+        return false;
+    }
+    return b.seqno == a.seqno + previous.payload().size() and a.ack == b.ack and a.ackno == b.ackno and
+           a.win == b.win and a.ts == b.ts and a.tsval == b.tsval and a.tsecr == b.tsecr and
+           a.sack.empty() and b.sack.empty();
+}
+
+//! \param[in] first index of the run's first segment in `_unsent`
+//! \param[in] last index just past the run's last segment
+void
+TCPOverIPv4OverTunFdAdapter::write_run(const size_t first, const size_t last)
+{
+    VirtioNetHeader vnet{};
+    if (last - first == 1) {
+        BufferList packet{string(reinterpret_cast<const char*>(&vnet), sizeof(vnet))};
+        packet.append(wrap_tcp_in_ip(_unsent[first]).serialize());
+        _tun.write(packet);
+        return;
+    }
+
+    // one header for the run, with the last segment's FIN and PSH
+    TCPHeader header = _unsent[first].header();
+    header.sport = config().source.port();
+    header.dport = config().destination.port();
+    header.fin = _unsent[last - 1].header().fin;
+    header.psh = _unsent[last - 1].header().psh;
+
+    size_t payload_size = 0;
+    for (size_t i = first; i < last; i++) {
+        payload_size += _unsent[i].payload().size();
+    }
+
+    InternetDatagram ip_dgram;
+    ip_dgram.header().src = config().source.ipv4_numeric();
+    ip_dgram.header().dst = config().destination.ipv4_numeric();
+    ip_dgram.header().len = ip_dgram.header().hlen * 4 + header.length() + payload_size;
+
+    // the kernel checksums each piece, starting from the pseudo-header's (uncomplemented) sum
+    header.cksum = static_cast<uint16_t>(~InternetChecksum(ip_dgram.header().pseudo_cksum()).value());
+    ip_dgram.payload().append(header.serialize());
+    for (size_t i = first; i < last; i++) {
+        ip_dgram.payload().append(_unsent[i].payload());
+    }
+
+    vnet.flags = VirtioNetHeader::F_NEEDS_CSUM;
+    vnet.gso_type = VirtioNetHeader::GSO_TCPV4;
+    vnet.hdr_len = ip_dgram.header().hlen * 4 + header.length();
+    vnet.gso_size = _unsent[first].payload().size();
+    vnet.csum_start = ip_dgram.header().hlen * 4;
+    vnet.csum_offset = 16;  // offset of the checksum in the TCP header
+
+    BufferList packet{string(reinterpret_cast<const char*>(&vnet), sizeof(vnet))};
+    packet.append(ip_dgram.serialize());
+    _tun.write(packet);
+}
+
 //! \param[in] tap Raw network device that will be owned by the adapter
 //! \param[in] eth_address Ethernet address (local address) of the adapter
 //! \param[in] ip_address IP address (local address) of the adapter
@@ -5,30 +5,40 @@
 #include "network_interface.hh"
 #include "tun.hh"
 
+#include <cstddef>
 #include <optional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
   private:
     TunFD _tun;
 
+    //! Segments write() has held back until flush(), to merge into TSO super-segments (vnet header only)
+    std::vector<TCPSegment> _unsent{};
+
+    //! Can `next` be sent as part of the same TSO super-segment as `first`, which `previous` ends so far?
+    static bool continues_run(const TCPSegment &first, const TCPSegment &previous, const TCPSegment &next);
+
+    //! Write `_unsent[first, last)` as one TSO super-segment behind a VirtioNetHeader
+    void write_run(const size_t first, const size_t last);
+
   public:
     //! Construct from a TunFD
     explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) {}
 
     //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
-    std::optional<TCPSegment> read() {
-        InternetDatagram ip_dgram;
-        if (ip_dgram.parse(_tun.read()) != ParseResult::NoError) {
-            return {};
-        }
-        return unwrap_tcp_in_ip(ip_dgram);
-    }
+    std::optional<TCPSegment> read();
 
     //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-    void write(TCPSegment &seg) { _tun.write(wrap_tcp_in_ip(seg).serialize()); }
+    //! (at the next flush(), if the TunFD has a vnet header)
+    void write(TCPSegment &seg);
+
+    //! Write the segments that write() has held back, merging runs of full-size segments into
+    //! TSO super-segments
+    void flush();
 
     //! Access the underlying TUN device
     operator TunFD &() { return _tun; }
@@ -66,6 +76,9 @@ class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
     //! Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
 
+    //! Milliseconds until tick() has ARP work to do
+    std::optional<uint64_t> time_until_next_timer() const { return _interface.time_until_next_timer(); }
+
     //! Access the underlying raw Ethernet connection
     operator TapFD &() { return _tap; }
 
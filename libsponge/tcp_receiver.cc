@@ -1,5 +1,7 @@
 #include "tcp_receiver.hh"
 
+#include <algorithm>
+
 using namespace std;
 
 bool
@@ -38,8 +40,12 @@ TCPReceiver::segment_received(const TCPSegment& seg)
                    (abs_seqno_end >= win_start && abs_seqno_end <= win_end);   // 后半部分进入窗口
 
     if (inbound) {
-        _reassembler.push_substring(
-            seg.payload().copy(), abs_seqno - 1, seg.header().fin);   // 忽视syn，所以减1
+        // 忽视syn，所以减1
+        const uint64_t index = abs_seqno + seg.header().syn - 1;
+        if (index > _reassembler.first_unassembled_byte() && seg.payload().size() > 0) {
+            _recent_out_of_order = index;
+        }
+        _reassembler.push_substring(seg.payload(), abs_seqno - 1, seg.header().fin);
         _checkpoint = _reassembler.first_unassembled_byte();
     }
 
@@ -78,3 +84,29 @@ TCPReceiver::window_size() const
 {
     return stream_out().remaining_capacity();
 }
+
+vector<SACKBlock>
+TCPReceiver::sack_blocks(const size_t max_blocks) const
+{
+    vector<SACKBlock> blocks;
+    if (!_syn_received) {
+        return blocks;
+    }
+
+    auto ranges = _reassembler.unassembled_ranges();
+    // RFC 2018：第一个块必须包含最近收到的报文
+    const auto recent = find_if(ranges.begin(), ranges.end(), [this](const auto& range) {
+        return range.first <= _recent_out_of_order && _recent_out_of_order < range.second;
+    });
+    if (recent != ranges.end()) {
+        rotate(ranges.begin(), recent, recent + 1);
+    }
+
+    for (const auto& [begin, end] : ranges) {
+        if (blocks.size() == max_blocks) {
+            break;
+        }
+        blocks.push_back({wrap(begin + 1, _isn), wrap(end + 1, _isn)});
+    }
+    return blocks;
+}
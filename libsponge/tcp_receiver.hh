@@ -7,6 +7,7 @@
 #include "wrapping_integers.hh"
 
 #include <optional>
+#include <vector>
 
 //! \brief The "receiver" part of a TCP implementation.
 
@@ -21,6 +22,8 @@ class TCPReceiver {
     WrappingInt32 _isn;
     WrappingInt32 _ackno;
     uint64_t _checkpoint;
+    //! stream index of the most recent segment stored out of order, reported in the first SACK block
+    uint64_t _recent_out_of_order{0};
 
   public:
     //! \brief Construct a TCP receiver
@@ -51,6 +54,13 @@ class TCPReceiver {
     //! accepted by the receiver) and (b) the sequence number of the
     //! beginning of the window (the ackno).
     size_t window_size() const;
+
+    //! \brief SACK blocks (RFC 2018) describing the data held beyond the ackno
+    //!
+    //! The block holding the most recently received out-of-order segment comes first,
+    //! the rest follow in sequence order.
+    //! \param max_blocks the most blocks that fit in the segment's option space
+    std::vector<SACKBlock> sack_blocks(size_t max_blocks = TCPHeader::MAX_SACK_BLOCKS) const;
     //!@}
 
     //! \brief number of bytes stored but not yet reassembled
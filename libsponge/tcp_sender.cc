@@ -2,6 +2,7 @@
 
 #include "tcp_config.hh"
 
+#include <cmath>
 #include <random>
 
 using namespace std;
@@ -25,9 +26,59 @@ TCPSender::TCPSender(const size_t capacity, const uint16_t retx_timeout,
     _fin_sent(false),
     _initial_retransmission_timeout(retx_timeout),
     _consecutive_retransmissions{0},
-    _time(0),
     _retransmission_timeout(retx_timeout)
 {
+    _rtt.rto = retx_timeout;
+}
+
+//! \param[in] config uses `send_capacity`, `rt_timeout`, `fixed_isn`, `congestion_control`,
+//! `adaptive_rto` and `min_rto`
+TCPSender::TCPSender(const TCPConfig& config) :
+    TCPSender(config.send_capacity, config.rt_timeout, config.fixed_isn)
+{
+    _congestion_control = make_congestion_control(config.congestion_control);
+    _adaptive_rto = config.adaptive_rto;
+    _min_rto = config.min_rto;
+}
+
+void
+TCPSender::rtt_sample(const uint64_t rtt)
+{
+    // RFC 6298 (2.2) 与 (2.3)
+    if (_rtt.samples == 0) {
+        _rtt.srtt = rtt;
+        _rtt.rttvar = rtt / 2.0;
+        _rtt.min = rtt;
+    } else {
+        _rtt.rttvar = 0.75 * _rtt.rttvar + 0.25 * abs(_rtt.srtt - rtt);
+        _rtt.srtt = 0.875 * _rtt.srtt + 0.125 * rtt;
+        _rtt.min = min(_rtt.min, rtt);
+    }
+    _rtt.latest = rtt;
+    _rtt.samples++;
+
+    // 时钟粒度为 1ms
+    const auto rto = static_cast<uint64_t>(_rtt.srtt + max(1.0, 4 * _rtt.rttvar));
+    _rtt.rto = min<uint64_t>(max(rto, _min_rto), TCPConfig::MAX_RTO);
+}
+
+RTTStatistics
+TCPSender::rtt_statistics() const
+{
+    RTTStatistics stats = _rtt;
+    stats.rto = _retransmission_timeout;
+    return stats;
+}
+
+uint64_t
+TCPSender::send_window() const
+{
+    // 防止接收窗口为0
+    const uint64_t window = _window_size ? _window_size : 1;
+    if (_congestion_control) {
+        return min(window, _congestion_control->cwnd());
+    }
+    return window;
 }
 
 uint64_t
@@ -46,7 +97,7 @@ TCPSender::fill_window()
         make_segment_and_send(seg);
         _syn_flag = true;
         // 开始发送 SYN 了，说明协议启动
-        state = TcpState::running;
+        start_retransmission_timer();
         return;
     }
     // 已经发送过 SYN，拒绝第二次发送
@@ -54,16 +105,15 @@ TCPSender::fill_window()
         return;
     }
 
-    // 防止接收窗口为0
-    uint16_t copy_window_size = _window_size ? _window_size : 1;
-    while ((copy_window_size - (_next_seqno - _recv_ackno)) > 0) {
+    // 窗口可能比已发出的数据还小（例如拥塞窗口刚刚减小），此时不能再发送
+    const uint64_t window = send_window();
+    while (window > _next_seqno - _recv_ackno) {
         if (_stream.eof() && _fin_sent) {
             return;
         }
         TCPSegment seg;
-        size_t size =
-            min(copy_window_size - (_next_seqno - _recv_ackno), TCPConfig::MAX_PAYLOAD_SIZE);
-        seg.payload() = Buffer(_stream.read(size));
+        size_t size = min(window - (_next_seqno - _recv_ackno), TCPConfig::MAX_PAYLOAD_SIZE);
+        seg.payload() = _stream.read_buffer(size);
         // 字节流为eof且过去没有发送过 FIN，需要增加FIN
         if (_stream.eof() && !_fin_sent) {
             seg.header().fin = true;
@@ -74,16 +124,19 @@ TCPSender::fill_window()
             return;
         }
         make_segment_and_send(seg);
-        state = TcpState::running;
+        start_retransmission_timer();
     }
 }
 
 //! \param ackno The remote receiver's ackno (acknowledgment number)
-//! \param window_size The remote receiver's advertised window size
+//! \param window_size The remote receiver's advertised window size, in bytes (already scaled if
+//! window scaling is in use)
+//! \param extras timestamps and SACK blocks carried by the segment, and whether it has a payload
 //! \returns `false` if the ackno appears invalid (acknowledges something the TCPSender hasn't sent
 //! yet)
 bool
-TCPSender::ack_received(const WrappingInt32& ackno, const uint16_t& window_size)
+TCPSender::ack_received(const WrappingInt32& ackno, const uint64_t window_size,
+                        const AckExtras& extras)
 {
     uint64_t abs_ackno = unwrap(ackno, _isn, _next_seqno);
     if (abs_ackno > _next_seqno) {
@@ -91,63 +144,253 @@ TCPSender::ack_received(const WrappingInt32& ackno, const uint16_t& window_size)
     }
 
     // NOTE: ACK报文合法，需要在返回前修改 window_size
+    const uint64_t old_window_size = _window_size;
     _window_size = window_size;
 
+    const uint64_t newly_sacked = update_scoreboard(extras.sack);
+
     // NOTE: 这是合法的，根据测试用例得出。因为存在接收端多次发送ACK报文的情况
     if (abs_ackno <= _recv_ackno) {
+        // 重复 ACK：不带数据，有未确认的数据，并且窗口不变或带来了新的 SACK 信息 (RFC 5681)
+        if (_congestion_control && abs_ackno == _recv_ackno && _bytes_in_flight > 0 &&
+            !extras.carries_data && (window_size == old_window_size || newly_sacked > 0)) {
+            duplicate_ack();
+        }
         return true;
     }
 
     // 接收到任意合法 ACK，说明发送的 SYN 有效
     _old_syn_flag = true;
 
+    const uint64_t old_recv_ackno = _recv_ackno;
+
     // 收到的序列号小于等于 `abs_ackno` ，将 `_segment_outgoing` 的一部分或全部 pop 出去
     while (!_segments_outgoing.empty()) {
-        TCPSegment seg = _segments_outgoing.front();
-        uint64_t seg_abs_ackno = unwrap(seg.header().seqno, _isn, _next_seqno);
-        if (seg_abs_ackno + seg.length_in_sequence_space() <= abs_ackno) {
-            _segments_outgoing.pop();
-            _bytes_in_flight -= seg.length_in_sequence_space();
-            _recv_ackno = seg_abs_ackno + seg.length_in_sequence_space();
+        const OutstandingSegment& outstanding = _segments_outgoing.front();
+        const uint64_t seg_end = outstanding.seqno + outstanding.length();
+        if (seg_end <= abs_ackno) {
+            _bytes_in_flight -= outstanding.length();
+            _recv_ackno = seg_end;
+            _segments_outgoing.pop_front();
         } else {
             break;
         }
     }
 
+    // RTT 测量：有时间戳时每个确认新数据的 ACK 都能测量；否则只测量一个未重传过的报文
+    if (extras.echoed_timestamp.has_value()) {
+        rtt_sample(static_cast<uint32_t>(_clock - extras.echoed_timestamp.value()));
+        _rtt_timing = false;
+    } else if (_rtt_timing && _recv_ackno >= _rtt_timed_seqno) {
+        rtt_sample(_clock - _rtt_timed_at);
+        _rtt_timing = false;
+    }
+
+    // 握手阶段的 SYN 不计入拥塞窗口的增长
+    if (_congestion_control && old_recv_ackno > 0 && _recv_ackno > old_recv_ackno) {
+        _duplicate_acks = 0;
+        const bool was_in_recovery = _congestion_control->in_recovery();
+        _congestion_control->on_ack(_recv_ackno - old_recv_ackno, _recv_ackno, _clock);
+        if (_congestion_control->in_recovery() && !_segments_outgoing.empty()) {
+            // 部分确认：紧接着的报文也丢失了 (RFC 6582)
+            OutstandingSegment& front = _segments_outgoing.front();
+            if (!front.retransmitted) {
+                retransmit(front);
+            }
+            retransmit_lost();
+        } else if (_recv_ackno < _recovery_point) {
+            // 超时之后：在拥塞窗口允许时继续重传
+            retransmit_lost();
+        } else if (was_in_recovery) {
+            recovery_finished();
+        }
+    }
+
     // 收到ACK以后也要在报文中附上数据
     fill_window();
 
-    // 收到 ACK 以后需要重置计时器
-    _time = 0;
+    // 收到 ACK 以后需要重置计时器；当没有尚未回复的报文的时候，需要停止计时
     _consecutive_retransmissions = 0;
-    _retransmission_timeout = _initial_retransmission_timeout;
+    _retransmission_timeout =
+        _adaptive_rto && _rtt.samples > 0 ? _rtt.rto : _initial_retransmission_timeout;
+    restart_retransmission_timer();
+    return true;
+}
 
-    if (_segments_outgoing.empty()) {
-        // 当没有尚未回复的报文的时候，需要停止TCP
-        state = TcpState::stop;
+uint64_t
+TCPSender::update_scoreboard(const vector<SACKBlock>& blocks)
+{
+    uint64_t newly_sacked = 0;
+    for (const auto& block : blocks) {
+        const uint64_t begin = unwrap(block.begin, _isn, _next_seqno);
+        const uint64_t end = unwrap(block.end, _isn, _next_seqno);
+        // 忽略不合法的块
+        if (begin >= end || end > _next_seqno) {
+            continue;
+        }
+        for (auto& outstanding : _segments_outgoing) {
+            if (!outstanding.sacked && outstanding.seqno >= begin &&
+                outstanding.seqno + outstanding.length() <= end) {
+                outstanding.sacked = true;
+                newly_sacked += outstanding.length();
+            }
+        }
     }
-    return true;
+    return newly_sacked;
 }
 
-//! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void
-TCPSender::tick(const size_t ms_since_last_tick)
+TCPSender::duplicate_ack()
 {
-    if (state == TcpState::stop) {
+    _duplicate_acks++;
+    if (_congestion_control->in_recovery()) {
+        // 恢复期间每个 ACK 都可能带来新的 SACK 信息
+        retransmit_lost();
         return;
     }
-    _time += ms_since_last_tick;
-    if (_time >= _retransmission_timeout) {
-        _consecutive_retransmissions++;
-        _retransmission_timeout *= 2;
-        // 需要重置计时器 _time!
-        _time = 0;
-        if (!_segments_outgoing.empty()) {
-            _segments_out.push(_segments_outgoing.front());
+    if (_recv_ackno < _recovery_point) {
+        return;
+    }
+    mark_lost();
+    if (_duplicate_acks >= DUPACK_THRESHOLD || _segments_outgoing.front().lost) {
+        enter_recovery();
+    }
+}
+
+void
+TCPSender::enter_recovery()
+{
+    _congestion_control->on_loss(_bytes_in_flight, _next_seqno, _clock);
+    _recovery.fast_recoveries++;
+    _recovery_started_at = _clock;
+    for (auto& outstanding : _segments_outgoing) {
+        outstanding.retransmitted = false;
+    }
+    retransmit(_segments_outgoing.front());
+    retransmit_lost();
+}
+
+void
+TCPSender::mark_lost()
+{
+    // 从后往前统计每个报文之后被 SACK 的报文数与字节数
+    uint64_t sacked_segments = 0, sacked_bytes = 0;
+    for (auto it = _segments_outgoing.rbegin(); it != _segments_outgoing.rend(); ++it) {
+        if (it->sacked) {
+            sacked_segments++;
+            sacked_bytes += it->length();
+            it->lost = false;
         } else {
-            state = TcpState::stop;
+            it->lost = sacked_segments >= DUPACK_THRESHOLD ||
+                       sacked_bytes > (DUPACK_THRESHOLD - 1) * TCPConfig::MAX_PAYLOAD_SIZE;
         }
     }
+    // 超时之后，ackno 停在哪里，哪里的报文就丢失了
+    if (_recv_ackno < _recovery_point && !_segments_outgoing.empty()) {
+        _segments_outgoing.front().lost = true;
+    }
+}
+
+void
+TCPSender::retransmit_lost()
+{
+    mark_lost();
+
+    // 估计网络中的字节数：丢失的报文不算，重传过的再算一次 (RFC 6675 SetPipe)
+    uint64_t pipe = 0;
+    for (const auto& outstanding : _segments_outgoing) {
+        if (outstanding.sacked) {
+            continue;
+        }
+        const uint64_t length = outstanding.length();
+        pipe += (outstanding.lost ? 0 : length) + (outstanding.retransmitted ? length : 0);
+    }
+
+    for (auto& outstanding : _segments_outgoing) {
+        if (pipe >= _congestion_control->cwnd()) {
+            break;
+        }
+        if (outstanding.lost && !outstanding.retransmitted) {
+            retransmit(outstanding);
+            pipe += outstanding.length();
+        }
+    }
+}
+
+void
+TCPSender::retransmit(OutstandingSegment& outstanding)
+{
+    _segments_out.push(build_segment(outstanding));
+    outstanding.retransmitted = true;
+    _recovery.retransmissions++;
+    // Karn 算法：重传后放弃本次测量
+    _rtt_timing = false;
+}
+
+void
+TCPSender::recovery_finished()
+{
+    _recovery.recovery_ms += _clock - _recovery_started_at;
+}
+
+void
+TCPSender::start_retransmission_timer()
+{
+    if (!_retransmission_timer.has_value()) {
+        _retransmission_timer = _timers.schedule_at(_clock + _retransmission_timeout);
+    }
+}
+
+void
+TCPSender::restart_retransmission_timer()
+{
+    if (_retransmission_timer.has_value()) {
+        _timers.cancel(_retransmission_timer.value());
+        _retransmission_timer.reset();
+    }
+    if (!_segments_outgoing.empty()) {
+        start_retransmission_timer();
+    }
+}
+
+//! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
+void
+TCPSender::tick(const size_t ms_since_last_tick)
+{
+    _clock += ms_since_last_tick;
+    _timers.advance(ms_since_last_tick, [this](TimerWheel::TimerId, uint64_t) {
+        _retransmission_timer.reset();
+        retransmission_timeout();
+    });
+}
+
+void
+TCPSender::retransmission_timeout()
+{
+    // 零窗口探测超时并不代表拥塞；同一个报文再次超时，ssthresh 保持不变 (RFC 5681)
+    if (_congestion_control && _window_size != 0 && _consecutive_retransmissions == 0) {
+        if (_congestion_control->in_recovery()) {
+            recovery_finished();
+        }
+        _congestion_control->on_rto(_bytes_in_flight, _clock);
+        // 超时之后重新开始恢复；本实现的接收端不会丢弃已 SACK 的数据，SACK 标记保留
+        _recovery_point = _next_seqno;
+        _duplicate_acks = 0;
+        for (auto& outstanding : _segments_outgoing) {
+            outstanding.retransmitted = false;
+        }
+    }
+    _recovery.timeouts++;
+    _consecutive_retransmissions++;
+    _retransmission_timeout *= 2;
+    if (_adaptive_rto) {
+        _retransmission_timeout = min<uint64_t>(_retransmission_timeout, TCPConfig::MAX_RTO);
+    }
+    // 从这次 tick 结束时重新计时，所以一次 tick 最多超时一次
+    if (!_segments_outgoing.empty()) {
+        retransmit(_segments_outgoing.front());
+        start_retransmission_timer();
+    }
 }
 
 unsigned int
@@ -171,6 +414,25 @@ TCPSender::make_segment_and_send(TCPSegment& seg)
     seg.header().seqno = segno;
     _next_seqno += seg.length_in_sequence_space();
     _bytes_in_flight += seg.length_in_sequence_space();
-    _segments_out.push(seg);
-    _segments_outgoing.push(seg);
+    if (!_rtt_timing) {
+        _rtt_timing = true;
+        _rtt_timed_seqno = _next_seqno;
+        _rtt_timed_at = _clock;
+    }
+    _segments_outgoing.push_back({_next_seqno - seg.length_in_sequence_space(),
+                                  seg.payload(),
+                                  seg.header().syn,
+                                  seg.header().fin});
+    _segments_out.push(std::move(seg));
+}
+
+TCPSegment
+TCPSender::build_segment(const OutstandingSegment& outstanding) const
+{
+    TCPSegment seg;
+    seg.header().seqno = wrap(outstanding.seqno, _isn);
+    seg.header().syn = outstanding.syn;
+    seg.header().fin = outstanding.fin;
+    seg.payload() = outstanding.payload;
+    return seg;
 }
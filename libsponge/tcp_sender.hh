@@ -2,16 +2,44 @@
 #define SPONGE_LIBSPONGE_TCP_SENDER_HH
 
 #include "byte_stream.hh"
+#include "congestion_control.hh"
 #include "tcp_config.hh"
 #include "tcp_segment.hh"
+#include "timer_wheel.hh"
 #include "wrapping_integers.hh"
 
+#include <deque>
+#include <memory>
+#include <optional>
 #include <queue>
+#include <vector>
 
-enum class TcpState
+//! \brief Round-trip time measurements kept by a TCPSender ([RFC 6298](\ref rfc::rfc6298))
+struct RTTStatistics
 {
-    running,
-    stop
+    uint64_t samples{0};   //!< number of RTT measurements taken
+    uint64_t latest{0};    //!< most recent measurement, in milliseconds
+    uint64_t min{0};       //!< smallest measurement, in milliseconds
+    double srtt{0};        //!< smoothed round-trip time, in milliseconds
+    double rttvar{0};      //!< round-trip time variation, in milliseconds
+    uint64_t rto{0};       //!< current retransmission timeout (including backoff), in milliseconds
+};
+
+//! \brief How a TCPSender recovered from losses
+struct RecoveryStatistics
+{
+    uint64_t fast_recoveries{0};   //!< losses repaired after duplicate ACKs or SACK
+    uint64_t timeouts{0};          //!< retransmission timer expirations
+    uint64_t retransmissions{0};   //!< segments sent more than once, for any reason
+    uint64_t recovery_ms{0};       //!< total time spent in fast recovery, in milliseconds
+};
+
+//! \brief Everything besides the ackno and window in an incoming segment that a TCPSender uses
+struct AckExtras
+{
+    std::optional<uint32_t> echoed_timestamp{};   //!< `tsecr`, if timestamps are in use
+    std::vector<SACKBlock> sack{};                //!< SACK blocks, if SACK is in use
+    bool carries_data{false};   //!< the segment has a payload, so it is not a duplicate ACK
 };
 
 //! \brief The "sender" part of a TCP implementation.
@@ -29,8 +57,28 @@ private:
     //! outbound queue of segments that the TCPSender wants sent
     std::queue<TCPSegment> _segments_out;
 
+    //! 已发出但未被确认的报文，以及 SACK 记分板。
+    //! 不保存整个 TCPSegment：载荷与发出的报文共享存储，重传时再构造报文头
+    struct OutstandingSegment
+    {
+        uint64_t seqno;               //!< 绝对序列号
+        Buffer payload;
+        bool syn{false};
+        bool fin{false};
+        bool sacked{false};           //!< 对方已通过 SACK 确认收到
+        bool retransmitted{false};    //!< 本次恢复中已重传过
+        bool lost{false};             //!< 之后已有足够多的数据被 SACK，认为已丢失
+
+        //! 占用的序列号个数
+        uint64_t
+        length() const
+        {
+            return payload.size() + syn + fin;
+        }
+    };
+
     //! outstanding segments that the TCPSender may resend
-    std::queue<TCPSegment> _segments_outgoing;
+    std::deque<OutstandingSegment> _segments_outgoing;
 
     //! bytes in flight
     uint64_t _bytes_in_flight;
@@ -39,7 +87,7 @@ private:
     uint64_t _recv_ackno;
 
     //! notify the window size
-    uint16_t _window_size;
+    uint64_t _window_size;
 
     //! outgoing stream of bytes that have not yet been sent
     ByteStream _stream;
@@ -62,24 +110,104 @@ private:
     //! 重传次数
     unsigned int _consecutive_retransmissions;
 
-    //! 连接状态（是否正在运行）
-    TcpState state{TcpState::stop};
-
-    //! 内部时钟
-    uint64_t _time;
-
     //! 超时重传时间
     uint64_t _retransmission_timeout;
 
+    //! 所有 tick 的累计时间，拥塞控制算法以它为时钟
+    uint64_t _clock{0};
+
+    //! 定时器，与 `_clock` 同步推进
+    TimerWheel _timers{};
+
+    //! 重传计时器；没有未确认的报文时不运行
+    std::optional<TimerWheel::TimerId> _retransmission_timer{};
+
+    //! 重传计时器没有运行时启动它
+    void start_retransmission_timer();
+
+    //! 重新开始计时，没有未确认的报文时停止计时
+    void restart_retransmission_timer();
+
+    //! 重传计时器超时
+    void retransmission_timeout();
+
+    //! 拥塞控制算法；为空时只受接收方窗口限制
+    std::unique_ptr<CongestionControl> _congestion_control{};
+
+    //! RTT 测量结果；`_rtt.rto` 是根据测量值算出的 RTO（不含退避）
+    RTTStatistics _rtt{};
+
+    //! 是否用 `_rtt.rto` 代替 `_initial_retransmission_timeout`
+    bool _adaptive_rto{false};
+
+    //! 估计出的 RTO 的下限
+    uint64_t _min_rto{TCPConfig::MIN_RTO_DFLT};
+
+    //! 正在计时的报文的结束序号与发送时间；Karn 算法：重传后放弃本次测量
+    bool _rtt_timing{false};
+    uint64_t _rtt_timed_seqno{0};
+    uint64_t _rtt_timed_at{0};
+
+    //! 加入一次 RTT 测量，更新 SRTT、RTTVAR 与 RTO
+    void rtt_sample(uint64_t rtt);
+
+    //! \name 快速重传与 SACK 恢复 (RFC 5681, RFC 6582, RFC 6675)
+    //! 只在有拥塞控制算法时启用，没有拥塞控制时丢包只能靠超时重传恢复
+    //!@{
+    static constexpr unsigned DUPACK_THRESHOLD = 3;
+
+    //! 连续收到的重复 ACK 个数
+    unsigned _duplicate_acks{0};
+
+    //! 超时重传时的 `_next_seqno`。在它被确认前，重复 ACK 不会触发快速重传 (RFC 6582)，
+    //! 而每个推进了 ackno 的 ACK 都会重传下一个未确认的报文
+    uint64_t _recovery_point{0};
+
+    //! 进入快速恢复的时间
+    uint64_t _recovery_started_at{0};
+
+    RecoveryStatistics _recovery{};
+
+    //! 根据 SACK 块标记记分板，返回新被 SACK 的字节数
+    uint64_t update_scoreboard(const std::vector<SACKBlock>& blocks);
+
+    //! 处理一个重复 ACK
+    void duplicate_ack();
+
+    //! 进入快速恢复并重传第一个未确认的报文
+    void enter_recovery();
+
+    //! 根据记分板标记丢失的报文 (RFC 6675 IsLost)
+    void mark_lost();
+
+    //! 在拥塞窗口允许时重传记分板认为已丢失的报文 (RFC 6675 NextSeg 的规则 1)
+    void retransmit_lost();
+
+    //! 重传一个未确认的报文
+    void retransmit(OutstandingSegment& outstanding);
+
+    //! 快速恢复结束时记录用时
+    void recovery_finished();
+    //!@}
+
+    //! 对方通告的窗口与拥塞窗口中较小的一个
+    uint64_t send_window() const;
+
     //! 设置报文序列号，并且推入发送队列
     void make_segment_and_send(TCPSegment& seg);
 
+    //! 重新构造一个未确认的报文
+    TCPSegment build_segment(const OutstandingSegment& outstanding) const;
+
 public:
     //! Initialize a TCPSender
     explicit TCPSender(size_t capacity = TCPConfig::DEFAULT_CAPACITY,
                        uint16_t retx_timeout = TCPConfig::TIMEOUT_DFLT,
                        std::optional<WrappingInt32> fixed_isn = {});
 
+    //! Initialize a TCPSender with every sender-side option from a TCPConfig
+    explicit TCPSender(const TCPConfig& config);
+
     //! \name "Input" interface for the writer
     //!@{
     ByteStream&
@@ -98,7 +226,9 @@ public:
     //!@{
 
     //! \brief A new acknowledgment was received
-    bool ack_received(const WrappingInt32& ackno, const uint16_t& window_size);
+    //! \param extras timestamps and SACK blocks, if they were negotiated
+    bool ack_received(const WrappingInt32& ackno, uint64_t window_size,
+                      const AckExtras& extras = {});
 
     //! \brief Generate an empty-payload segment (useful for creating empty ACK segments)
     void send_empty_segment();
@@ -121,6 +251,38 @@ public:
     //! \brief Number of consecutive retransmissions that have occurred in a row
     unsigned int consecutive_retransmissions() const;
 
+    //! \brief Round-trip time measurements and the current RTO
+    RTTStatistics rtt_statistics() const;
+
+    //! \brief Counts of fast recoveries, timeouts and retransmissions
+    RecoveryStatistics
+    recovery_statistics() const
+    {
+        return _recovery;
+    }
+
+    //! \brief Milliseconds until tick() may have work to do, or `nullopt` if no timer is running
+    //! \note May be earlier than the retransmission timeout; ticking early is harmless
+    std::optional<uint64_t>
+    time_until_next_timer() const
+    {
+        return _timers.time_until_next_expiration();
+    }
+
+    //! \brief The sender's millisecond clock, used as the timestamp value of outgoing segments
+    uint32_t
+    timestamp() const
+    {
+        return static_cast<uint32_t>(_clock);
+    }
+
+    //! \brief The congestion control algorithm, or `nullptr` if there is none
+    const CongestionControl*
+    congestion_control() const
+    {
+        return _congestion_control.get();
+    }
+
     //! \brief TCPSegments that the TCPSender has enqueued for transmission.
     //! \note These must be dequeued and sent by the TCPConnection,
     //! which will need to fill in the fields that are set by the TCPReceiver
@@ -9,11 +9,31 @@ Buffer::remove_prefix(const size_t n)
         throw out_of_range("Buffer::remove_prefix");
     }
     _starting_offset += n;
-    if (_storage and _starting_offset == _storage->size()) {
+    if (_storage and _starting_offset == _ending_offset) {
         _storage.reset();
     }
 }
 
+void
+Buffer::remove_suffix(const size_t n)
+{
+    if (n > str().size()) {
+        throw out_of_range("Buffer::remove_suffix");
+    }
+    _ending_offset -= n;
+    if (_storage and _starting_offset == _ending_offset) {
+        _storage.reset();
+    }
+}
+
+void
+Buffer::compact_if_sparse(const size_t ratio)
+{
+    if (_storage and size() * ratio < _storage->capacity()) {
+        *this = Buffer(copy());
+    }
+}
+
 void
 BufferList::append(const BufferList& other)
 {
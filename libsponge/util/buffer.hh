@@ -16,12 +16,14 @@ class Buffer {
   private:
     std::shared_ptr<std::string> _storage{};
     size_t _starting_offset{};
+    size_t _ending_offset{};
 
   public:
     Buffer() = default;
 
     //! \brief Construct by taking ownership of a string
-    Buffer(std::string &&str) noexcept : _storage(std::make_shared<std::string>(std::move(str))) {}
+    Buffer(std::string &&str) noexcept
+        : _storage(std::make_shared<std::string>(std::move(str))), _ending_offset(_storage->size()) {}
 
     //! \name Expose contents as a std::string_view
     //!@{
@@ -29,7 +31,7 @@ class Buffer {
         if (not _storage) {
             return {};
         }
-        return {_storage->data() + _starting_offset, _storage->size() - _starting_offset};
+        return {_storage->data() + _starting_offset, _ending_offset - _starting_offset};
     }
 
     operator std::string_view() const { return str(); }
@@ -47,6 +49,17 @@ class Buffer {
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     //! \note Doesn't free any memory until the whole string has been discarded in all copies of the Buffer.
     void remove_prefix(const size_t n);
+
+    //! \brief Discard the last `n` bytes of the string (does not require a copy or move)
+    //! \note Other copies of the Buffer still see the discarded bytes.
+    void remove_suffix(const size_t n);
+
+    //! \brief Bytes allocated for the storage this Buffer shares (at least size())
+    size_t storage_capacity() const { return _storage ? _storage->capacity() : 0; }
+
+    //! \brief Copy the bytes into storage of their own if they fill less than 1/`ratio` of the shared storage
+    //! \note Keeps a small slice (e.g. a segment's payload) from holding on to a large receive buffer.
+    void compact_if_sparse(const size_t ratio = 2);
 };
 
 //! \brief A reference-counted discontiguous string that can discard bytes from the front
@@ -105,6 +118,8 @@ class BufferViewList {
     //! \name Constructors
     //!@{
 
+    BufferViewList() = default;
+
     //! \brief Construct from a std::string
     BufferViewList(const std::string &str) : BufferViewList(std::string_view(str)) {}
 
@@ -118,6 +133,16 @@ class BufferViewList {
     BufferViewList(std::string_view str) { _views.push_back({const_cast<char *>(str.data()), str.size()}); }
     //!@}
 
+    //! \brief Access the underlying queue of views
+    const std::deque<std::string_view> &views() const { return _views; }
+
+    //! \brief Append a view to the end (empty views are ignored)
+    void append(std::string_view str) {
+        if (not str.empty()) {
+            _views.push_back(str);
+        }
+    }
+
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     void remove_prefix(size_t n);
 
@@ -0,0 +1,78 @@
+#include "epoch.hh"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+using namespace std;
+
+size_t
+EpochDomain::enter()
+{
+    // start from a slot picked by the thread's id, so that concurrent readers rarely collide
+    const size_t start = hash<thread::id>{}(this_thread::get_id()) % MAX_READERS;
+    while (true) {
+        for (size_t i = 0; i < MAX_READERS; i++) {
+            const size_t slot = (start + i) % MAX_READERS;
+            uint64_t free = 0;
+            // sequentially consistent, so that a writer who advances the epoch after this either
+            // sees the slot or has already published what the reader will load
+            if (_slots[slot].epoch.load(memory_order_relaxed) == 0 and
+                _slots[slot].epoch.compare_exchange_strong(free, _epoch.load())) {
+                return slot;
+            }
+        }
+        this_thread::yield();
+    }
+}
+
+void
+EpochDomain::reclaim_locked()
+{
+    uint64_t oldest = numeric_limits<uint64_t>::max();
+    for (const auto& slot : _slots) {
+        const uint64_t epoch = slot.epoch.load();
+        if (epoch != 0) {
+            oldest = min(oldest, epoch);
+        }
+    }
+
+    // an object retired at epoch e may be held by readers that entered at e or before
+    const auto freeable = partition(_retired.begin(), _retired.end(), [oldest](const Retired& retired) {
+        return retired.epoch >= oldest;
+    });
+    for (auto it = freeable; it != _retired.end(); ++it) {
+        it->free();
+    }
+    _retired.erase(freeable, _retired.end());
+}
+
+EpochDomain::~EpochDomain()
+{
+    for (auto& retired : _retired) {
+        retired.free();
+    }
+}
+
+//! \param[in] free frees the object that was replaced
+void
+EpochDomain::retire(function<void()>&& free)
+{
+    lock_guard<mutex> lock{_retired_mutex};
+    _retired.push_back({_epoch.fetch_add(1), move(free)});
+    reclaim_locked();
+}
+
+void
+EpochDomain::reclaim()
+{
+    lock_guard<mutex> lock{_retired_mutex};
+    reclaim_locked();
+}
+
+size_t
+EpochDomain::pending() const
+{
+    lock_guard<mutex> lock{_retired_mutex};
+    return _retired.size();
+}
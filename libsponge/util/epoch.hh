@@ -0,0 +1,98 @@
+#ifndef SPONGE_LIBSPONGE_EPOCH_HH
+#define SPONGE_LIBSPONGE_EPOCH_HH
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+//! \brief Epoch-based reclamation of objects that lock-free readers may still be using
+
+//! Readers wrap each use of a shared, atomically published object in a Guard. A writer that replaces
+//! the object hands the old one to retire(), which frees it once no reader that could have loaded
+//! it is still inside its Guard.
+//!
+//! The domain keeps a global epoch. Entering a Guard claims one of MAX_READERS slots and records the
+//! current epoch in it; retire() tags the object with the epoch and then advances it. A reader that
+//! entered after the advance must have loaded the new object, so a retired object can be freed as
+//! soon as every claimed slot records a later epoch. Readers never block and never write anything
+//! that writers share, except for their own slot.
+class EpochDomain {
+  public:
+    //! Guards that may be held at the same time; a further Guard waits for one to be released
+    static constexpr size_t MAX_READERS = 64;
+
+    //! A read-side critical section: objects loaded while it is held are not freed until it ends
+    class Guard {
+        EpochDomain &_domain;
+        size_t _slot;
+
+      public:
+        explicit Guard(EpochDomain &domain) : _domain(domain), _slot(domain.enter()) {}
+        ~Guard() { _domain.leave(_slot); }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+    };
+
+  private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};  //!< Epoch at which the reader entered, or 0 if the slot is free
+    };
+    std::array<Slot, MAX_READERS> _slots{};
+
+    std::atomic<uint64_t> _epoch{1};
+
+    struct Retired {
+        uint64_t epoch;
+        std::function<void()> free;
+    };
+
+    mutable std::mutex _retired_mutex{};  //!< Serializes retire() and reclaim()
+    std::vector<Retired> _retired{};
+
+    //! Claim a slot and record the current epoch in it
+    //! \returns the slot's index
+    size_t enter();
+
+    //! Release a slot claimed by enter()
+    void leave(const size_t slot) { _slots[slot].epoch.store(0, std::memory_order_release); }
+
+    //! Free the retired objects that no reader can still hold (with `_retired_mutex` held)
+    void reclaim_locked();
+
+  public:
+    EpochDomain() = default;
+
+    //! Free every retired object; no Guard may still be held
+    ~EpochDomain();
+
+    //! Call `free` once no reader can still be using the object it frees
+    //! \note Call after the object has been replaced, so that new readers can no longer load it
+    void retire(std::function<void()> &&free);
+
+    //! Delete `object` once no reader can still be using it (see retire())
+    template <typename T>
+    void retire(const T *object) {
+        retire([object] { delete object; });
+    }
+
+    //! Free the retired objects that no reader can still hold; retire() also does this
+    void reclaim();
+
+    //! Number of retired objects not yet freed
+    size_t pending() const;
+
+    //! \name
+    //! Readers and writers refer to the domain, so it cannot be copied or moved
+
+    //!@{
+    EpochDomain(const EpochDomain &) = delete;
+    EpochDomain &operator=(const EpochDomain &) = delete;
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_EPOCH_HH
@@ -2,7 +2,9 @@
 
 #include "util.hh"
 
+#include <algorithm>
 #include <cerrno>
+#include <climits>
 #include <stdexcept>
 #include <system_error>
 #include <utility>
@@ -10,6 +12,25 @@
 
 using namespace std;
 
+static_assert(uint32_t(Direction::In) == EPOLLIN and uint32_t(Direction::Out) == EPOLLOUT,
+              "Direction values double as epoll events");
+
+EventLoop::EventLoop(const Backend backend) :
+    _backend(backend)
+{
+    if (_backend == Backend::IoUring) {
+        try {
+            _uring = make_unique<::IoUring>();
+        } catch (const unix_error&) {
+            // e.g. ENOSYS, or EPERM where io_uring is disabled
+            _backend = Backend::Epoll;
+        }
+    }
+    if (_backend == Backend::Epoll) {
+        _epoll.emplace(SystemCall("epoll_create1", ::epoll_create1(EPOLL_CLOEXEC)));
+    }
+}
+
 unsigned int
 EventLoop::Rule::service_count() const
 {
@@ -28,11 +49,93 @@ EventLoop::add_rule(const FileDescriptor& fd, const Direction direction, const C
                     const InterestT& interest, const CallbackT& cancel)
 {
     _rules.push_back({fd.duplicate(), direction, callback, interest, cancel});
+    if (_backend == Backend::Poll) {
+        return;
+    }
+
+    const int fd_num = fd.fd_num();
+    auto registration = _registrations.find(fd_num);
+    if (registration != _registrations.end() and registration->second.rules.front()->fd.closed()) {
+        // the fd number was closed and reused before wait_next_event noticed; forget the old rules
+        while (registration != _registrations.end()) {
+            cancel_rule(registration->second.rules.front());
+            registration = _registrations.find(fd_num);
+        }
+    }
+    if (registration == _registrations.end()) {
+        if (_backend == Backend::Epoll) {
+            // registered without events, so that errors and hangups are still reported
+            epoll_event event{};
+            event.data.fd = fd_num;
+            SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_ADD, fd_num, &event));
+        }
+        registration = _registrations.emplace(fd_num, Registration{}).first;
+    }
+    registration->second.rules.push_back(prev(_rules.end()));
+}
+
+void
+EventLoop::update_registration(const int fd_num)
+{
+    Registration& registration = _registrations.at(fd_num);
+    uint32_t events = 0;
+    for (const auto& rule : registration.rules) {
+        if (rule->polled) {
+            events |= uint32_t(rule->direction);
+        }
+    }
+    if (_backend == Backend::IoUring) {
+        // a changed mask replaces the outstanding poll, and a poll that fired is armed again
+        if (registration.poll_id != 0 and events != registration.events) {
+            _uring->prepare(IORING_OP_POLL_REMOVE, -1, 0).addr = registration.poll_id;
+            registration.poll_id = 0;
+        }
+        if (registration.poll_id == 0 and events != 0) {
+            registration.poll_id = uint64_t{++_poll_generation} << 32 | uint32_t(fd_num);
+            _uring->prepare(IORING_OP_POLL_ADD, fd_num, registration.poll_id).poll32_events = events;
+        }
+        registration.events = events;
+        return;
+    }
+    if (events != registration.events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd_num;
+        SystemCall("epoll_ctl", ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_MOD, fd_num, &event));
+        registration.events = events;
+    }
+}
+
+list<EventLoop::Rule>::iterator
+EventLoop::cancel_rule(const list<Rule>::iterator rule)
+{
+    rule->cancel();
+    if (_backend != Backend::Poll) {
+        const int fd_num = rule->fd.fd_num();
+        auto& rules = _registrations.at(fd_num).rules;
+        rules.erase(find(rules.begin(), rules.end(), rule));
+        if (rules.empty()) {
+            if (_backend == Backend::IoUring) {
+                if (const uint64_t poll_id = _registrations.at(fd_num).poll_id; poll_id != 0) {
+                    _uring->prepare(IORING_OP_POLL_REMOVE, -1, 0).addr = poll_id;
+                }
+            } else {
+                // fails harmlessly if the fd is already closed, which removed it from the epoll set
+                ::epoll_ctl(_epoll->fd_num(), EPOLL_CTL_DEL, fd_num, nullptr);
+            }
+            _registrations.erase(fd_num);
+        } else if (not rule->fd.closed()) {
+            rule->polled = false;
+            update_registration(fd_num);
+        }
+    }
+    return _rules.erase(rule);
 }
 
 //! \param[in] timeout_ms is the timeout value passed to [poll(2)](\ref man2::poll);
 //! `wait_next_event`
 //!                       returns Result::Timeout if no fd is ready after the timeout expires.
+//!                       A pending timer shortens the wait to its deadline.
 //! \returns Eventloop::Result indicating success, timeout, or no more Rule objects to poll.
 //!
 //! For each Rule, this function first calls Rule::interest; if `true`, Rule::fd is added to the
@@ -48,11 +151,13 @@ EventLoop::add_rule(const FileDescriptor& fd, const Direction direction, const C
 //!
 //! If an error occurs during polling, this function throws a std::runtime_error.
 //!
+//! Finally, it calls the callback of every timer whose deadline has passed.
+//!
 //! If a [signal(7)](\ref man7::signal) was caught during polling or if EventLoop::_rules becomes
-//! empty, this function returns Result::Exit.
+//! empty and no timer is pending, this function returns Result::Exit.
 //!
-//! If a timeout occurred while polling (i.e., no fd became ready), this function returns
-//! Result::Timeout.
+//! If a timeout occurred while polling (i.e., no fd became ready and no timer fired), this
+//! function returns Result::Timeout.
 //!
 //! Otherwise, this function returns Result::Success.
 //!
@@ -64,6 +169,64 @@ EventLoop::add_rule(const FileDescriptor& fd, const Direction direction, const C
 //! written, so it is still ready; the next call to poll will immediately return).
 EventLoop::Result
 EventLoop::wait_next_event(const int timeout_ms)
+{
+    // sleep no longer than until the earliest deadline
+    int timeout = timeout_ms;
+    bool timer_pending = false;
+    const uint64_t now = timestamp_ms();
+    for (const auto& timer : _timers) {
+        if (const auto deadline = timer.deadline(); deadline.has_value()) {
+            timer_pending = true;
+            const int until = deadline.value() > now
+                                  ? static_cast<int>(min<uint64_t>(deadline.value() - now, INT_MAX))
+                                  : 0;
+            timeout = timeout < 0 ? until : min(timeout, until);
+        }
+    }
+
+    const Result result = _backend == Backend::Poll ? wait_poll(timeout, timer_pending)
+                                                    : wait_registered(timeout, timer_pending);
+    if (result == Result::Exit) {
+        return result;
+    }
+    return fire_timers() ? Result::Success : result;
+}
+
+//! \param[in] deadline is called by EventLoop::wait_next_event before and after waiting. It
+//!                     returns the time (in timestamp_ms() milliseconds) at which `callback`
+//!                     should run, or `std::nullopt` while the timer is idle.
+//! \param[in] callback is called once the deadline has passed.
+void
+EventLoop::add_timer(const DeadlineT& deadline, const CallbackT& callback)
+{
+    _timers.push_back({deadline, callback});
+}
+
+//! \returns `true` if any timer fired
+bool
+EventLoop::fire_timers()
+{
+    bool fired = false;
+    const uint64_t now = timestamp_ms();
+    for (const auto& timer : _timers) {
+        const auto deadline = timer.deadline();
+        if (not deadline.has_value() or deadline.value() > now) {
+            continue;
+        }
+        timer.callback();
+        fired = true;
+
+        // like a callback that leaves its fd ready, a due timer would make every wait return at once
+        if (const auto next = timer.deadline(); next.has_value() and next.value() <= now) {
+            throw runtime_error("EventLoop: busy wait detected: timer callback did not move its "
+                                "deadline past the present");
+        }
+    }
+    return fired;
+}
+
+EventLoop::Result
+EventLoop::wait_poll(const int timeout_ms, const bool timer_pending)
 {
     vector<pollfd> pollfds{};
     pollfds.reserve(_rules.size());
@@ -96,8 +259,8 @@ EventLoop::wait_next_event(const int timeout_ms)
         ++it;
     }
 
-    // quit if there is nothing left to poll
-    if (not something_to_poll) {
+    // quit if there is nothing left to poll or wait for
+    if (not something_to_poll and not timer_pending) {
         return Result::Exit;
     }
 
@@ -152,3 +315,119 @@ EventLoop::wait_next_event(const int timeout_ms)
 
     return Result::Success;
 }
+
+//! Same contract as the poll(2) backend. Registrations persist in the kernel, so a call only
+//! costs an epoll_ctl(2) (or an io_uring poll request) for each fd whose interest changed since
+//! the last call, and the callbacks are found from the ready fds without walking every rule.
+EventLoop::Result
+EventLoop::wait_registered(const int timeout_ms, const bool timer_pending)
+{
+    bool something_to_poll = false;
+
+    // cancel finished rules, and register interest where it changed
+    for (auto it = _rules.begin(); it != _rules.end();) {
+        if ((it->direction == Direction::In && it->fd.eof()) || it->fd.closed()) {
+            it = cancel_rule(it);
+            continue;
+        }
+        const bool interested = it->interest();
+        something_to_poll |= interested;
+        if (interested != it->polled) {
+            it->polled = interested;
+            update_registration(it->fd.fd_num());
+        }
+        ++it;
+    }
+    for (const int fd_num : _rearm) {
+        if (_registrations.count(fd_num)) {
+            update_registration(fd_num);
+        }
+    }
+    _rearm.clear();
+
+    // quit if there is nothing left to poll or wait for
+    if (not something_to_poll and not timer_pending) {
+        return Result::Exit;
+    }
+
+    size_t ready = 0;
+    try {
+        if (_backend == Backend::IoUring) {
+            ready = wait_uring(timeout_ms);
+        } else {
+            _ready.resize(max<size_t>(_registrations.size(), 1));
+            ready = SystemCall("epoll_wait", ::epoll_wait(_epoll->fd_num(), _ready.data(),
+                                                          static_cast<int>(_ready.size()), timeout_ms));
+        }
+        if (ready == 0) {
+            return Result::Timeout;
+        }
+    } catch (unix_error const& e) {
+        if (e.code().value() == EINTR) {
+            return Result::Exit;
+        }
+    }
+
+    for (const auto& event : vector<epoll_event>(_ready.begin(), _ready.begin() + ready)) {
+        if (event.events & EPOLLERR) {
+            throw runtime_error("EventLoop: error on polled file descriptor");
+        }
+
+        // copied, because cancelling a rule (or a callback adding one) changes the registration
+        const auto registration = _registrations.find(event.data.fd);
+        if (registration == _registrations.end()) {
+            continue;
+        }
+        const auto rules = registration->second.rules;
+        for (const auto& rule : rules) {
+            const auto poll_ready =
+                static_cast<bool>(rule->polled && (event.events & uint32_t(rule->direction)));
+            const auto poll_hup = static_cast<bool>(event.events & EPOLLHUP);
+            if (poll_hup && rule->polled && !poll_ready) {
+                // same as poll(2): a hangup with nothing left to read or write ends the rule
+                cancel_rule(rule);
+                continue;
+            }
+
+            if (poll_ready) {
+                const auto count_before = rule->service_count();
+                rule->callback();
+
+                if (count_before == rule->service_count() and rule->interest()) {
+                    throw runtime_error("EventLoop: busy wait detected: callback did not read/write fd "
+                                        "and is still interested");
+                }
+            }
+        }
+    }
+
+    return Result::Success;
+}
+
+//! Submits the poll requests prepared since the last call, and waits for completions, in one
+//! [io_uring_enter(2)](\ref man2::io_uring_enter).
+size_t
+EventLoop::wait_uring(const int timeout_ms)
+{
+    _uring->submit_and_wait(1, timeout_ms);
+
+    _ready.clear();
+    while (const auto completion = _uring->next_completion()) {
+        // completions of removals, and of polls that were replaced or removed, are ignored
+        const int fd_num = static_cast<int>(completion->user_data & 0xffffffff);
+        const auto registration = _registrations.find(fd_num);
+        if (completion->user_data == 0 or registration == _registrations.end() or
+            registration->second.poll_id != completion->user_data) {
+            continue;
+        }
+        registration->second.poll_id = 0;
+        _rearm.push_back(fd_num);
+        if (completion->res > 0) {
+            epoll_event event{};
+            event.events = static_cast<uint32_t>(completion->res);
+            event.data.fd = fd_num;
+            _ready.push_back(event);
+        }
+    }
+    return _ready.size();
+}
@@ -2,11 +2,18 @@
 #define SPONGE_LIBSPONGE_EVENTLOOP_HH
 
 #include "file_descriptor.hh"
+#include "io_uring.hh"
 
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <list>
+#include <memory>
+#include <optional>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <unordered_map>
+#include <vector>
 
 //! Waits for events on file descriptors and executes corresponding callbacks.
 class EventLoop {
@@ -17,9 +24,24 @@ class EventLoop {
         Out = POLLOUT  //!< Callback will be triggered when Rule::fd is writable.
     };
 
+    //! How EventLoop::wait_next_event waits for file descriptors.
+    enum class Backend {
+        Poll,  //!< [poll(2)](\ref man2::poll), with the set of polled fds rebuilt on every call.
+        Epoll,  //!< [epoll(7)](\ref man7::epoll), with registrations kept in the kernel between calls.
+        IoUring  //!< [io_uring(7)](\ref man7::io_uring) polls, submitted together with the wait; falls back to Epoll.
+    };
+
+    //! Returned by each call to EventLoop::wait_next_event.
+    enum class Result {
+        Success,  //!< At least one Rule or timer was triggered.
+        Timeout,  //!< No rules or timers were triggered before timeout.
+        Exit  //!< All rules have been canceled or were uninterested, and no timer is pending; make no further calls to EventLoop::wait_next_event.
+    };
+
   private:
     using CallbackT = std::function<void(void)>;  //!< Callback for ready Rule::fd
     using InterestT = std::function<bool(void)>;  //!< `true` return indicates Rule::fd should be polled.
+    using DeadlineT = std::function<std::optional<uint64_t>(void)>;  //!< When a timer is due, if ever.
 
     //! \brief Specifies a condition and callback that an EventLoop should handle.
     //! \details Created by calling EventLoop::add_rule() or EventLoop::add_cancelable_rule().
@@ -30,6 +52,7 @@ class EventLoop {
         CallbackT callback;   //!< A callback that reads or writes fd.
         InterestT interest;   //!< A callback that returns `true` whenever fd should be polled.
         CallbackT cancel;     //!< A callback that is called when the rule is cancelled (e.g. on hangup)
+        bool polled{false};   //!< Epoll and IoUring only: whether `direction` is registered for this rule.
 
         //! Returns the number of times fd has been read or written, depending on the value of Rule::direction.
         //! \details This function is used internally by EventLoop; you will not need to call it
@@ -38,13 +61,63 @@ class EventLoop {
 
     std::list<Rule> _rules{};  //!< All rules that have been added and not canceled.
 
-  public:
-    //! Returned by each call to EventLoop::wait_next_event.
-    enum class Result {
-        Success,  //!< At least one Rule was triggered.
-        Timeout,  //!< No rules were triggered before timeout.
-        Exit  //!< All rules have been canceled or were uninterested; make no further calls to EventLoop::wait_next_event.
+    //! \brief A callback to run once a deadline has passed.
+    //! \details Created by calling EventLoop::add_timer().
+    class Timer {
+      public:
+        DeadlineT deadline;  //!< Returns the time (see timestamp_ms()) when `callback` is due, or none.
+        CallbackT callback;  //!< Called once the deadline has passed; must move or clear the deadline.
+    };
+
+    std::list<Timer> _timers{};  //!< All timers that have been added.
+
+    //! Call the callback of each due timer
+    bool fire_timers();
+
+    Backend _backend;
+
+    //! \name Backend::Epoll and Backend::IoUring state
+    //!@{
+
+    std::optional<FileDescriptor> _epoll{};  //!< The epoll instance
+    std::unique_ptr<::IoUring> _uring{};     //!< The io_uring instance
+
+    //! The rules for one fd number (an fd may have a rule per direction) and the events registered for it
+    struct Registration {
+        std::vector<std::list<Rule>::iterator> rules{};
+        uint32_t events{0};
+        uint64_t poll_id{0};  //!< IoUring: user_data of the outstanding one-shot poll, or 0
     };
+    std::unordered_map<int, Registration> _registrations{};
+
+    std::vector<epoll_event> _ready{};  //!< Filled by epoll_wait(2), or from io_uring completions
+
+    uint32_t _poll_generation{0};  //!< Tells polls on the same fd apart, so that stale completions are ignored
+    std::vector<int> _rearm{};     //!< IoUring: fds whose poll completed, to be polled again if still interested
+
+    //! Wait for the kernel to report ready fds into `_ready`
+    //! \returns the number of ready fds
+    size_t wait_uring(const int timeout_ms);
+
+    //! Register the events that the interested rules for `fd_num` want, if they have changed
+    void update_registration(const int fd_num);
+    //!@}
+
+    //! Call Rule::cancel and delete the rule
+    std::list<Rule>::iterator cancel_rule(std::list<Rule>::iterator rule);
+
+    //! \name Implementations of wait_next_event
+    //!@{
+    Result wait_poll(const int timeout_ms, const bool timer_pending);
+    Result wait_registered(const int timeout_ms, const bool timer_pending);
+    //!@}
+
+  public:
+    //! \param[in] backend how wait_next_event() waits; Backend::Epoll and Backend::IoUring scale to many fds
+    explicit EventLoop(const Backend backend = Backend::Poll);
+
+    //! The backend in use, which is Backend::Epoll if Backend::IoUring was asked for but is unavailable
+    Backend backend() const { return _backend; }
 
     //! Add a rule whose callback will be called when `fd` is ready in the specified Direction.
     void add_rule(const FileDescriptor &fd,
@@ -53,7 +126,11 @@ class EventLoop {
                   const InterestT &interest = [] { return true; },
                   const CallbackT &cancel = [] {});
 
-    //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+    //! Add a timer whose callback will be called once the time returned by `deadline` has passed.
+    void add_timer(const DeadlineT &deadline, const CallbackT &callback);
+
+    //! Calls [poll(2)](\ref man2::poll) or [epoll_wait(2)](\ref man2::epoll_wait) and then executes callback
+    //! for each ready fd and each due timer.
     Result wait_next_event(const int timeout_ms);
 };
 
@@ -72,5 +149,19 @@ using Direction = EventLoop::Direction;
 //! A Rule installed using EventLoop::add_cancelable_rule will be polled and canceled under the
 //! same conditions, with the additional condition that if Rule::callback returns `true`, the
 //! Rule will be canceled.
+//!
+//! With Backend::Epoll, the fds stay registered with the kernel from one call to the next. Each call
+//! still asks every Rule::interest, but only calls [epoll_ctl(2)](\ref man2::epoll_ctl) for fds whose
+//! interest changed, and then only looks at the fds that are ready.
+//!
+//! Backend::IoUring keeps the same registrations, but as one-shot io_uring polls. A poll stays armed
+//! until its fd is ready or its interest changes, and is armed again after it fires (so readiness stays
+//! level-triggered). The polls that have to be armed or removed are submitted by the same
+//! [io_uring_enter(2)](\ref man2::io_uring_enter) that waits, so a call costs one system call.
+//!
+//! A timer installed using EventLoop::add_timer bounds how long EventLoop::wait_next_event sleeps:
+//! the wait ends by the earliest deadline that any timer reports, and the callbacks of due timers
+//! run after those of the ready fds. Deadlines are asked for on every call, so an owner whose next
+//! deadline moves (e.g. a retransmission timer restarted by an ACK) only needs to report it.
 
 #endif  // SPONGE_LIBSPONGE_EVENTLOOP_HH
@@ -0,0 +1,325 @@
+#include "io_uring.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <linux/time_types.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+//! Linux 6.7 opcode, newer than some installed kernel headers
+static constexpr uint8_t OP_READ_MULTISHOT = 49;
+
+static_assert(sizeof(IoUring::Completion) == sizeof(io_uring_cqe), "Completion mirrors io_uring_cqe");
+
+//! mmap(2) a region of the ring fd
+static void*
+map_ring(const int fd, const size_t size, const uint64_t offset)
+{
+    void* const addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (addr == MAP_FAILED) {
+        throw unix_error("mmap");
+    }
+    return addr;
+}
+
+template<typename T>
+static T*
+at_offset(void* base, const uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+//! \param[in] entries the number of SQEs; the kernel rounds it up to a power of two
+IoUring::IoUring(const unsigned entries) :
+    IoUring(entries, io_uring_params{})
+{
+}
+
+IoUring::IoUring(const unsigned entries, io_uring_params&& params) :
+    FileDescriptor(SystemCall("io_uring_setup",
+                              static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params)))),
+    _sq_ring_size(params.sq_off.array + params.sq_entries * sizeof(unsigned)),
+    _sq_entries(params.sq_entries),
+    _sqes_size(params.sq_entries * sizeof(io_uring_sqe)),
+    _cq_ring_size(params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe))
+{
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        _sq_ring_size = _cq_ring_size = max(_sq_ring_size, _cq_ring_size);
+    }
+    _sq_ring = map_ring(fd_num(), _sq_ring_size, IORING_OFF_SQ_RING);
+    _cq_ring = _sq_ring;
+    if (not(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        _cq_ring = map_ring(fd_num(), _cq_ring_size, IORING_OFF_CQ_RING);
+    }
+    _sqes = static_cast<io_uring_sqe*>(map_ring(fd_num(), _sqes_size, IORING_OFF_SQES));
+
+    _sq_head = at_offset<unsigned>(_sq_ring, params.sq_off.head);
+    _sq_tail = at_offset<unsigned>(_sq_ring, params.sq_off.tail);
+    _sq_mask = *at_offset<unsigned>(_sq_ring, params.sq_off.ring_mask);
+    _sq_array = at_offset<unsigned>(_sq_ring, params.sq_off.array);
+    _cq_head = at_offset<unsigned>(_cq_ring, params.cq_off.head);
+    _cq_tail = at_offset<unsigned>(_cq_ring, params.cq_off.tail);
+    _cq_mask = *at_offset<unsigned>(_cq_ring, params.cq_off.ring_mask);
+    _cqes = at_offset<io_uring_cqe>(_cq_ring, params.cq_off.cqes);
+    _sq_local_tail = *_sq_tail;
+
+    // SQE i always sits in slot i, so the index array is filled once
+    for (unsigned i = 0; i < _sq_entries; i++) {
+        _sq_array[i] = i;
+    }
+}
+
+IoUring::~IoUring()
+{
+    ::munmap(_sqes, _sqes_size);
+    if (_cq_ring != _sq_ring) {
+        ::munmap(_cq_ring, _cq_ring_size);
+    }
+    ::munmap(_sq_ring, _sq_ring_size);
+}
+
+//! \param[in] opcode an IORING_OP_* value
+//! \param[in] fd the file descriptor the operation applies to
+//! \param[in] user_data returned in the operation's completion(s)
+//! \returns the SQE, for the caller to fill in the rest of
+io_uring_sqe&
+IoUring::prepare(const uint8_t opcode, const int fd, const uint64_t user_data)
+{
+    if (_sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) == _sq_entries) {
+        enter(0, 0);
+    }
+    io_uring_sqe& sqe = _sqes[_sq_local_tail & _sq_mask];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.user_data = user_data;
+    _sq_local_tail++;
+    return sqe;
+}
+
+void
+IoUring::enter(const unsigned wait_nr, const int timeout_ms)
+{
+    __atomic_store_n(_sq_tail, _sq_local_tail, __ATOMIC_RELEASE);
+    const unsigned to_submit = _sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    __kernel_timespec timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000000LL};
+    io_uring_getevents_arg arg{};
+    arg.sigmask_sz = _NSIG / 8;
+    if (wait_nr > 0 and timeout_ms >= 0) {
+        flags |= IORING_ENTER_EXT_ARG;
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+    }
+
+    _enter_count++;
+    const bool ext_arg = flags & IORING_ENTER_EXT_ARG;
+    // ETIME just means the wait timed out
+    SystemCall("io_uring_enter",
+               static_cast<int>(::syscall(__NR_io_uring_enter, fd_num(), to_submit, wait_nr, flags,
+                                          ext_arg ? &arg : nullptr, ext_arg ? sizeof(arg) : _NSIG / 8)),
+               ETIME);
+}
+
+//! \param[in] wait_nr how many completions to wait for; 0 only submits
+//! \param[in] timeout_ms how long to wait, or -1 to wait without limit
+void
+IoUring::submit_and_wait(const unsigned wait_nr, const int timeout_ms)
+{
+    if (_sq_local_tail == __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) and wait_nr == 0) {
+        return;
+    }
+    enter(timeout_ms == 0 ? 0 : wait_nr, timeout_ms);
+}
+
+optional<IoUring::Completion>
+IoUring::next_completion()
+{
+    const unsigned head = *_cq_head;
+    if (head == __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+        return nullopt;
+    }
+    const io_uring_cqe& cqe = _cqes[head & _cq_mask];
+    const Completion completion{cqe.user_data, cqe.res, cqe.flags};
+    __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+    register_read();
+    return completion;
+}
+
+bool
+IoUring::supports(const uint8_t opcode) const
+{
+    // io_uring_probe ends in a flexible array of per-opcode entries
+    constexpr size_t OPS = 256;
+    vector<char> storage(sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op));
+    auto* const probe = reinterpret_cast<io_uring_probe*>(storage.data());
+    SystemCall("io_uring_register",
+               static_cast<int>(::syscall(__NR_io_uring_register, fd_num(), IORING_REGISTER_PROBE, probe, OPS)));
+    return opcode <= probe->last_op and (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+}
+
+//! \param[in] fd the device or socket to receive from
+//! \param[in] socket whether `fd` is a UDP socket (or else a TUN/TAP device)
+//! \param[in] buffer_size room for each datagram's payload
+//! \param[in] buffer_count number of buffers, at most 65536
+IoUringReceiver::IoUringReceiver(const FileDescriptor& fd, const bool socket, const size_t buffer_size,
+                                 const unsigned buffer_count) :
+    _fd(fd.duplicate()),
+    _socket(socket),
+    _buffer_size(buffer_size + (socket ? sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage) : 0)),
+    _buffer_count(buffer_count),
+    _ring(max(8U, buffer_count / 2)),
+    _buffers(make_unique<char[]>(_buffer_size * _buffer_count))
+{
+    if (_buffer_count == 0 or _buffer_count > 65536) {
+        throw runtime_error("IoUringReceiver: buffer_count must be between 1 and 65536");
+    }
+    if (not _ring.supports(_socket ? uint8_t{IORING_OP_RECVMSG} : OP_READ_MULTISHOT)) {
+        throw unix_error(_socket ? "io_uring recvmsg" : "io_uring read multishot", EOPNOTSUPP);
+    }
+
+    _returned.reserve(_buffer_count);
+    for (unsigned id = 0; id < _buffer_count; id++) {
+        _returned.push_back(id);
+    }
+    _msghdr.msg_namelen = sizeof(sockaddr_storage);
+    arm();
+}
+
+IoUringReceiver::~IoUringReceiver()
+{
+    // the kernel may write into the buffers until the receive has completed for the last time
+    try {
+        if (_armed) {
+            io_uring_sqe& sqe = _ring.prepare(IORING_OP_ASYNC_CANCEL, -1, CANCEL);
+            sqe.addr = RECEIVE;
+        }
+        while (_armed) {
+            _ring.submit_and_wait(1);
+            while (const auto completion = _ring.next_completion()) {
+                if (completion->user_data == RECEIVE and not(completion->flags & IORING_CQE_F_MORE)) {
+                    _armed = false;
+                }
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Exception destructing IoUringReceiver: " << e.what() << endl;
+    }
+}
+
+void
+IoUringReceiver::provide()
+{
+    // buffers are handed out in the order they were provided, so they mostly come back in runs of ids
+    sort(_returned.begin(), _returned.end());
+    for (size_t first = 0; first < _returned.size();) {
+        size_t last = first + 1;
+        while (last < _returned.size() and _returned[last] == _returned[last - 1] + 1) {
+            last++;
+        }
+        io_uring_sqe& sqe = _ring.prepare(IORING_OP_PROVIDE_BUFFERS, static_cast<int>(last - first), PROVIDE);
+        sqe.addr = reinterpret_cast<uint64_t>(&_buffers[_returned[first] * _buffer_size]);
+        sqe.len = _buffer_size;
+        sqe.off = _returned[first];
+        sqe.buf_group = BUFFER_GROUP;
+        first = last;
+    }
+    _returned.clear();
+}
+
+void
+IoUringReceiver::arm()
+{
+    provide();
+    if (_socket) {
+        io_uring_sqe& sqe = _ring.prepare(IORING_OP_RECVMSG, _fd.fd_num(), RECEIVE);
+        sqe.addr = reinterpret_cast<uint64_t>(&_msghdr);
+        sqe.ioprio = IORING_RECV_MULTISHOT;
+        sqe.flags = IOSQE_BUFFER_SELECT;
+        sqe.buf_group = BUFFER_GROUP;
+    } else {
+        io_uring_sqe& sqe = _ring.prepare(OP_READ_MULTISHOT, _fd.fd_num(), RECEIVE);
+        sqe.flags = IOSQE_BUFFER_SELECT;
+        sqe.buf_group = BUFFER_GROUP;
+    }
+    _ring.submit_and_wait();
+    _armed = true;
+}
+
+optional<IoUringReceiver::Datagram>
+IoUringReceiver::read()
+{
+    while (true) {
+        auto completion = _ring.next_completion();
+        if (not completion.has_value()) {
+            if (_armed) {
+                return nullopt;
+            }
+            // every buffer the stopped receive used has been read by now
+            arm();
+            completion = _ring.next_completion();
+            if (not completion.has_value()) {
+                return nullopt;
+            }
+        }
+        if (completion->user_data != RECEIVE) {
+            if (completion->res < 0) {
+                errno = -completion->res;
+                throw unix_error("io_uring provide buffers");
+            }
+            continue;
+        }
+
+        if (not(completion->flags & IORING_CQE_F_MORE)) {
+            _armed = false;
+        }
+        if (completion->res < 0) {
+            // out of buffers: the kernel keeps the datagrams queued until the receive is restarted
+            if (completion->res == -ENOBUFS or completion->res == -ECANCELED) {
+                continue;
+            }
+            errno = -completion->res;
+            throw unix_error(_socket ? "io_uring recvmsg" : "io_uring read");
+        }
+        if (not(completion->flags & IORING_CQE_F_BUFFER)) {
+            continue;
+        }
+
+        const uint16_t id = completion->flags >> IORING_CQE_BUFFER_SHIFT;
+        const char* const buffer = &_buffers[id * _buffer_size];
+        _returned.push_back(id);
+        Datagram datagram{};
+        if (_socket) {
+            io_uring_recvmsg_out out;
+            memcpy(&out, buffer, sizeof(out));
+            const char* const name = buffer + sizeof(out);
+            const char* const payload = name + _msghdr.msg_namelen + _msghdr.msg_controllen;
+            if (out.flags & MSG_TRUNC) {
+                throw runtime_error("io_uring recvmsg (oversized datagram)");
+            }
+            datagram.payload.assign(payload, out.payloadlen);
+            sockaddr_storage source;
+            memcpy(&source, name, min<size_t>(out.namelen, sizeof(source)));
+            datagram.source_address = Address(reinterpret_cast<const sockaddr*>(&source), out.namelen);
+        } else {
+            datagram.payload.assign(buffer, completion->res);
+        }
+
+        // hand buffers back in batches, so that it costs a system call only every so often
+        if (_armed and _returned.size() >= _buffer_count / 2) {
+            provide();
+            _ring.submit_and_wait();
+        }
+        return datagram;
+    }
+}
@@ -0,0 +1,172 @@
+#ifndef SPONGE_LIBSPONGE_IO_URING_HH
+#define SPONGE_LIBSPONGE_IO_URING_HH
+
+#include "address.hh"
+#include "file_descriptor.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+//! A FileDescriptor to an [io_uring(7)](\ref man7::io_uring) instance, with its rings mapped into the process
+class IoUring : public FileDescriptor {
+  public:
+    //! The fields of a completion queue entry
+    struct Completion {
+        uint64_t user_data;  //!< Copied from the SQE
+        int32_t res;         //!< Result of the operation, or `-errno`
+        uint32_t flags;      //!< IORING_CQE_F_* flags
+    };
+
+  private:
+    //! \name Submission queue
+    //!@{
+    void *_sq_ring;
+    size_t _sq_ring_size;
+    unsigned *_sq_head;
+    unsigned *_sq_tail;
+    unsigned _sq_mask;
+    unsigned _sq_entries;
+    unsigned *_sq_array;
+    io_uring_sqe *_sqes;
+    size_t _sqes_size;
+    unsigned _sq_local_tail;  //!< The tail, counting SQEs prepared since the last submission
+    //!@}
+
+    //! \name Completion queue
+    //!@{
+    void *_cq_ring;  //!< Same mapping as `_sq_ring` when the kernel has IORING_FEAT_SINGLE_MMAP
+    size_t _cq_ring_size;
+    unsigned *_cq_head;
+    unsigned *_cq_tail;
+    unsigned _cq_mask;
+    io_uring_cqe *_cqes;
+    //!@}
+
+    uint64_t _enter_count{0};  //!< Number of io_uring_enter(2) calls, for benchmarks
+
+    //! Call io_uring_enter(2) with every prepared SQE
+    void enter(const unsigned wait_nr, const int timeout_ms);
+
+    IoUring(const unsigned entries, io_uring_params &&params);
+
+  public:
+    //! Set up a ring with room for `entries` submissions (rounded up to a power of two)
+    //! \throws unix_error if the kernel does not provide io_uring (or forbids it)
+    explicit IoUring(const unsigned entries = 256);
+
+    //! Unmap the rings (the fd is closed by FileDescriptor)
+    ~IoUring();
+
+    //! Zero an SQE and queue it for the next submission, submitting the queue first if it is full
+    io_uring_sqe &prepare(const uint8_t opcode, const int fd, const uint64_t user_data);
+
+    //! Submit the prepared SQEs and wait up to `timeout_ms` (-1: forever) for `wait_nr` completions,
+    //! all in one system call
+    void submit_and_wait(const unsigned wait_nr = 0, const int timeout_ms = -1);
+
+    //! Take the oldest waiting completion, if any, out of the completion queue
+    std::optional<Completion> next_completion();
+
+    //! Does the running kernel implement `opcode`?
+    bool supports(const uint8_t opcode) const;
+
+    //! Number of io_uring_enter(2) calls so far
+    uint64_t enter_count() const { return _enter_count; }
+
+    //! \name
+    //! The rings are mapped at fixed addresses, so an IoUring cannot be copied or moved
+
+    //!@{
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+    IoUring(IoUring &&) = delete;
+    IoUring &operator=(IoUring &&) = delete;
+    //!@}
+};
+
+//! \class IoUring
+//! The ring fd is readable whenever completions are waiting, so it can itself be polled by an EventLoop.
+//! next_completion() counts as a read of it for EventLoop's busy-wait detection.
+
+//! Receives datagrams from a TunFD, TapFD or UDPSocket with one multishot io_uring request
+class IoUringReceiver {
+  public:
+    //! A received datagram, and the Address it came from (sockets only)
+    struct Datagram {
+        std::string payload;
+        std::optional<Address> source_address;
+    };
+
+  private:
+    static constexpr uint16_t BUFFER_GROUP = 0;
+    static constexpr uint64_t RECEIVE = 1;  //!< user_data of the receive request
+    static constexpr uint64_t CANCEL = 2;   //!< user_data of the request that cancels it
+    static constexpr uint64_t PROVIDE = 3;  //!< user_data of requests that hand buffers to the kernel
+
+    FileDescriptor _fd;
+    bool _socket;  //!< recvmsg(2) with the source address, or read(2)
+    size_t _buffer_size;
+    unsigned _buffer_count;
+
+    IoUring _ring;
+
+    //! The provided buffers, `_buffer_count` of `_buffer_size` bytes
+    std::unique_ptr<char[]> _buffers;
+    std::vector<uint16_t> _returned{};  //!< Ids of buffers that have been read but not yet handed back
+
+    msghdr _msghdr{};  //!< Tells a multishot recvmsg how much room to leave for the source address
+
+    bool _armed{false};  //!< Is the multishot receive still active?
+
+    //! Queue requests that hand the `_returned` buffers back to the kernel
+    void provide();
+
+    //! Hand back the `_returned` buffers and (re)start the multishot receive
+    void arm();
+
+  public:
+    //! \param[in] fd the device or socket to receive from (must stay open)
+    //! \param[in] socket `true` for a UDPSocket, `false` for a TunFD or TapFD
+    //! \param[in] buffer_size the largest datagram (tun/tap) or payload (UDP) that fits in a buffer
+    //! \param[in] buffer_count number of provided buffers; datagrams that arrive while all are in use
+    //!                         stay queued in the kernel
+    //! \throws unix_error if io_uring is unavailable; the caller falls back to reading `fd` directly
+    IoUringReceiver(const FileDescriptor &fd,
+                    const bool socket,
+                    const size_t buffer_size = 2048,
+                    const unsigned buffer_count = 256);
+
+    ~IoUringReceiver();
+
+    //! Readable when received datagrams are waiting; poll this instead of the device or socket
+    const FileDescriptor &fd() const { return _ring; }
+
+    //! The next received datagram, if any. Needs no system call unless the receive must be restarted.
+    std::optional<Datagram> read();
+
+    //! Number of io_uring_enter(2) calls so far
+    uint64_t enter_count() const { return _ring.enter_count(); }
+
+    //! \name
+    //! An IoUringReceiver cannot be copied or moved, since the kernel writes into its buffers
+
+    //!@{
+    IoUringReceiver(const IoUringReceiver &) = delete;
+    IoUringReceiver &operator=(const IoUringReceiver &) = delete;
+    IoUringReceiver(IoUringReceiver &&) = delete;
+    IoUringReceiver &operator=(IoUringReceiver &&) = delete;
+    //!@}
+};
+
+//! \class IoUringReceiver
+//! The kernel picks one of the provided buffers for each datagram and posts a completion, without a system
+//! call per datagram; read() copies the datagram out and hands the buffers back half a pool at a time.
+//! TunFD and TapFD use a multishot read, which needs Linux 6.7; UDPSocket uses a multishot recvmsg (6.0).
+
+#endif  // SPONGE_LIBSPONGE_IO_URING_HH
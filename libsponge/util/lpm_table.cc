@@ -0,0 +1,104 @@
+#include "lpm_table.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+//! \param[in] index the entry to cover
+//! \param[in] length the length of the prefix being inserted
+//! \param[in] leaf the entry for that prefix
+void
+LPMTable::cover(const size_t index, const uint8_t length, const uint32_t leaf)
+{
+    const uint32_t entry = _entries[index];
+    if (entry & NODE) {
+        const size_t child = entry & ~NODE;
+        for (size_t i = 0; i < CHILD_ENTRIES; i++) {
+            cover(child + i, length, leaf);
+        }
+    } else if ((entry & VALUE_MASK) == 0 or (entry >> LENGTH_SHIFT) < length) {
+        _entries[index] = leaf;
+    }
+}
+
+size_t
+LPMTable::child_of(const size_t index)
+{
+    const uint32_t entry = _entries[index];
+    if (entry & NODE) {
+        return entry & ~NODE;
+    }
+
+    // the new child inherits the leaf it replaces in every one of its entries
+    const size_t child = _entries.size();
+    if (child + CHILD_ENTRIES > NODE) {
+        throw runtime_error("LPMTable: too many nodes");
+    }
+    _entries.resize(child + CHILD_ENTRIES, entry);
+    _entries[index] = NODE | uint32_t(child);
+    return child;
+}
+
+//! \param[in] prefix the address prefix to match
+//! \param[in] length how many high-order bits of `prefix` must match (0 to 32)
+//! \param[in] value what lookup() returns for matching addresses (at most MAX_VALUE)
+void
+LPMTable::insert(const uint32_t prefix, const uint8_t length, const uint32_t value)
+{
+    if (length > 32) {
+        throw runtime_error("LPMTable: prefix length over 32");
+    }
+    if (value > MAX_VALUE) {
+        throw runtime_error("LPMTable: value too large");
+    }
+
+    const uint32_t masked = length == 0 ? 0 : prefix & (~uint32_t{0} << (32 - length));
+    const uint32_t leaf = (uint32_t{length} << LENGTH_SHIFT) | (value + 1);
+
+    // walk down to the level where the prefix ends, then cover the entries it expands into
+    size_t node = 0;
+    unsigned consumed = 0;
+    unsigned bits = ROOT_BITS;
+    while (true) {
+        const size_t index = node + ((masked << consumed) >> (32 - bits));
+        if (length <= consumed + bits) {
+            const size_t count = size_t{1} << (consumed + bits - length);
+            for (size_t i = 0; i < count; i++) {
+                cover(index + i, length, leaf);
+            }
+            break;
+        }
+        node = child_of(index);
+        consumed += bits;
+        bits = CHILD_BITS;
+    }
+    _prefixes++;
+}
+
+void
+LPMTable::lookup_batch(const uint32_t* addresses, uint32_t* values, const size_t count) const
+{
+    for (size_t i = 0; i < count; i++) {
+        __builtin_prefetch(&_entries[addresses[i] >> ROOT_BITS]);
+    }
+
+    // root entries; children of the second level are prefetched as they are found
+    for (size_t i = 0; i < count; i++) {
+        values[i] = _entries[addresses[i] >> ROOT_BITS];
+        if (values[i] & NODE) {
+            const size_t child = values[i] & ~NODE;
+            __builtin_prefetch(&_entries[child + ((addresses[i] >> CHILD_BITS) & (CHILD_ENTRIES - 1))]);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t entry = values[i];
+        if (entry & NODE) {
+            entry = _entries[(entry & ~NODE) + ((addresses[i] >> CHILD_BITS) & (CHILD_ENTRIES - 1))];
+            if (entry & NODE) {
+                entry = _entries[(entry & ~NODE) + (addresses[i] & (CHILD_ENTRIES - 1))];
+            }
+        }
+        values[i] = (entry & VALUE_MASK) == 0 ? NO_VALUE : (entry & VALUE_MASK) - 1;
+    }
+}
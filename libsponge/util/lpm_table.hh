@@ -0,0 +1,89 @@
+#ifndef SPONGE_LIBSPONGE_LPM_TABLE_HH
+#define SPONGE_LIBSPONGE_LPM_TABLE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+//! \brief A longest-prefix-match table from IPv4 prefixes to small integers, compiled into a multibit trie
+
+//! The trie has strides of 16, 8 and 8 bits: a root of 2^16 entries indexed by the top 16 bits of the
+//! address, and children of 256 entries for the next 8 bits where a longer prefix needs them. A
+//! prefix is expanded into every entry it covers at the level where it ends ("leaf pushing"), and
+//! each entry remembers the length of the prefix that set it, so lookup() reads one entry per level
+//! (at most three) and never backtracks. Prefixes of up to 16 bits are found with a single read.
+//!
+//! Like DIR-24-8, lookups cost a fixed number of memory accesses, but the table only takes memory in
+//! proportion to the prefixes longer than 16 bits (256 KiB for the root, plus 1 KiB per child),
+//! instead of a 2^24-entry first level per table.
+class LPMTable {
+  public:
+    //! The largest value that can be stored
+    static constexpr uint32_t MAX_VALUE = (1U << 24) - 2;
+
+    //! What lookup_batch() reports for an address that no prefix matches
+    static constexpr uint32_t NO_VALUE = ~uint32_t{0};
+
+  private:
+    static constexpr unsigned ROOT_BITS = 16;
+    static constexpr unsigned CHILD_BITS = 8;
+    static constexpr size_t CHILD_ENTRIES = size_t{1} << CHILD_BITS;
+
+    //! An entry is either a child pointer (NODE set, and the offset of the child's first entry in the
+    //! low bits), or a leaf: the length of its prefix above LENGTH_SHIFT, and value + 1 in the low
+    //! 24 bits (0 if no prefix covers the entry).
+    static constexpr uint32_t NODE = 1U << 31;
+    static constexpr unsigned LENGTH_SHIFT = 24;
+    static constexpr uint32_t VALUE_MASK = (1U << LENGTH_SHIFT) - 1;
+
+    //! Entries of all nodes: the root's come first, then those of each child
+    std::vector<uint32_t> _entries;
+
+    size_t _prefixes{0};  //!< Number of insert() calls
+
+    //! Set entry `index` (and every entry below it, if it is a child pointer) to `leaf`, where it is
+    //! not already covered by a prefix at least `length` bits long
+    void cover(const size_t index, const uint8_t length, const uint32_t leaf);
+
+    //! The offset of the child that entry `index` points to, after creating it if the entry is a leaf
+    size_t child_of(const size_t index);
+
+  public:
+    LPMTable() : _entries(size_t{1} << ROOT_BITS, 0) {}
+
+    //! Map addresses whose top `length` bits match `prefix` to `value`
+    //! \note Bits of `prefix` past `length` are ignored. If the same prefix is inserted twice, the first
+    //! value is kept (as a scan that takes the first of the longest matches would).
+    void insert(const uint32_t prefix, const uint8_t length, const uint32_t value);
+
+    //! The value of the longest prefix that matches `address`, if any
+    std::optional<uint32_t> lookup(const uint32_t address) const {
+        uint32_t entry = _entries[address >> ROOT_BITS];
+        if (entry & NODE) {
+            entry = _entries[(entry & ~NODE) + ((address >> CHILD_BITS) & (CHILD_ENTRIES - 1))];
+            if (entry & NODE) {
+                entry = _entries[(entry & ~NODE) + (address & (CHILD_ENTRIES - 1))];
+            }
+        }
+        if ((entry & VALUE_MASK) == 0) {
+            return std::nullopt;
+        }
+        return (entry & VALUE_MASK) - 1;
+    }
+
+    //! Look up `count` addresses at once: the entries of each level are prefetched for the whole
+    //! batch before any of them is read, so that the cache misses of different addresses overlap
+    //! \param[in] addresses the addresses to look up
+    //! \param[out] values the value for each address, or NO_VALUE
+    //! \param[in] count the number of addresses
+    void lookup_batch(const uint32_t *addresses, uint32_t *values, const size_t count) const;
+
+    //! Number of prefixes inserted
+    size_t size() const { return _prefixes; }
+
+    //! Bytes taken by the trie's entries
+    size_t memory_usage() const { return _entries.size() * sizeof(uint32_t); }
+};
+
+#endif  // SPONGE_LIBSPONGE_LPM_TABLE_HH
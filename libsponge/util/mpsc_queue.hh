@@ -0,0 +1,117 @@
+#ifndef SPONGE_LIBSPONGE_MPSC_QUEUE_HH
+#define SPONGE_LIBSPONGE_MPSC_QUEUE_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+//! \brief A fixed-capacity queue of values shared by any number of producer threads and one consumer thread
+template <typename T>
+class MPSCQueue {
+  private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;  //!< Keeps the producers' and consumer's indices on separate lines
+
+    //! A slot of the ring. `sequence` tells whose turn it is: equal to the position of the push that
+    //! may fill it, or one more than the position of the pop that may empty it.
+    struct Cell {
+        std::atomic<uint64_t> sequence{0};
+        T value{};
+    };
+
+    std::unique_ptr<Cell[]> _cells;  //!< Ring of `_mask + 1` cells
+    size_t _mask;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _tail{0};  //!< Position of the next push (claimed by producers)
+    alignas(CACHE_LINE_SIZE) uint64_t _head{0};               //!< Position of the next pop (consumer only)
+
+    static size_t round_up(const size_t capacity) {
+        size_t slots = 1;
+        while (slots < capacity) {
+            slots <<= 1;
+        }
+        return slots;
+    }
+
+  public:
+    //! Construct a queue with room for `capacity` values (rounded up to a power of two; must be nonzero)
+    explicit MPSCQueue(const size_t capacity)
+        : _cells(std::make_unique<Cell[]>(round_up(capacity))), _mask(round_up(capacity) - 1) {
+        if (capacity == 0) {
+            throw std::runtime_error("MPSCQueue: capacity must be nonzero");
+        }
+        for (size_t i = 0; i <= _mask; i++) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    //! \name "Input" interface for the producer threads
+    //!@{
+
+    //! Move `value` into the queue, unless the queue is full
+    //! \returns `true` if `value` was moved in; if `false`, `value` is left as it was
+    bool push(T &&value) {
+        uint64_t position = _tail.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &_cells[position & _mask];
+            const int64_t lag = int64_t(cell->sequence.load(std::memory_order_acquire)) - int64_t(position);
+            if (lag == 0) {
+                // the cell is free for this position; claim the position against the other producers
+                if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (lag < 0) {
+                return false;  // the consumer has not emptied the cell a lap ago
+            } else {
+                position = _tail.load(std::memory_order_relaxed);  // another producer took the position
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+    //!@}
+
+    //! \name "Output" interface for the consumer thread
+    //!@{
+
+    //! Take the oldest value out of the queue, if any
+    //! \note A value whose push() is still in progress blocks the values pushed after it
+    std::optional<T> pop() {
+        Cell &cell = _cells[_head & _mask];
+        if (cell.sequence.load(std::memory_order_acquire) != _head + 1) {
+            return std::nullopt;
+        }
+        std::optional<T> value{std::move(cell.value)};
+        cell.sequence.store(_head + _mask + 1, std::memory_order_release);
+        _head++;
+        return value;
+    }
+
+    //! Is there no value ready for pop()?
+    bool empty() const { return _cells[_head & _mask].sequence.load(std::memory_order_acquire) != _head + 1; }
+    //!@}
+
+    //! \name
+    //! An MPSCQueue is shared by several threads and cannot be copied or moved
+
+    //!@{
+    MPSCQueue(const MPSCQueue &other) = delete;
+    MPSCQueue &operator=(const MPSCQueue &other) = delete;
+    MPSCQueue(MPSCQueue &&other) = delete;
+    MPSCQueue &operator=(MPSCQueue &&other) = delete;
+    //!@}
+};
+
+//! \class MPSCQueue
+//! A bounded ring in which every cell carries a sequence number (after Dmitry Vyukov's bounded
+//! queue). Producers claim positions with a compare-and-swap on the shared tail, fill the cell, and
+//! publish it by advancing its sequence number; the consumer only reads its own head and the cell's
+//! sequence number. A full queue refuses the push instead of waiting, so the caller decides whether
+//! to drop or retry.
+
+#endif  // SPONGE_LIBSPONGE_MPSC_QUEUE_HH
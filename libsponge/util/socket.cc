@@ -3,11 +3,16 @@
 #include "util.hh"
 
 #include <cstddef>
+#include <cstring>
+#include <netinet/udp.h>
 #include <stdexcept>
 #include <unistd.h>
 
 using namespace std;
 
+//! Room for one control message with an int (UDP_GRO) or a uint16_t (UDP_SEGMENT)
+static constexpr size_t CONTROL_SIZE = CMSG_SPACE(sizeof(int));
+
 // default constructor for socket of (subclassed) domain and type
 //! \param[in] domain is as described in [socket(7)](\ref man7::socket), probably `AF_INET` or
 //! `AF_UNIX` \param[in] type is as described in [socket(7)](\ref man7::socket)
@@ -140,6 +145,55 @@ UDPSocket::recv(const size_t mtu)
     return ret;
 }
 
+//! \param[in,out] datagrams its size is the most datagrams to receive; the payloads' storage is reused
+//! \param[in] mtu the largest payload that fits
+//! \note Never blocks, even on a blocking socket. If `mtu` is too small to hold a received
+//! datagram, this method throws a std::runtime_error
+size_t
+UDPSocket::recv_batch(vector<received_datagram>& datagrams, const size_t mtu)
+{
+    const size_t count = datagrams.size();
+    _messages.assign(count, mmsghdr{});
+    _iovecs.resize(count);
+    _addresses.resize(count);
+    _controls.assign(count * CONTROL_SIZE, 0);
+    for (size_t i = 0; i < count; i++) {
+        datagrams[i].payload.resize(mtu);
+        _iovecs[i] = {datagrams[i].payload.data(), mtu};
+        msghdr& message = _messages[i].msg_hdr;
+        message.msg_name = static_cast<sockaddr*>(_addresses[i]);
+        message.msg_namelen = sizeof(Address::Raw::storage);
+        message.msg_iov = &_iovecs[i];
+        message.msg_iovlen = 1;
+        message.msg_control = &_controls[i * CONTROL_SIZE];
+        message.msg_controllen = CONTROL_SIZE;
+    }
+
+    const int received = SystemCall(
+        "recvmmsg", ::recvmmsg(fd_num(), _messages.data(), count, MSG_DONTWAIT, nullptr), EAGAIN);
+    register_read();
+    if (received < 0) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < size_t(received); i++) {
+        const msghdr& message = _messages[i].msg_hdr;
+        if (message.msg_flags & MSG_TRUNC) {
+            throw runtime_error("recvmmsg (oversized datagram)");
+        }
+        datagrams[i].source_address = {_addresses[i], message.msg_namelen};
+        datagrams[i].payload.resize(_messages[i].msg_len);
+        datagrams[i].segment_size = 0;
+        if (const cmsghdr* control = CMSG_FIRSTHDR(&message);
+            control != nullptr and control->cmsg_level == SOL_UDP and control->cmsg_type == UDP_GRO) {
+            int segment_size = 0;
+            memcpy(&segment_size, CMSG_DATA(control), sizeof(segment_size));
+            datagrams[i].segment_size = segment_size;
+        }
+    }
+    return received;
+}
+
 void
 sendmsg_helper(const int fd_num, const sockaddr* destination_address,
                const socklen_t destination_address_len, const BufferViewList& payload)
@@ -173,6 +227,66 @@ UDPSocket::send(const BufferViewList& payload)
     register_write();
 }
 
+//! \param[in] destination where every datagram goes
+//! \param[in] payloads one payload per datagram
+//! \param[in] segment_sizes empty, or for each payload: 0 to send it as one datagram, or else
+//! the size of the datagrams the kernel cuts it into with [UDP_SEGMENT](\ref man7::udp) (GSO)
+void
+UDPSocket::send_batch(const Address& destination, const vector<BufferViewList>& payloads,
+                      const vector<uint16_t>& segment_sizes)
+{
+    _messages.assign(payloads.size(), mmsghdr{});
+    _controls.assign(segment_sizes.size() * CONTROL_SIZE, 0);
+    _iovecs.clear();
+    for (const auto& payload : payloads) {
+        for (const auto& view : payload.views()) {
+            _iovecs.push_back({const_cast<char*>(view.data()), view.size()});
+        }
+    }
+
+    // _iovecs no longer grows, so the messages can point into it
+    size_t first_iovec = 0;
+    for (size_t i = 0; i < payloads.size(); i++) {
+        msghdr& message = _messages[i].msg_hdr;
+        message.msg_name = const_cast<sockaddr*>(static_cast<const sockaddr*>(destination));
+        message.msg_namelen = destination.size();
+        message.msg_iov = &_iovecs[first_iovec];
+        message.msg_iovlen = payloads[i].views().size();
+        first_iovec += message.msg_iovlen;
+
+        if (i < segment_sizes.size() and segment_sizes[i] != 0) {
+            message.msg_control = &_controls[i * CONTROL_SIZE];
+            message.msg_controllen = CONTROL_SIZE;
+            cmsghdr* const control = CMSG_FIRSTHDR(&message);
+            control->cmsg_level = SOL_UDP;
+            control->cmsg_type = UDP_SEGMENT;
+            control->cmsg_len = CMSG_LEN(sizeof(segment_sizes[i]));
+            memcpy(CMSG_DATA(control), &segment_sizes[i], sizeof(segment_sizes[i]));
+        }
+    }
+
+    // sendmmsg(2) may stop early (at UIO_MAXIOV messages, for instance)
+    for (size_t sent = 0; sent < payloads.size();) {
+        const int count = SystemCall(
+            "sendmmsg", ::sendmmsg(fd_num(), &_messages[sent], payloads.size() - sent, 0));
+        for (size_t i = sent; i < sent + count; i++) {
+            if (_messages[i].msg_len != payloads[i].size()) {
+                throw runtime_error("datagram payload too big for sendmmsg()");
+            }
+        }
+        sent += count;
+    }
+    register_write();
+}
+
+//! \param[in] enabled whether recv_batch() may return several datagrams in one payload
+//! \note Throws unix_error if the kernel does not support UDP_GRO (before Linux 5.0)
+void
+UDPSocket::set_gro(const bool enabled)
+{
+    setsockopt(SOL_UDP, UDP_GRO, int(enabled));
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref
 //! man2::listen))
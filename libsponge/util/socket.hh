@@ -8,6 +8,7 @@
 #include <functional>
 #include <string>
 #include <sys/socket.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -49,6 +50,15 @@ class Socket : public FileDescriptor {
 
 //! A wrapper around [UDP sockets](\ref man7::udp)
 class UDPSocket : public Socket {
+  private:
+    //! \name Message vectors for recv_batch() and send_batch(), kept to avoid reallocating them on every call
+    //!@{
+    std::vector<mmsghdr> _messages{};
+    std::vector<iovec> _iovecs{};
+    std::vector<Address::Raw> _addresses{};
+    std::vector<char> _controls{};  //!< Room for each message's UDP_GRO or UDP_SEGMENT control message
+    //!@}
+
   protected:
     //! \brief Construct from FileDescriptor (used by TCPOverUDPSocketAdapter)
     //! \param[in] fd is the FileDescriptor from which to construct
@@ -60,8 +70,9 @@ class UDPSocket : public Socket {
 
     //! Returned by UDPSocket::recv; carries received data and information about the sender
     struct received_datagram {
-        Address source_address;  //!< Address from which this datagram was received
-        std::string payload;     //!< UDP datagram payload
+        Address source_address;   //!< Address from which this datagram was received
+        std::string payload;      //!< UDP datagram payload
+        size_t segment_size = 0;  //!< With GRO, `payload` holds datagrams of this size (the last may be shorter)
     };
 
     //! Receive a datagram and the Address of its sender
@@ -70,9 +81,21 @@ class UDPSocket : public Socket {
     //! Receive a datagram and the Address of its sender (caller can allocate storage)
     void recv(received_datagram &datagram, const size_t mtu = 65536);
 
+    //! Receive up to `datagrams.size()` datagrams that are already waiting, with one
+    //! [recvmmsg(2)](\ref man2::recvmmsg); returns how many were received (0 if none were waiting)
+    size_t recv_batch(std::vector<received_datagram> &datagrams, const size_t mtu = 65536);
+
     //! Send a datagram to specified Address
     void sendto(const Address &destination, const BufferViewList &payload);
 
+    //! Send datagrams to specified Address with as few [sendmmsg(2)](\ref man2::sendmmsg) calls as possible
+    void send_batch(const Address &destination,
+                    const std::vector<BufferViewList> &payloads,
+                    const std::vector<uint16_t> &segment_sizes = {});
+
+    //! Let the kernel coalesce received datagrams with [UDP_GRO](\ref man7::udp)
+    void set_gro(const bool enabled);
+
     //! Send datagram to the socket's connected address (must call connect() first)
     void send(const BufferViewList &payload);
 };
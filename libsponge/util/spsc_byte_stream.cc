@@ -0,0 +1,139 @@
+#include "spsc_byte_stream.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+//! \param[in] capacity the size of the ring, allocated once
+SPSCByteStream::SPSCByteStream(const size_t capacity) :
+    _storage(make_unique<char[]>(capacity)),
+    _capacity(capacity),
+    _readable_doorbell(SystemCall("eventfd", ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))),
+    _writable_doorbell(SystemCall("eventfd", ::eventfd(0, EFD_CLOEXEC)))
+{
+    if (_capacity == 0) {
+        throw runtime_error("SPSCByteStream: capacity must be nonzero");
+    }
+}
+
+//! The readable doorbell is rung from both threads, so this writes the fd directly rather than through
+//! FileDescriptor::write, whose write count is not synchronized
+void
+SPSCByteStream::ring(FileDescriptor& doorbell)
+{
+    const uint64_t one = 1;
+    SystemCall("write", static_cast<int>(::write(doorbell.fd_num(), &one, sizeof(one))));
+}
+
+size_t
+SPSCByteStream::write(string_view data)
+{
+    if (_error.load()) {
+        return 0;
+    }
+    const uint64_t tail = _tail.load(memory_order_relaxed);
+    const uint64_t head = _head.load(memory_order_acquire);
+    const size_t l = min(data.size(), _capacity - size_t(tail - head));
+    if (l == 0) {
+        return 0;
+    }
+
+    const size_t offset = tail % _capacity;
+    const size_t first = min(l, _capacity - offset);
+    copy(data.begin(), data.begin() + first, _storage.get() + offset);
+    copy(data.begin() + first, data.begin() + l, _storage.get());
+
+    // publish, then check whether the consumer had already drained everything before this write
+    _tail.store(tail + l);
+    if (_head.load() == tail) {
+        ring(_readable_doorbell);
+    }
+    return l;
+}
+
+size_t
+SPSCByteStream::remaining_capacity() const
+{
+    return _capacity - size_t(_tail.load(memory_order_relaxed) - _head.load());
+}
+
+void
+SPSCByteStream::end_input()
+{
+    _input_ended.store(true);
+    ring(_readable_doorbell);
+}
+
+void
+SPSCByteStream::wait_writable()
+{
+    while (remaining_capacity() == 0 and not _error.load()) {
+        _writable_doorbell.read(sizeof(uint64_t));
+    }
+}
+
+//! \param[in] len bytes will be exposed from the output side of the stream
+BufferViewList
+SPSCByteStream::peek_view(const size_t len) const
+{
+    const uint64_t head = _head.load(memory_order_relaxed);
+    const size_t l = min(len, size_t(_tail.load(memory_order_acquire) - head));
+    const size_t offset = head % _capacity;
+    const size_t first = min(l, _capacity - offset);
+
+    BufferViewList ret;
+    ret.append({_storage.get() + offset, first});
+    ret.append({_storage.get(), l - first});
+    return ret;
+}
+
+//! \param[in] len bytes will be removed from the output side of the stream
+void
+SPSCByteStream::pop_output(const size_t len)
+{
+    const uint64_t head = _head.load(memory_order_relaxed);
+    const size_t l = min(len, size_t(_tail.load(memory_order_acquire) - head));
+    if (l == 0) {
+        return;
+    }
+
+    // publish, then check whether the producer could have been waiting on a full stream
+    _head.store(head + l);
+    if (_tail.load() - head == _capacity) {
+        ring(_writable_doorbell);
+    }
+}
+
+size_t
+SPSCByteStream::buffer_size() const
+{
+    return _tail.load() - _head.load(memory_order_relaxed);
+}
+
+bool
+SPSCByteStream::eof() const
+{
+    // check the flag first: every byte is written before the producer ends the input
+    return _input_ended.load() and buffer_empty();
+}
+
+void
+SPSCByteStream::set_error()
+{
+    _error.store(true);
+    ring(_writable_doorbell);
+}
+
+void
+SPSCByteStream::acknowledge_readable()
+{
+    _readable_doorbell.read(sizeof(uint64_t));
+    if (not buffer_empty() or _input_ended.load()) {
+        ring(_readable_doorbell);
+    }
+}
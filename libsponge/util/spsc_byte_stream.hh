@@ -0,0 +1,104 @@
+#ifndef SPONGE_LIBSPONGE_SPSC_BYTE_STREAM_HH
+#define SPONGE_LIBSPONGE_SPSC_BYTE_STREAM_HH
+
+#include "buffer.hh"
+#include "file_descriptor.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+//! \brief A fixed-capacity byte stream shared by exactly one producer thread and one consumer thread
+class SPSCByteStream {
+  private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;  //!< Keeps the producer's and consumer's indices on separate lines
+
+    std::unique_ptr<char[]> _storage;  //!< Ring of `_capacity` bytes
+    size_t _capacity;                  //!< Size of the ring
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _head{0};  //!< Total bytes popped (written only by the consumer)
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _tail{0};  //!< Total bytes written (written only by the producer)
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> _input_ended{false};  //!< Set by the producer
+    std::atomic<bool> _error{false};                                  //!< Set by the consumer
+
+    FileDescriptor _readable_doorbell;  //!< eventfd rung by the producer when the consumer may be idle
+    FileDescriptor _writable_doorbell;  //!< eventfd rung by the consumer when the producer may be waiting for room
+
+    //! Add one to an eventfd counter
+    static void ring(FileDescriptor &doorbell);
+
+  public:
+    //! Construct a stream with room for `capacity` bytes (must be nonzero)
+    explicit SPSCByteStream(const size_t capacity);
+
+    //! \name "Input" interface for the producer thread
+    //!@{
+
+    //! Copy as much of `data` as fits into the stream
+    //! \returns the number of bytes accepted into the stream
+    size_t write(std::string_view data);
+
+    //! \returns the number of additional bytes that the stream has space for
+    size_t remaining_capacity() const;
+
+    //! Signal that the byte stream has reached its ending
+    void end_input();
+
+    //! Block until the stream has room for more bytes or the consumer has set an error
+    void wait_writable();
+    //!@}
+
+    //! \name "Output" interface for the consumer thread
+    //!@{
+
+    //! Peek at next "len" bytes of the stream without copying them (at most two views)
+    BufferViewList peek_view(const size_t len) const;
+
+    //! Remove bytes from the stream, making room for the producer
+    void pop_output(const size_t len);
+
+    //! \returns the maximum amount that can currently be read from the stream
+    size_t buffer_size() const;
+
+    //! \returns `true` if the buffer is empty
+    bool buffer_empty() const { return buffer_size() == 0; }
+
+    //! \returns `true` if the output has reached the ending
+    bool eof() const;
+
+    //! Indicate that the consumer has gone away; wakes a waiting producer
+    void set_error();
+
+    //! eventfd that becomes readable when bytes (or the end of input) are available
+    const FileDescriptor &readable_doorbell() const { return _readable_doorbell; }
+
+    //! Clear the readable doorbell after the consumer has emptied the stream
+    //! \note Must only be called after polling reported the doorbell readable.
+    //! Rings it again if the producer raced with the consumer.
+    void acknowledge_readable();
+    //!@}
+
+    //! \returns `true` if the consumer has set an error
+    bool error() const { return _error.load(); }
+
+    //! \name
+    //! An SPSCByteStream is shared by two threads and cannot be copied or moved
+
+    //!@{
+    SPSCByteStream(const SPSCByteStream &other) = delete;
+    SPSCByteStream &operator=(const SPSCByteStream &other) = delete;
+    SPSCByteStream(SPSCByteStream &&other) = delete;
+    SPSCByteStream &operator=(SPSCByteStream &&other) = delete;
+    //!@}
+};
+
+//! \class SPSCByteStream
+//! The producer and consumer each own one index into the ring and only read the other's,
+//! so the fast path needs neither locks nor system calls. The doorbells are only rung on
+//! transitions: the producer rings the readable doorbell when it writes into a stream the
+//! consumer had fully drained, and the consumer rings the writable doorbell when it pops
+//! from a full stream. The consumer can hand the readable doorbell to an EventLoop.
+
+#endif  // SPONGE_LIBSPONGE_SPSC_BYTE_STREAM_HH
@@ -0,0 +1,100 @@
+#ifndef SPONGE_LIBSPONGE_SPSC_QUEUE_HH
+#define SPONGE_LIBSPONGE_SPSC_QUEUE_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+//! \brief A fixed-capacity queue of values shared by exactly one producer thread and one consumer thread
+template <typename T>
+class SPSCQueue {
+  private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;  //!< Keeps the producer's and consumer's indices on separate lines
+
+    std::unique_ptr<T[]> _slots;  //!< Ring of `_mask + 1` slots
+    size_t _mask;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _head{0};  //!< Total values popped (written only by the consumer)
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _tail{0};  //!< Total values pushed (written only by the producer)
+    bool _pushed_into_empty{false};                            //!< Producer only: see pushed_into_empty()
+
+    static size_t round_up(const size_t capacity) {
+        size_t slots = 1;
+        while (slots < capacity) {
+            slots <<= 1;
+        }
+        return slots;
+    }
+
+  public:
+    //! Construct a queue with room for `capacity` values (rounded up to a power of two; must be nonzero)
+    explicit SPSCQueue(const size_t capacity)
+        : _slots(std::make_unique<T[]>(round_up(capacity))), _mask(round_up(capacity) - 1) {
+        if (capacity == 0) {
+            throw std::runtime_error("SPSCQueue: capacity must be nonzero");
+        }
+    }
+
+    //! \name "Input" interface for the producer thread
+    //!@{
+
+    //! Move `value` into the queue, unless the queue is full
+    //! \returns `true` if `value` was moved in; if `false`, `value` is left as it was
+    bool push(T &&value) {
+        const uint64_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) > _mask) {
+            return false;
+        }
+        _slots[tail & _mask] = std::move(value);
+
+        // publish, then check whether the consumer had already drained everything before this push
+        _tail.store(tail + 1);
+        _pushed_into_empty = _head.load() == tail;
+        return true;
+    }
+
+    //! Had the consumer popped every other value when the last push() published its value?
+    //! If so, the consumer may have gone idle, and should be woken (e.g. through an eventfd).
+    bool pushed_into_empty() const { return _pushed_into_empty; }
+    //!@}
+
+    //! \name "Output" interface for the consumer thread
+    //!@{
+
+    //! Take the oldest value out of the queue, if any
+    std::optional<T> pop() {
+        const uint64_t head = _head.load(std::memory_order_relaxed);
+        if (_tail.load() == head) {
+            return std::nullopt;
+        }
+        std::optional<T> value{std::move(_slots[head & _mask])};
+        _head.store(head + 1);
+        return value;
+    }
+    //!@}
+
+    //! \returns the number of values in the queue (exact only on the producer or consumer thread)
+    size_t size() const { return _tail.load() - _head.load(); }
+
+    //! \name
+    //! An SPSCQueue is shared by two threads and cannot be copied or moved
+
+    //!@{
+    SPSCQueue(const SPSCQueue &other) = delete;
+    SPSCQueue &operator=(const SPSCQueue &other) = delete;
+    SPSCQueue(SPSCQueue &&other) = delete;
+    SPSCQueue &operator=(SPSCQueue &&other) = delete;
+    //!@}
+};
+
+//! \class SPSCQueue
+//! Like SPSCByteStream, but for whole values: the producer and consumer each own one index into the
+//! ring and only read the other's. The stores that publish an index and the loads that check the
+//! other are sequentially consistent, so a producer that pushes just as the consumer finds the queue
+//! empty sees pushed_into_empty(), and can ring a doorbell that the consumer polls.
+
+#endif  // SPONGE_LIBSPONGE_SPSC_QUEUE_HH
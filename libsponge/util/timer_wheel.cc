@@ -0,0 +1,171 @@
+#include "timer_wheel.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+TimerWheel::Slot&
+TimerWheel::slot_of(const Location& location)
+{
+    switch (location.level) {
+        case OVERFLOW_LEVEL:
+            return _overflow;
+        case DUE_LEVEL:
+            return _due;
+        default:
+            return _levels[location.level].slots[location.slot];
+    }
+}
+
+//! \param[in] from the list that holds `timer` now
+//! \param[in] timer the timer to move
+void
+TimerWheel::place(Slot& from, const Slot::iterator timer)
+{
+    const uint64_t deadline = max(timer->deadline, _now);
+
+    // the highest group of SLOT_BITS bits in which the deadline differs from now picks the level
+    unsigned level = 0;
+    if (const uint64_t diff = deadline ^ _now; diff != 0) {
+        level = (63 - __builtin_clzll(diff)) / SLOT_BITS;
+    }
+
+    if (level >= LEVELS) {
+        _overflow.splice(_overflow.end(), from, timer);
+        _index[timer->id] = {OVERFLOW_LEVEL, 0, timer};
+        return;
+    }
+    const unsigned slot = (deadline >> (SLOT_BITS * level)) & (SLOTS - 1);
+    _levels[level].slots[slot].splice(_levels[level].slots[slot].end(), from, timer);
+    _levels[level].occupied |= uint64_t{1} << slot;
+    _index[timer->id] = {level, slot, timer};
+}
+
+optional<pair<unsigned, unsigned>>
+TimerWheel::next_slot() const
+{
+    // a lower level's slots all begin before any later slot of a higher level
+    for (unsigned level = 0; level < LEVELS; level++) {
+        const unsigned current = (_now >> (SLOT_BITS * level)) & (SLOTS - 1);
+        const uint64_t ahead = _levels[level].occupied & (~uint64_t{0} << current);
+        if (ahead) {
+            return make_pair(level, unsigned(__builtin_ctzll(ahead)));
+        }
+    }
+    return nullopt;
+}
+
+uint64_t
+TimerWheel::slot_start(const unsigned level, const unsigned slot) const
+{
+    const uint64_t span = uint64_t{1} << (SLOT_BITS * (level + 1));
+    return (_now & ~(span - 1)) + (uint64_t{slot} << (SLOT_BITS * level));
+}
+
+uint64_t
+TimerWheel::next_top_span() const
+{
+    const uint64_t span = uint64_t{1} << (SLOT_BITS * LEVELS);
+    return (_now | (span - 1)) + 1;
+}
+
+//! \param[in] deadline absolute time at which to fire
+//! \param[in] tag passed back to the ExpiryHandler
+//! \returns an id that can be passed to cancel()
+TimerWheel::TimerId
+TimerWheel::schedule_at(const uint64_t deadline, const uint64_t tag)
+{
+    const TimerId id = _next_id++;
+    Slot staging;
+    staging.push_back({id, deadline, tag});
+    place(staging, staging.begin());
+    return id;
+}
+
+bool
+TimerWheel::cancel(const TimerId id)
+{
+    const auto it = _index.find(id);
+    if (it == _index.end()) {
+        return false;
+    }
+    const Location location = it->second;
+    _index.erase(it);
+    Slot& slot = slot_of(location);
+    slot.erase(location.timer);
+    if (location.level < LEVELS and slot.empty()) {
+        _levels[location.level].occupied &= ~(uint64_t{1} << location.slot);
+    }
+    return true;
+}
+
+//! \param[in] ms the number of milliseconds that have passed
+//! \param[in] on_expiry called with the id and tag of each timer that fires
+void
+TimerWheel::advance(const uint64_t ms, const ExpiryHandler& on_expiry)
+{
+    const uint64_t target = _now + ms;
+    while (true) {
+        const auto next = next_slot();
+        if (next.has_value() and slot_start(next->first, next->second) <= target) {
+            const auto [level, slot] = next.value();
+            _now = max(_now, slot_start(level, slot));
+
+            // take the whole slot, so that the handler can schedule into it again
+            _due.splice(_due.end(), _levels[level].slots[slot]);
+            _levels[level].occupied &= ~(uint64_t{1} << slot);
+            for (auto timer = _due.begin(); timer != _due.end(); ++timer) {
+                _index[timer->id] = {DUE_LEVEL, 0, timer};
+            }
+
+            while (not _due.empty()) {
+                const auto timer = _due.begin();
+                if (timer->deadline <= _now) {
+                    const TimerId id = timer->id;
+                    const uint64_t tag = timer->tag;
+                    _index.erase(id);
+                    _due.erase(timer);
+                    on_expiry(id, tag);
+                } else {
+                    place(_due, timer);
+                }
+            }
+            continue;
+        }
+
+        // nothing left in the levels before `target`; overflowed timers may now be within reach
+        if (not _overflow.empty() and next_top_span() <= target) {
+            _now = next_top_span();
+            Slot overflow;
+            overflow.swap(_overflow);
+            while (not overflow.empty()) {
+                place(overflow, overflow.begin());
+            }
+            continue;
+        }
+
+        _now = target;
+        return;
+    }
+}
+
+optional<uint64_t>
+TimerWheel::next_expiration() const
+{
+    if (const auto next = next_slot(); next.has_value()) {
+        return max(_now, slot_start(next->first, next->second));
+    }
+    if (not _overflow.empty()) {
+        return next_top_span();
+    }
+    return nullopt;
+}
+
+optional<uint64_t>
+TimerWheel::time_until_next_expiration() const
+{
+    if (const auto next = next_expiration(); next.has_value()) {
+        return next.value() - _now;
+    }
+    return nullopt;
+}
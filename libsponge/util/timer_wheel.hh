@@ -0,0 +1,129 @@
+#ifndef SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+#define SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <optional>
+#include <unordered_map>
+
+//! \brief A hierarchical timer wheel: one-shot timers with millisecond deadlines
+
+//! Level `l` has 64 slots, each covering 64^l milliseconds. A timer sits at the lowest level whose
+//! slots can tell its deadline apart from the current time; when time reaches the slot it sits in,
+//! it fires or moves down a level. Occupancy bitmaps let advance() skip empty slots, so its cost
+//! is proportional to the number of timers that fire or move, not to the elapsed time or to the
+//! number of timers that are pending.
+//!
+//! Timers carry a caller-chosen tag instead of a callback, and the owner handles them in advance().
+//! The wheel therefore holds no pointers into its owner, and both can be moved freely.
+class TimerWheel {
+  public:
+    //! Identifies a scheduled timer; never reused by the same TimerWheel
+    using TimerId = uint64_t;
+
+    //! Called by advance() for each timer that fires, with the timer's id and tag. It may schedule
+    //! and cancel timers on the same wheel.
+    using ExpiryHandler = std::function<void(TimerId, uint64_t)>;
+
+  private:
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr unsigned SLOTS = 1 << SLOT_BITS;
+    static constexpr unsigned LEVELS = 6;  //!< Deadlines up to 2^36 ms (about 795 days) ahead
+
+    //! Pseudo-levels for timers that are not in a slot
+    static constexpr unsigned OVERFLOW_LEVEL = LEVELS;  //!< Beyond the reach of the top level
+    static constexpr unsigned DUE_LEVEL = LEVELS + 1;   //!< Taken out of a slot by advance()
+
+    struct Timer {
+        TimerId id;
+        uint64_t deadline;
+        uint64_t tag;
+    };
+    using Slot = std::list<Timer>;
+
+    struct Level {
+        std::array<Slot, SLOTS> slots{};
+        uint64_t occupied{0};  //!< Bit `i` is set when `slots[i]` is not empty
+    };
+
+    std::array<Level, LEVELS> _levels{};
+
+    //! Timers beyond the reach of the top level, placed again once time enters their top-level span
+    Slot _overflow{};
+
+    //! The slot that advance() is working through
+    Slot _due{};
+
+    //! Where a pending timer is, for O(1) cancellation
+    struct Location {
+        unsigned level;  //!< Index into `_levels`, or OVERFLOW_LEVEL or DUE_LEVEL
+        unsigned slot;
+        Slot::iterator timer;
+    };
+    std::unordered_map<TimerId, Location> _index{};
+
+    uint64_t _now{0};
+    TimerId _next_id{0};
+
+    Slot &slot_of(const Location &location);
+
+    //! Move `timer` (an element of `from`) into the slot its deadline belongs in
+    void place(Slot &from, Slot::iterator timer);
+
+    //! The level and slot of the earliest non-empty slot, if any
+    std::optional<std::pair<unsigned, unsigned>> next_slot() const;
+
+    //! The time at which `slot` of `level` begins, within the current span of the level above
+    uint64_t slot_start(const unsigned level, const unsigned slot) const;
+
+    //! Start of the next span of the top level, when overflowed timers come within reach
+    uint64_t next_top_span() const;
+
+  public:
+    //! \param[in] now the starting time, in milliseconds
+    explicit TimerWheel(const uint64_t now = 0) : _now(now) {}
+
+    //! \name Timers
+    //!@{
+
+    //! Fire once time reaches `deadline`, passing `tag` to the ExpiryHandler
+    //! \note A deadline that has already passed fires on the next call to advance()
+    TimerId schedule_at(const uint64_t deadline, const uint64_t tag = 0);
+
+    //! Fire `delay` milliseconds from now, passing `tag` to the ExpiryHandler
+    TimerId schedule(const uint64_t delay, const uint64_t tag = 0) { return schedule_at(_now + delay, tag); }
+
+    //! Stop a timer before it fires
+    //! \returns `false` if it has already fired or been cancelled
+    bool cancel(const TimerId id);
+
+    //! \returns `true` if the timer has neither fired nor been cancelled
+    bool pending(const TimerId id) const { return _index.count(id); }
+    //!@}
+
+    //! \name Time
+    //!@{
+
+    //! Move time forward by `ms` milliseconds, calling `on_expiry` for every timer whose deadline is
+    //! reached, in deadline order. During the call, now() is the timer's deadline.
+    void advance(const uint64_t ms, const ExpiryHandler &on_expiry);
+
+    //! Current time, in milliseconds
+    uint64_t now() const { return _now; }
+
+    //! A lower bound on the earliest pending deadline, exact unless that timer is more than
+    //! 64 ms away (useful for choosing how long to sleep)
+    std::optional<uint64_t> next_expiration() const;
+
+    //! next_expiration(), relative to now()
+    std::optional<uint64_t> time_until_next_expiration() const;
+
+    //! Number of pending timers
+    size_t size() const { return _index.size(); }
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_TIMER_WHEEL_HH
@@ -3,6 +3,7 @@
 #include "util.hh"
 
 #include <cstring>
+#include <stdexcept>
 #include <fcntl.h>
 #include <linux/if.h>
 #include <linux/if_tun.h>
@@ -15,6 +16,8 @@ using namespace std;
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device
 //! (expects Ethernet frames)
+//! \param[in] multi_queue attach a new queue of a multi-queue device (IFF_MULTI_QUEUE)
+//! \param[in] vnet_hdr prefix packets with a VirtioNetHeader and enable checksum and TSO offloads
 //!
 //! To create a TUN device, you should already have run
 //!
@@ -22,13 +25,20 @@ using namespace std;
 //!
 //! as root before calling this function.
 
-TunTapFD::TunTapFD(const string& devname, const bool is_tun) :
-    FileDescriptor(SystemCall("open", open(CLONEDEV, O_RDWR)))
+TunTapFD::TunTapFD(const string& devname, const bool is_tun, const bool multi_queue,
+                   const bool vnet_hdr) :
+    FileDescriptor(SystemCall("open", open(CLONEDEV, O_RDWR))), _vnet_hdr(vnet_hdr)
 {
     struct ifreq tun_req
     {};
 
     tun_req.ifr_flags = (is_tun ? IFF_TUN : IFF_TAP) | IFF_NO_PI;   // tun device with no packetinfo
+    if (multi_queue) {
+        tun_req.ifr_flags |= IFF_MULTI_QUEUE;
+    }
+    if (vnet_hdr) {
+        tun_req.ifr_flags |= IFF_VNET_HDR;
+    }
 
     // copy devname to ifr_name, making sure to null terminate
 
@@ -36,4 +46,22 @@ TunTapFD::TunTapFD(const string& devname, const bool is_tun) :
     tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
 
     SystemCall("ioctl", ioctl(fd_num(), TUNSETIFF, static_cast<void*>(&tun_req)));
+
+    // IFF_VNET_HDR belongs to the device: a queue attached to a device that already has queues
+    // gets the device's setting, whatever it asked for, and would misparse every packet
+    struct ifreq attached
+    {};
+    SystemCall("ioctl", ioctl(fd_num(), TUNGETIFF, static_cast<void*>(&attached)));
+    if (bool(attached.ifr_flags & IFF_VNET_HDR) != vnet_hdr) {
+        throw runtime_error("TunTapFD: every queue of " + devname + " must agree on vnet_hdr");
+    }
+
+    // the header size and offloads belong to the device too; only a queue with a vnet header sets them,
+    // so that opening a plain queue does not clear what another queue or process set up
+    if (vnet_hdr) {
+        // the kernel may hand us TCP/IPv4 segments of up to 64 KiB, with the checksum left to us
+        const int header_size = sizeof(VirtioNetHeader);
+        SystemCall("ioctl", ioctl(fd_num(), TUNSETVNETHDRSZ, &header_size));
+        SystemCall("ioctl", ioctl(fd_num(), TUNSETOFFLOAD, TUN_F_CSUM | TUN_F_TSO4));
+    }
 }
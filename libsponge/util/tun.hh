@@ -3,22 +3,74 @@
 
 #include "file_descriptor.hh"
 
+#include <cstdint>
 #include <string>
+#include <utility>
+
+//! The header in front of every packet on a TunTapFD opened with `vnet_hdr`: `struct virtio_net_hdr`
+//! (`<linux/virtio_net.h>` does not compile as C++), in host byte order
+struct VirtioNetHeader {
+    static constexpr uint8_t F_NEEDS_CSUM = 1;  //!< Checksum from `csum_start` on; the field holds the pseudo sum
+    static constexpr uint8_t F_DATA_VALID = 2;  //!< Checksum already verified
+    static constexpr uint8_t GSO_NONE = 0;      //!< An ordinary packet
+    static constexpr uint8_t GSO_TCPV4 = 1;     //!< A TCP/IPv4 super-segment, to be cut into `gso_size` pieces
+
+    uint8_t flags = 0;         //!< F_* flags
+    uint8_t gso_type = 0;      //!< GSO_* type
+    uint16_t hdr_len = 0;      //!< Length of the IP and TCP headers
+    uint16_t gso_size = 0;     //!< Payload size of each piece
+    uint16_t csum_start = 0;   //!< Where checksumming starts (the TCP header)
+    uint16_t csum_offset = 0;  //!< Where the checksum goes, from `csum_start`
+};
+
+static_assert(sizeof(VirtioNetHeader) == 10, "VirtioNetHeader must match struct virtio_net_hdr");
 
 //! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunTapFD : public FileDescriptor {
+  private:
+    bool _vnet_hdr;  //!< Does every packet start with a VirtioNetHeader?
+
+  protected:
+    //! Wrap `fd`, which already reads and writes packets the way the device would
+    TunTapFD(FileDescriptor &&fd, const bool vnet_hdr) : FileDescriptor(std::move(fd)), _vnet_hdr(vnet_hdr) {}
+
   public:
     //! Open an existing persistent [TUN or TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TunTapFD(const std::string &devname, const bool is_tun);
+    explicit TunTapFD(const std::string &devname,
+                      const bool is_tun,
+                      const bool multi_queue = false,
+                      const bool vnet_hdr = false);
+
+    //! Does every packet read or written start with a VirtioNetHeader (see TunFD)?
+    bool vnet_hdr() const { return _vnet_hdr; }
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunFD : public TunTapFD {
   public:
     //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TunFD(const std::string &devname) : TunTapFD(devname, true) {}
+    explicit TunFD(const std::string &devname, const bool multi_queue = false, const bool vnet_hdr = false)
+        : TunTapFD(devname, true, multi_queue, vnet_hdr) {}
+
+    //! Wrap a file descriptor that reads and writes one IP datagram at a time, like a TUN device (a
+    //! datagram socketpair, for instance, stands in for one in tests)
+    TunFD(FileDescriptor &&fd, const bool vnet_hdr) : TunTapFD(std::move(fd), vnet_hdr) {}
 };
 
+//! \class TunFD
+//! With `multi_queue`, each TunFD opened on the same device is a queue of its own, so that several
+//! threads can each read and write one. The device must have been created with
+//! `ip tuntap add mode tun multi_queue ...`. The kernel sends a flow's packets to the queue that
+//! last wrote one of that flow's packets.
+//!
+//! With `vnet_hdr`, the device also takes on checksum and TCP segmentation offload: writes may be
+//! TSO super-segments (one TCP header for up to 64 KiB of payload), and reads may return segments
+//! the kernel has not segmented (or has coalesced with GRO), with the TCP checksum left to the
+//! device. Each packet is preceded by a VirtioNetHeader that says so.
+//!
+//! Whether packets carry the header is a property of the device, not of each queue: the first queue
+//! attached decides, and opening another queue of the same device with a different `vnet_hdr` throws.
+
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TapFD : public TunTapFD {
   public:
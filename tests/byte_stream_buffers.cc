@@ -0,0 +1,58 @@
+#include "byte_stream.hh"
+#include "test_err_if.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int
+main()
+{
+    try {
+        {
+            ByteStream stream{15};
+            Buffer data{string("catdog")};
+            test_err_if(stream.write(data) != 6, "write(Buffer) should accept the whole Buffer");
+            test_err_if(stream.peek_output(6) != "catdog", "write(Buffer) should preserve contents");
+
+            const Buffer head = stream.peek_buffer(3);
+            test_err_if(head.str() != "cat", "peek_buffer should return the first bytes");
+            test_err_if(head.str().data() != data.str().data(), "peek_buffer should share storage");
+
+            test_err_if(stream.read_buffer(4).str() != "catd", "read_buffer should return what it pops");
+            test_err_if(stream.bytes_read() != 4 or stream.buffer_size() != 2, "read_buffer should pop");
+        }
+
+        {
+            ByteStream stream{4};
+            BufferList list{string("ab")};
+            list.append(BufferList{string("cde")});
+            test_err_if(stream.write(list) != 4, "write(BufferList) should stop at capacity");
+            test_err_if(stream.remaining_capacity() != 0, "write(BufferList) should fill the stream");
+            test_err_if(stream.peek_output(4) != "abcd", "write(BufferList) should truncate the tail");
+
+            // spans two Buffers, so the result must be a copy
+            test_err_if(stream.peek_buffer(3).str() != "abc", "peek_buffer should handle multiple Buffers");
+
+            const auto iovecs = stream.peek_iovecs(3);
+            test_err_if(iovecs.size() != 2 or iovecs[0].iov_len != 2 or iovecs[1].iov_len != 1,
+                        "peek_iovecs should expose one iovec per Buffer");
+        }
+
+        {
+            ByteStream stream{5, ByteStreamBackend::ring};
+            test_err_if(stream.write(Buffer{string("abcdefg")}) != 5,
+                        "ring write(Buffer) should stop at capacity");
+            stream.pop_output(3);
+            test_err_if(stream.write(Buffer{string("xyz")}) != 3, "ring write(Buffer) should wrap");
+            test_err_if(stream.peek_buffer(5).str() != "dexyz",
+                        "ring peek_buffer should copy across the wrap");
+        }
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#include "byte_stream.hh"
+#include "byte_stream_test_harness.hh"
+#include "test_err_if.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int
+main()
+{
+    try {
+        {
+            ByteStreamTestHarness test{"ring: write-pop-end", 15, ByteStreamBackend::ring};
+
+            test.execute(Write{"cat"});
+            test.execute(Pop{3});
+            test.execute(EndInput{});
+
+            test.execute(InputEnded{true});
+            test.execute(BufferEmpty{true});
+            test.execute(Eof{true});
+            test.execute(BytesRead{3});
+            test.execute(BytesWritten{3});
+            test.execute(RemainingCapacity{15});
+            test.execute(BufferSize{0});
+        }
+
+        {
+            ByteStreamTestHarness test{"ring: wrap-around", 4, ByteStreamBackend::ring};
+
+            test.execute(Write{"abc"});
+            test.execute(Pop{2});
+            test.execute(Write{"defg"}.with_bytes_written(3));
+
+            test.execute(BytesRead{2});
+            test.execute(BytesWritten{6});
+            test.execute(RemainingCapacity{0});
+            test.execute(BufferSize{4});
+            test.execute(Peek{"cdef"});
+
+            test.execute(Pop{3});
+            test.execute(Write{"gh"}.with_bytes_written(2));
+            test.execute(Peek{"fgh"});
+            test.execute(Pop{3});
+            test.execute(BufferEmpty{true});
+        }
+
+        {
+            ByteStreamTestHarness test{"ring: overwrite-pop-overwrite", 2, ByteStreamBackend::ring};
+
+            test.execute(Write{"cat"}.with_bytes_written(2));
+            test.execute(Pop{1});
+            test.execute(Write{"tac"}.with_bytes_written(1));
+
+            test.execute(BytesRead{1});
+            test.execute(BytesWritten{3});
+            test.execute(RemainingCapacity{0});
+            test.execute(BufferSize{2});
+            test.execute(Peek{"at"});
+        }
+
+        {
+            ByteStreamTestHarness test{"ring: zero capacity", 0, ByteStreamBackend::ring};
+
+            test.execute(Write{"cat"}.with_bytes_written(0));
+            test.execute(Pop{1});
+            test.execute(BufferEmpty{true});
+            test.execute(RemainingCapacity{0});
+        }
+
+        {
+            ByteStream stream{8, ByteStreamBackend::ring};
+            stream.write("abcdef");
+            stream.pop_output(5);
+            stream.write("ghijk");
+            const auto views = stream.peek_view(6).views();
+            test_err_if(views.size() != 2 or views[0] != "fgh" or views[1] != "ijk",
+                        "ring peek_view should expose two spans around the wrap point");
+        }
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+#include "eventloop.hh"
+#include "spsc_byte_stream.hh"
+#include "test_err_if.hh"
+
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+int
+main()
+{
+    try {
+        constexpr size_t len = 8 * 1024 * 1024;
+        string to_send(len, 'x');
+        for (size_t i = 0; i < len; i++) {
+            to_send[i] = char(i * 7 + i / 251);
+        }
+
+        SPSCByteStream stream{4096};
+
+        // producer: uneven write sizes so the ring wraps at arbitrary offsets
+        thread producer([&] {
+            string_view remaining = to_send;
+            size_t chunk = 1;
+            while (not remaining.empty()) {
+                const auto piece = remaining.substr(0, chunk);
+                const size_t written = stream.write(piece);
+                remaining.remove_prefix(written);
+                if (written < piece.size()) {
+                    stream.wait_writable();
+                }
+                chunk = chunk % 3000 + 17;
+            }
+            stream.end_input();
+        });
+
+        // consumer: sleep on the readable doorbell, drain in small pieces
+        string received;
+        received.reserve(len);
+        bool done = false;
+        EventLoop loop;
+        loop.add_rule(
+            stream.readable_doorbell(),
+            Direction::In,
+            [&] {
+                while (not stream.buffer_empty()) {
+                    const BufferViewList view = stream.peek_view(1000);
+                    for (const auto& piece : view.views()) {
+                        received.append(piece);
+                    }
+                    stream.pop_output(view.size());
+                }
+                stream.acknowledge_readable();
+                done = stream.eof();
+            },
+            [&] { return not done; });
+
+        while (loop.wait_next_event(-1) != EventLoop::Result::Exit) {
+        }
+        producer.join();
+
+        test_err_if(received != to_send, "bytes received through SPSCByteStream don't match bytes sent");
+
+        bool threw = false;
+        try {
+            SPSCByteStream empty{0};
+        } catch (const runtime_error&) {
+            threw = true;
+        }
+        test_err_if(not threw, "zero-capacity SPSCByteStream should be rejected");
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -76,12 +76,14 @@ ByteStreamAction::execute(ByteStream&) const
 
 ByteStreamAction::~ByteStreamAction() {}
 
-ByteStreamTestHarness::ByteStreamTestHarness(const std::string& test_name, const size_t capacity) :
-    _test_name(test_name), _byte_stream(capacity)
+ByteStreamTestHarness::ByteStreamTestHarness(const std::string& test_name, const size_t capacity,
+                                             const ByteStreamBackend backend) :
+    _test_name(test_name), _byte_stream(capacity, backend)
 {
     std::ostringstream ss;
     ss << "Initialized with ("
-       << "capacity=" << capacity << ")";
+       << "capacity=" << capacity
+       << (backend == ByteStreamBackend::ring ? ", backend=ring" : "") << ")";
     _steps_executed.emplace_back(ss.str());
 }
 
@@ -146,7 +146,8 @@ class ByteStreamTestHarness
     std::vector<std::string> _steps_executed{};
 
 public:
-    ByteStreamTestHarness(const std::string& test_name, const size_t capacity);
+    ByteStreamTestHarness(const std::string& test_name, const size_t capacity,
+                          const ByteStreamBackend backend = ByteStreamBackend::buffer_list);
 
     void execute(const ByteStreamTestStep& step);
 };
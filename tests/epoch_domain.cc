@@ -0,0 +1,117 @@
+#include "epoch.hh"
+#include "test_err_if.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//! A published object that checks it is not used after being freed
+struct Version {
+    static constexpr uint64_t ALIVE = 0x600dc0ffee;
+    uint64_t canary{ALIVE};
+    uint64_t number;
+    vector<uint64_t> copies;
+
+    explicit Version(const uint64_t n) : number(n), copies(16, n) {}
+    ~Version() { canary = 0; }
+};
+
+int
+main()
+{
+    try {
+        // an object is freed once the readers that entered before it was retired have left
+        {
+            EpochDomain domain;
+            bool first_freed = false;
+            bool second_freed = false;
+
+            domain.retire([&] { first_freed = true; });
+            test_err_if(not (first_freed and domain.pending() == 0), "freed at once without readers");
+
+            {
+                EpochDomain::Guard old_reader{domain};
+                domain.retire([&] { second_freed = true; });
+                test_err_if(second_freed or domain.pending() != 1,
+                            "kept while an older reader is inside");
+
+                EpochDomain::Guard new_reader{domain};
+                domain.reclaim();
+                test_err_if(second_freed, "still kept");
+            }
+            domain.reclaim();
+            test_err_if(not (second_freed and domain.pending() == 0), "freed once the older reader left");
+
+            bool third_freed = false;
+            {
+                EpochDomain::Guard reader{domain};
+                domain.retire([&] { third_freed = true; });
+            }
+            test_err_if(third_freed, "retire() does not wait for readers");
+            domain.retire([] {});
+            test_err_if(not (third_freed and domain.pending() == 0), "the next retire() reclaims");
+
+            bool freed_by_destructor = false;
+            {
+                EpochDomain short_lived;
+                EpochDomain::Guard reader{short_lived};
+                short_lived.retire([&] { freed_by_destructor = true; });
+            }
+            test_err_if(not freed_by_destructor, "the destructor frees what is left");
+        }
+
+        // readers on several threads, while a writer keeps replacing the object they read
+        {
+            constexpr uint64_t versions = 20000;
+            EpochDomain domain;
+            atomic<const Version*> current{new Version(0)};
+            atomic<bool> done{false};
+            atomic<uint64_t> bad_reads{0};
+
+            vector<thread> readers;
+            for (unsigned i = 0; i < 3; i++) {
+                readers.emplace_back([&] {
+                    uint64_t last = 0;
+                    while (not done.load()) {
+                        EpochDomain::Guard guard{domain};
+                        const Version& version = *current.load();
+                        this_thread::yield();  // hold the object for a while
+                        bool good = version.canary == Version::ALIVE and version.number >= last;
+                        for (const auto copy : version.copies) {
+                            good = good and copy == version.number;
+                        }
+                        bad_reads += not good;
+                        last = version.number;
+                    }
+                });
+            }
+
+            for (uint64_t n = 1; n <= versions; n++) {
+                const Version* old_version = current.load();
+                current.store(new Version(n));
+                domain.retire(old_version);
+            }
+            done = true;
+            for (auto& reader : readers) {
+                reader.join();
+            }
+
+            test_err_if(bad_reads != 0, "readers only saw live objects, newest last");
+            domain.reclaim();
+            test_err_if(domain.pending() != 0, "everything retired is freed once readers are gone");
+            delete current.load();
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
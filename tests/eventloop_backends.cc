@@ -0,0 +1,199 @@
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "test_err_if.hh"
+#include "test_wire.hh"
+
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using Backend = EventLoop::Backend;
+using Result = EventLoop::Result;
+
+//! What happened in a scenario: callbacks, cancellations, and the outcome of each wait
+using Log = vector<string>;
+
+//! Wait once without blocking, and log the Result (or the error thrown)
+static void
+wait(EventLoop& loop, Log& log)
+{
+    try {
+        switch (loop.wait_next_event(0)) {
+            case Result::Success: log.push_back("Success"); break;
+            case Result::Timeout: log.push_back("Timeout"); break;
+            case Result::Exit: log.push_back("Exit"); break;
+        }
+    } catch (const runtime_error& e) {
+        log.push_back(string("threw ") + e.what());
+        throw;
+    }
+}
+
+//! A hangup ends a rule that is interested and has nothing left to read; an uninterested rule
+//! outlives it
+static void
+hangup(EventLoop& loop, Log& log)
+{
+    auto [reader, writer] = make_pipe();
+    auto [idle_reader, idle_writer] = make_pipe();
+    bool interested = true;
+    loop.add_rule(
+        reader, Direction::In, [&, &reader = reader] { log.push_back("read " + reader.read()); },
+        [&] { return interested; }, [&] { log.push_back("cancel reader"); });
+    loop.add_rule(
+        idle_reader, Direction::In, [&] { log.push_back("idle fired"); }, [] { return true; },
+        [&] { log.push_back("cancel idle"); });
+
+    writer.write("ab");
+    writer.close();
+    wait(loop, log);  // data and hangup: the data is read
+    interested = false;
+    wait(loop, log);  // hangup, uninterested: reported, but the rule stays
+    interested = true;
+    wait(loop, log);  // hangup, nothing to read: cancelled
+    wait(loop, log);
+    idle_writer.close();
+    wait(loop, log);
+    wait(loop, log);
+}
+
+//! An error on a polled fd throws, whether or not its rule is interested
+static void
+error(EventLoop& loop, Log& log, const bool interested)
+{
+    auto [reader, writer] = make_pipe();
+    auto [idle_reader, idle_writer] = make_pipe();
+    loop.add_rule(
+        writer, Direction::Out,
+        [&, &writer = writer] {
+            log.push_back("write");
+            writer.write("x");
+        },
+        [&] { return interested; });
+    loop.add_rule(idle_reader, Direction::In, [&] { log.push_back("idle fired"); });
+
+    wait(loop, log);
+    reader.close();  // a pipe without readers reports an error to its writer
+    wait(loop, log);
+}
+
+//! Rules on an fd number that was closed and reused, noticed by a wait or not
+static void
+reuse(EventLoop& loop, Log& log)
+{
+    auto [idle_reader, idle_writer] = make_pipe();
+    loop.add_rule(idle_reader, Direction::In, [&] { log.push_back("idle fired"); });
+
+    const auto add = [&](FileDescriptor& reader, const string& name) {
+        loop.add_rule(
+            reader, Direction::In, [&, name] { log.push_back(name + " read " + reader.read()); },
+            [] { return true; }, [&, name] { log.push_back("cancel " + name); });
+    };
+
+    auto [first, first_writer] = make_pipe();
+    const int fd_num = first.fd_num();
+    add(first, "first");
+    wait(loop, log);
+    first.close();
+    wait(loop, log);
+
+    auto [second, second_writer] = make_pipe();
+    test_err_if(second.fd_num() != fd_num, "fd number is reused");
+    add(second, "second");
+    second_writer.write("b");
+    wait(loop, log);
+    second.close();
+
+    auto [third, third_writer] = make_pipe();
+    test_err_if(third.fd_num() != fd_num, "fd number is reused again");
+    add(third, "third");
+    third_writer.write("c");
+    wait(loop, log);
+    wait(loop, log);
+}
+
+//! A callback that leaves its fd ready is a busy wait, unless it turns its interest off
+static void
+busy_wait(EventLoop& loop, Log& log)
+{
+    auto [reader, writer] = make_pipe();
+    bool interested = true;
+    bool drop_interest = true;
+    loop.add_rule(
+        reader, Direction::In,
+        [&] {
+            log.push_back("ignore");
+            interested = not drop_interest;
+        },
+        [&] { return interested; });
+
+    writer.write("x");
+    wait(loop, log);
+    wait(loop, log);
+    interested = true;
+    drop_interest = false;
+    wait(loop, log);
+}
+
+//! The log of `scenario` run with a new EventLoop on `backend`
+static Log
+record(const Backend backend, const function<void(EventLoop&, Log&)>& scenario)
+{
+    EventLoop loop{backend};
+    Log log;
+    try {
+        scenario(loop, log);
+    } catch (const runtime_error&) {
+        // logged by wait()
+    }
+    return log;
+}
+
+int
+main()
+{
+    try {
+        // the callback of a buggy backend could write into a pipe without readers
+        signal(SIGPIPE, SIG_IGN);
+
+        const string error_thrown = "threw EventLoop: error on polled file descriptor";
+        const string busy_thrown = "threw EventLoop: busy wait detected: callback did not read/write fd "
+                                   "and is still interested";
+        const vector<pair<string, function<void(EventLoop&, Log&)>>> scenarios{
+            {"hangup", hangup},
+            {"error", [](EventLoop& loop, Log& log) { error(loop, log, true); }},
+            {"error while uninterested", [](EventLoop& loop, Log& log) { error(loop, log, false); }},
+            {"reuse", reuse},
+            {"busy wait", busy_wait},
+        };
+        const vector<Log> expected{
+            {"read ab", "Success", "Success", "cancel reader", "Success", "Timeout", "cancel idle", "Success",
+             "Exit"},
+            {"write", "Success", error_thrown},
+            {"Timeout", error_thrown},
+            {"Timeout", "cancel first", "Timeout", "second read b", "Success", "cancel second",
+             "third read c", "Success", "Timeout"},
+            {"ignore", "Success", "Exit", "ignore", busy_thrown},
+        };
+
+        for (size_t i = 0; i < scenarios.size(); i++) {
+            const auto& [name, scenario] = scenarios[i];
+            const Log poll = record(Backend::Poll, scenario);
+            const Log epoll = record(Backend::Epoll, scenario);
+            test_err_if(poll != expected[i], name + ": poll");
+            test_err_if(epoll != poll, name + ": epoll does what poll does");
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,217 @@
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "socket.hh"
+#include "test_err_if.hh"
+#include "test_wire.hh"
+#include "util.hh"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <stdexcept>
+#include <string>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using Result = EventLoop::Result;
+
+//! In a child process where io_uring_setup(2) fails with ENOSYS (as on a kernel without io_uring),
+//! does an EventLoop asked for Backend::IoUring run on epoll instead?
+static bool
+falls_back_to_epoll()
+{
+    const pid_t pid = SystemCall("fork", ::fork());
+    if (pid == 0) {
+        sock_filter filter[] = {
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_io_uring_setup, 0, 1),
+            BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS),
+            BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+        };
+        sock_fprog program{sizeof(filter) / sizeof(filter[0]), static_cast<sock_filter*>(filter)};
+        if (::prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0
+            or ::syscall(__NR_seccomp, SECCOMP_SET_MODE_FILTER, 0, &program) != 0) {
+            ::_exit(2);
+        }
+
+        // the fallback works like any other epoll loop
+        EventLoop loop{EventLoop::Backend::IoUring};
+        auto [reader, writer] = make_pipe();
+        writer.write("x");
+        bool read = false;
+        loop.add_rule(reader, Direction::In, [&, &reader = reader] {
+            read = reader.read(1) == "x";
+        });
+        const bool epoll = loop.backend() == EventLoop::Backend::Epoll;
+        const bool ok = epoll and loop.wait_next_event(0) == Result::Success and read;
+        ::_exit(ok ? 0 : 1);
+    }
+
+    int status = 0;
+    SystemCall("waitpid", ::waitpid(pid, &status, 0));
+    test_err_if(WIFEXITED(status) and WEXITSTATUS(status) == 2, "could not install a seccomp filter");
+    return WIFEXITED(status) and WEXITSTATUS(status) == 0;
+}
+
+int
+main()
+{
+    try {
+        test_err_if(not falls_back_to_epoll(), "Backend::IoUring falls back to epoll without io_uring");
+
+        if (EventLoop{EventLoop::Backend::IoUring}.backend() != EventLoop::Backend::IoUring) {
+            cerr << "io_uring is unavailable; only the fallback was tested" << endl;
+            return EXIT_SUCCESS;
+        }
+
+        // a poll that fires is armed again while its fd stays readable (level-triggered)
+        {
+            EventLoop loop{EventLoop::Backend::IoUring};
+            auto [reader, writer] = make_pipe();
+            string got;
+            loop.add_rule(reader, Direction::In, [&, &reader = reader] { got += reader.read(1); });
+            writer.write("abc");
+            for (unsigned i = 0; i < 3; i++) {
+                test_err_if(loop.wait_next_event(0) != Result::Success, "readable pipe fires every time");
+            }
+            test_err_if(got != "abc", "one byte per wait, in order");
+            test_err_if(loop.wait_next_event(0) != Result::Timeout, "drained pipe does not fire");
+            writer.write("d");
+            test_err_if(loop.wait_next_event(1000) != Result::Success or got != "abcd",
+                        "fires once written again");
+        }
+
+        // interest turned off and on: removed polls, and polls that completed before their removal,
+        // never reach a callback
+        {
+            EventLoop loop{EventLoop::Backend::IoUring};
+            auto [reader, writer] = make_pipe();
+            auto [idle_reader, idle_writer] = make_pipe();
+            bool interested = false;
+            size_t calls = 0;
+            loop.add_rule(
+                reader, Direction::In,
+                [&, &reader = reader] {
+                    reader.read(1);
+                    calls++;
+                },
+                [&] { return interested; });
+            loop.add_rule(idle_reader, Direction::In, [] { throw runtime_error("idle pipe fired"); });
+
+            writer.write("xyz");
+            test_err_if(loop.wait_next_event(0) != Result::Timeout or calls != 0,
+                        "uninterested rule is not polled");
+            interested = true;
+            test_err_if(loop.wait_next_event(0) != Result::Success or calls != 1, "interest false -> true");
+            interested = false;
+            test_err_if(loop.wait_next_event(0) != Result::Timeout or calls != 1, "interest true -> false");
+            test_err_if(loop.wait_next_event(0) != Result::Timeout or calls != 1, "no stale completion");
+            interested = true;
+            test_err_if(loop.wait_next_event(0) != Result::Success or calls != 2, "interest back on");
+
+            // armed while not ready, removed, then ready and armed again: one callback per wait
+            test_err_if(loop.wait_next_event(0) != Result::Success or calls != 3, "last byte");
+            test_err_if(loop.wait_next_event(0) != Result::Timeout, "armed while empty");
+            interested = false;
+            test_err_if(loop.wait_next_event(0) != Result::Timeout, "removed while empty");
+            writer.write("w");
+            interested = true;
+            test_err_if(loop.wait_next_event(1000) != Result::Success or calls != 4,
+                        "re-armed after removal");
+            test_err_if(loop.wait_next_event(0) != Result::Timeout or calls != 4,
+                        "one callback for one byte");
+        }
+
+        // a hangup cancels the rule
+        {
+            EventLoop loop{EventLoop::Backend::IoUring};
+            auto [reader, writer] = make_pipe();
+            const int fd_num = reader.fd_num();
+            bool cancelled = false;
+            loop.add_rule(
+                reader, Direction::In, [] { throw runtime_error("hung-up pipe fired"); }, [] { return true; },
+                [&] { cancelled = true; });
+            test_err_if(loop.wait_next_event(0) != Result::Timeout, "open pipe is quiet");
+            writer.close();
+            test_err_if(loop.wait_next_event(1000) != Result::Success or not cancelled,
+                        "hangup cancels the rule");
+            test_err_if(loop.wait_next_event(0) != Result::Exit, "nothing left to poll after hangup");
+
+            // closed while its poll is still armed (io_uring holds on to the pipe until the poll is
+            // removed): the rule that takes over the fd number sees neither the old poll nor its removal
+            reader.close();
+            auto [old_reader, old_writer] = make_pipe();
+            test_err_if(old_reader.fd_num() != fd_num, "fd number is reused");
+            loop.add_rule(old_reader, Direction::In, [] { throw runtime_error("closed pipe fired"); });
+            test_err_if(loop.wait_next_event(0) != Result::Timeout, "armed on an empty pipe");
+            old_reader.close();
+            auto [new_reader, new_writer] = make_pipe();
+            test_err_if(new_reader.fd_num() != fd_num, "fd number is reused again");
+            size_t calls = 0;
+            loop.add_rule(new_reader, Direction::In, [&, &new_reader = new_reader] {
+                new_reader.read(1);
+                calls++;
+            });
+            old_writer.write("o");  // fires the old poll before it is removed
+            for (unsigned i = 0; i < 2; i++) {
+                test_err_if(loop.wait_next_event(0) != Result::Timeout, "no stale completion on reuse");
+            }
+            new_writer.write("n");
+            test_err_if(loop.wait_next_event(1000) != Result::Success or calls != 1, "new rule fires once");
+            test_err_if(loop.wait_next_event(0) != Result::Timeout or calls != 1, "and only once");
+        }
+
+        // a multishot receive over UDP loopback, with more datagrams than buffers
+        {
+            UDPSocket sender;
+            UDPSocket receiver_socket;
+            sender.bind(Address("127.0.0.1", 0));
+            receiver_socket.bind(Address("127.0.0.1", 0));
+            sender.connect(receiver_socket.local_address());
+            constexpr unsigned BUFFERS = 8;
+            IoUringReceiver receiver{receiver_socket, true, 2048, BUFFERS};
+            EventLoop loop{EventLoop::Backend::IoUring};
+            vector<IoUringReceiver::Datagram> received;
+            loop.add_rule(receiver.fd(), Direction::In, [&] {
+                while (auto datagram = receiver.read()) {
+                    received.push_back(move(*datagram));
+                }
+            });
+
+            vector<string> sent;
+            for (const size_t burst : {size_t{5}, size_t{50}, size_t{3 * BUFFERS}}) {
+                // the whole burst is queued on the socket before anything is read
+                for (size_t i = 0; i < burst; i++) {
+                    sent.push_back("datagram " + to_string(sent.size()) + string(i * 37 % 2000, 'x'));
+                    sender.write(sent.back());
+                }
+                const uint64_t begin = timestamp_ms();
+                while (received.size() < sent.size() and timestamp_ms() - begin < 5000) {
+                    loop.wait_next_event(100);
+                }
+                test_err_if(received.size() != sent.size(), "burst of " + to_string(burst) + " all received");
+            }
+            for (size_t n = 0; n < sent.size(); n++) {
+                const string name = "datagram " + to_string(n);
+                test_err_if(received[n].payload != sent[n], name + " received in order");
+                test_err_if(received[n].source_address != sender.local_address(), name + " source address");
+            }
+            test_err_if(receiver.enter_count() >= sent.size(), "fewer system calls than datagrams");
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
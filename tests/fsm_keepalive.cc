@@ -0,0 +1,82 @@
+#include "tcp_config.hh"
+#include "tcp_expectation.hh"
+#include "tcp_fsm_test_harness.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using State = TCPTestHarness::State;
+
+int
+main()
+{
+    try {
+        TCPConfig cfg{};
+        const WrappingInt32 base_seq(1 << 31);
+
+        // test #1: in ESTABLISHED, keep-alives (empty segments at ackno - 1) get exactly one ACK
+        {
+            cerr << "Test 1" << endl;
+            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg, base_seq - 1, base_seq - 1);
+
+            // pure ACK at ackno---no response
+            test_1.send_ack(base_seq, base_seq);
+            test_1.execute(ExpectNoSegment{}, "test 1 failed: ACK after acceptable ACK");
+
+            // keep-alive---one ACK with the current window
+            test_1.send_ack(base_seq - 1, base_seq);
+            test_1.execute(ExpectOneSegment{}
+                               .with_ack(true)
+                               .with_ackno(base_seq)
+                               .with_win(cfg.recv_capacity)
+                               .with_payload_size(0),
+                           "test 1 failed: no ACK for keep-alive");
+            test_1.execute(ExpectNoSegment{}, "test 1 failed: more than one ACK for keep-alive");
+
+            test_1.execute(ExpectState{State::ESTABLISHED});
+        }
+
+        // test #2: the ACK reports the window left after unread data
+        {
+            cerr << "Test 2" << endl;
+            TCPTestHarness test_2 = TCPTestHarness::in_established(cfg, base_seq - 1, base_seq - 1);
+
+            const string data(100, 'x');
+            test_2.send_data(base_seq, base_seq, data.begin(), data.end());
+            test_2.execute(ExpectOneSegment{}.with_ack(true).with_ackno(base_seq + 100),
+                           "test 2 failed: no ACK for data");
+
+            // zero-window probe and keep-alive look the same: an empty segment one byte back
+            test_2.send_ack(base_seq + 99, base_seq);
+            test_2.execute(ExpectOneSegment{}
+                               .with_ack(true)
+                               .with_ackno(base_seq + 100)
+                               .with_win(cfg.recv_capacity - 100)
+                               .with_payload_size(0),
+                           "test 2 failed: keep-alive ACK has the wrong window");
+            test_2.execute(ExpectNoSegment{}, "test 2 failed: more than one ACK for keep-alive");
+        }
+
+        // test #3: a keep-alive that also acks the future is answered once, not twice
+        {
+            cerr << "Test 3" << endl;
+            TCPTestHarness test_3 = TCPTestHarness::in_established(cfg, base_seq - 1, base_seq - 1);
+
+            test_3.send_ack(base_seq - 1, base_seq + 1);
+            test_3.execute(ExpectOneSegment{}.with_ack(true).with_ackno(base_seq),
+                           "test 3 failed: no ACK for keep-alive with ACK in the future");
+            test_3.execute(ExpectNoSegment{}, "test 3 failed: keep-alive with ACK in the future ACKed twice");
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
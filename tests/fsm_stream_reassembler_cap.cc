@@ -65,6 +65,23 @@ main()
             test.execute(BytesAssembled(2));
         }
 
+        {
+            ReassemblerTestHarness test{0};
+
+            test.execute(SubmitSegment{"ab", 0});
+            test.execute(BytesAssembled(0));
+            test.execute(UnassembledBytes(0));
+
+            test.execute(SubmitSegment{"cd", 2});
+            test.execute(BytesAssembled(0));
+            test.execute(UnassembledBytes(0));
+            test.execute(NotAtEof{});
+
+            test.execute(SubmitSegment{"", 0}.with_eof(true));
+            test.execute(BytesAvailable(""));
+            test.execute(AtEof{});
+        }
+
     } catch (const exception& e) {
         cerr << "Exception: " << e.what() << endl;
         return EXIT_FAILURE;
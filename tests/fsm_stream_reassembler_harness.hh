@@ -10,6 +10,7 @@
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 class ReassemblerExpectationViolation : public std::runtime_error
 {
@@ -28,6 +29,12 @@ struct ReassemblerTestStep
     execute(StreamReassembler&) const
     {
     }
+    //! Same as execute(), but any data is submitted as a Buffer
+    virtual void
+    execute_buffer(StreamReassembler& reassembler) const
+    {
+        execute(reassembler);
+    }
     virtual ~ReassemblerTestStep() {}
 };
 
@@ -228,27 +235,46 @@ struct SubmitSegment : public ReassemblerAction
     {
         reassembler.push_substring(_data, _index, _eof);
     }
+
+    void
+    execute_buffer(StreamReassembler& reassembler) const
+    {
+        reassembler.push_substring(Buffer(std::string(_data)), _index, _eof);
+    }
 };
 
+//! Runs every step against each ReassemblerEngine, submitting data both as std::string and as
+//! Buffer, so all variants must agree step by step
 class ReassemblerTestHarness
 {
-    StreamReassembler reassembler;
-    std::vector<std::string> steps_executed;
+    struct Variant
+    {
+        StreamReassembler reassembler;
+        bool buffers;
+    };
+    std::vector<Variant> variants{};
+    std::vector<std::string> steps_executed{};
 
-public:
-    ReassemblerTestHarness(const size_t capacity) : reassembler(capacity), steps_executed()
+    static std::string
+    variant_name(const Variant& v)
     {
-        steps_executed.emplace_back("Initialized (capacity = " + std::to_string(capacity) + ")");
+        return std::string(v.reassembler.engine() == ReassemblerEngine::bitmap ? "bitmap"
+                                                                                : "interval_map") +
+               (v.buffers ? ", Buffer" : ", std::string");
     }
 
     void
-    execute(const ReassemblerTestStep& step)
+    execute_on(const ReassemblerTestStep& step, Variant& v)
     {
         try {
-            step.execute(reassembler);
-            steps_executed.emplace_back(step.to_string());
+            if (v.buffers) {
+                step.execute_buffer(v.reassembler);
+            } else {
+                step.execute(v.reassembler);
+            }
         } catch (const ReassemblerExpectationViolation& e) {
             std::cerr << "Test Failure on expectation:\n\t" << step.to_string();
+            std::cerr << "\n\nVariant:\n\t" << variant_name(v);
             std::cerr << "\n\nFailure message:\n\t" << e.what();
             std::cerr << "\n\nList of steps that executed successfully:";
             for (const std::string& s : steps_executed) {
@@ -258,6 +284,7 @@ public:
             throw e;
         } catch (const std::exception& e) {
             std::cerr << "Test Failure on expectation:\n\t" << step.to_string();
+            std::cerr << "\n\nVariant:\n\t" << variant_name(v);
             std::cerr << "\n\nFailure message:\n\t" << e.what();
             std::cerr << "\n\nList of steps that executed successfully:";
             for (const std::string& s : steps_executed) {
@@ -268,6 +295,25 @@ public:
                 "The test caused your implementation to throw an exception!");
         }
     }
+
+public:
+    ReassemblerTestHarness(const size_t capacity)
+    {
+        for (const auto engine : {ReassemblerEngine::interval_map, ReassemblerEngine::bitmap}) {
+            variants.push_back({StreamReassembler(capacity, engine), false});
+            variants.push_back({StreamReassembler(capacity, engine), true});
+        }
+        steps_executed.emplace_back("Initialized (capacity = " + std::to_string(capacity) + ")");
+    }
+
+    void
+    execute(const ReassemblerTestStep& step)
+    {
+        for (Variant& v : variants) {
+            execute_on(step, v);
+        }
+        steps_executed.emplace_back(step.to_string());
+    }
 };
 
 #endif   // SPONGE_FSM_STREAM_REASSEMBLER_HARNESS_HH
@@ -18,6 +18,13 @@ static constexpr unsigned NREPS = 32;
 static constexpr unsigned NSEGS = 128;
 static constexpr unsigned MAX_SEG_LEN = 2048;
 
+// even repetitions exercise the interval map, odd ones the bitmap
+static ReassemblerEngine
+engine_for(const unsigned rep_no)
+{
+    return rep_no % 2 ? ReassemblerEngine::bitmap : ReassemblerEngine::interval_map;
+}
+
 string
 read(StreamReassembler& reassembler)
 {
@@ -31,8 +38,8 @@ main()
         auto rd = get_random_generator();
 
         // buffer a bunch of bytes, make sure we can empty and re-fill before calling close()
-        for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
-            StreamReassembler buf{MAX_SEG_LEN * NSEGS};
+        for (unsigned rep_no = 0; rep_no < 2 * NREPS; ++rep_no) {
+            StreamReassembler buf{MAX_SEG_LEN * NSEGS, engine_for(rep_no)};
 
             vector<tuple<size_t, size_t>> seq_size;
             size_t offset = 0;
@@ -61,8 +68,8 @@ main()
         }
 
         // insert EOF into a hole in the buffer
-        for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
-            StreamReassembler buf{65'000};
+        for (unsigned rep_no = 0; rep_no < 2 * NREPS; ++rep_no) {
+            StreamReassembler buf{65'000, engine_for(rep_no)};
 
             const size_t size = 1024;
             string d(size, 0);
@@ -92,8 +99,8 @@ main()
         }
 
         // insert EOF over previously queued data, require one of two possible correct actions
-        for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
-            StreamReassembler buf{65'000};
+        for (unsigned rep_no = 0; rep_no < 2 * NREPS; ++rep_no) {
+            StreamReassembler buf{65'000, engine_for(rep_no)};
 
             const size_t size = 1024;
             string d(size, 0);
@@ -18,6 +18,13 @@ static constexpr unsigned NREPS = 32;
 static constexpr unsigned NSEGS = 128;
 static constexpr unsigned MAX_SEG_LEN = 2048;
 
+// even repetitions exercise the interval map, odd ones the bitmap
+static ReassemblerEngine
+engine_for(const unsigned rep_no)
+{
+    return rep_no % 2 ? ReassemblerEngine::bitmap : ReassemblerEngine::interval_map;
+}
+
 string
 read(StreamReassembler& reassembler)
 {
@@ -31,8 +38,8 @@ main()
         auto rd = get_random_generator();
 
         // overlapping segments
-        for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
-            StreamReassembler buf{NSEGS * MAX_SEG_LEN};
+        for (unsigned rep_no = 0; rep_no < 2 * NREPS; ++rep_no) {
+            StreamReassembler buf{NSEGS * MAX_SEG_LEN, engine_for(rep_no)};
 
             vector<tuple<size_t, size_t>> seq_size;
             size_t offset = 0;
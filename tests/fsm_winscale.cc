@@ -0,0 +1,135 @@
+#include "tcp_config.hh"
+#include "tcp_expectation.hh"
+#include "tcp_fsm_test_harness.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <string>
+
+using namespace std;
+using State = TCPTestHarness::State;
+
+static constexpr uint16_t MAX_WIN = numeric_limits<uint16_t>::max();
+
+//! read segments until nothing is left, returning the number of payload bytes
+static size_t
+drain(TCPTestHarness& test, const string& note)
+{
+    size_t bytes = 0;
+    while (test.can_read()) {
+        bytes += test.expect_seg(ExpectSegment{}, note).payload().size();
+    }
+    return bytes;
+}
+
+int
+main()
+{
+    try {
+        auto rd = get_random_generator();
+
+        // test 1: both SYNs carry the option, so windows are scaled in both directions
+        {
+            TCPConfig cfg{};
+            cfg.recv_capacity = 4'000'000;   // needs a shift of 6
+                        const WrappingInt32 seq_base(rd());
+            TCPTestHarness test_1(cfg);
+
+            test_1.execute(Listen{});
+            test_1.execute(
+                SendSegment{}.with_syn(true).with_seqno(seq_base).with_win(MAX_WIN).with_wscale(4));
+
+            // the window in a SYN is never scaled
+            TCPSegment syn_ack = test_1.expect_seg(ExpectOneSegment{}
+                                                       .with_syn(true)
+                                                       .with_ack(true)
+                                                       .with_ackno(seq_base + 1)
+                                                       .with_win(MAX_WIN),
+                                                   "test 1 failed: SYN/ACK invalid");
+            test_err_if(not syn_ack.header().ws or syn_ack.header().wscale != 6,
+                        "test 1 failed: SYN/ACK without window scale 6");
+            const WrappingInt32 ack_base = syn_ack.header().seqno;
+
+            // 1000 << 4 bytes of window
+            test_1.execute(SendSegment{}
+                               .with_ack(true)
+                               .with_seqno(seq_base + 1)
+                               .with_ackno(ack_base + 1)
+                               .with_win(1000));
+            test_1.execute(ExpectState{State::ESTABLISHED});
+            test_1.execute(Write{string(20'000, 'x')}.with_bytes_written(20'000));
+            test_1.execute(Tick(1));
+            test_err_if(drain(test_1, "test 1 failed: invalid data segments") != 16'000,
+                        "test 1 failed: sender did not use the scaled window");
+            test_1.execute(ExpectBytesInFlight{16'000});
+
+            // advertised windows are scaled down
+            test_1.execute(SendSegment{}
+                               .with_ack(true)
+                               .with_seqno(seq_base + 1)
+                               .with_ackno(ack_base + 1 + 16'000)
+                               .with_win(1000)
+                               .with_data("hello"));
+            test_1.execute(Tick(1));
+            test_1.execute(ExpectSegment{}
+                               .with_ack(true)
+                               .with_ackno(seq_base + 6)
+                               .with_win((cfg.recv_capacity - 5) >> 6),
+                           "test 1 failed: ACK with wrong scaled window");
+        }
+
+        // test 2: the peer does not offer window scaling, so nothing is scaled
+        {
+            TCPConfig cfg{};
+            cfg.recv_capacity = 4'000'000;
+            const WrappingInt32 seq_base(rd());
+            TCPTestHarness test_2(cfg);
+
+            test_2.execute(Connect{});
+            TCPSegment syn = test_2.expect_seg(
+                ExpectOneSegment{}.with_syn(true).with_ack(false).with_win(MAX_WIN),
+                "test 2 failed: SYN invalid");
+            test_err_if(not syn.header().ws or syn.header().wscale != 6,
+                        "test 2 failed: SYN without window scale 6");
+            const WrappingInt32 isn = syn.header().seqno;
+
+            test_2.execute(SendSegment{}
+                               .with_syn(true)
+                               .with_ack(true)
+                               .with_seqno(seq_base)
+                               .with_ackno(isn + 1)
+                               .with_win(3000));
+            test_2.execute(
+                ExpectOneSegment{}.with_ack(true).with_ackno(seq_base + 1).with_win(MAX_WIN),
+                "test 2 failed: ACK should advertise the unscaled maximum");
+            test_2.execute(Write{string(10000, 'x')});
+            test_2.execute(Tick(1));
+            test_err_if(drain(test_2, "test 2 failed: invalid data segments") != 3000,
+                        "test 2 failed: peer window was scaled");
+        }
+
+        // test 3: window scaling turned off in the config
+        {
+            TCPConfig cfg{};
+            cfg.window_scaling = false;
+            TCPTestHarness test_3(cfg);
+
+            test_3.execute(Connect{});
+            TCPSegment syn =
+                test_3.expect_seg(ExpectOneSegment{}.with_syn(true), "test 3 failed: SYN invalid");
+            test_err_if(syn.header().ws, "test 3 failed: SYN offered window scaling");
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return err_num;
+    }
+
+    return EXIT_SUCCESS;
+}
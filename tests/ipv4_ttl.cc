@@ -0,0 +1,86 @@
+#include "ipv4_datagram.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+//! The serialization of a datagram with the same fields and payload as `dgram`, built from scratch
+static string
+rebuilt(const IPv4Datagram& dgram)
+{
+    IPv4Datagram copy;
+    copy.header() = dgram.header();
+    copy.payload() = dgram.payload().concatenate();
+    return copy.serialize().concatenate();
+}
+
+static IPv4Datagram
+parsed(const string& wire)
+{
+    IPv4Datagram dgram;
+    test_err_if(dgram.parse(string(wire)) != ParseResult::NoError, "datagram parses");
+    return dgram;
+}
+
+int
+main()
+{
+    try {
+        auto rd = get_random_generator();
+        for (unsigned n = 0; n < 2000; n++) {
+            IPv4Datagram original;
+            IPv4Header& header = original.header();
+            header.tos = rd();
+            header.id = rd();
+            header.df = rd() % 2;
+            header.mf = rd() % 2;
+            header.offset = rd() % 0x2000;
+            header.ttl = 1 + rd() % 255;
+            header.proto = rd();
+            header.src = rd();
+            header.dst = rd();
+            original.payload() = string(rd() % 100, char(rd()));
+            header.len = header.hlen * 4 + original.payload().size();
+            const string wire = original.serialize().concatenate();
+
+            // forwarded hop after hop: the patched header is the one a full serialization produces
+            IPv4Datagram dgram = parsed(wire);
+            const IPv4Datagram before = dgram;
+            while (dgram.header().ttl > 0) {
+                dgram.decrement_ttl();
+                const string patched = dgram.serialize().concatenate();
+                test_err_if(patched != rebuilt(dgram),
+                            "TTL " + to_string(dgram.header().ttl) + " patched correctly");
+                test_err_if(parsed(patched).header().cksum != dgram.header().cksum,
+                            "checksum field kept up to date");
+            }
+            test_err_if(before.serialize().concatenate() != wire, "a copy is patched on its own");
+
+            // a datagram that was never parsed has its checksum updated too
+            original.header().cksum = parsed(wire).header().cksum;
+            original.decrement_ttl();
+            test_err_if(parsed(original.serialize().concatenate()).header().cksum != original.header().cksum,
+                        "checksum of an unparsed datagram");
+
+            // changing another field falls back to a full serialization, also after decrement_ttl()
+            IPv4Datagram changed = parsed(wire);
+            changed.header().dst ^= 1 + rd() % 0xffff;
+            test_err_if(changed.serialize().concatenate() != rebuilt(changed), "changed field is serialized");
+            if (changed.header().ttl > 0) {
+                changed.decrement_ttl();
+                test_err_if(changed.serialize().concatenate() != rebuilt(changed), "changed field, then TTL");
+            }
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+#include "lpm_table.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+//! The first of the longest prefixes that match `address`, by scanning every prefix
+static optional<uint32_t>
+scan(const vector<tuple<uint32_t, uint8_t, uint32_t>>& prefixes, const uint32_t address)
+{
+    optional<uint32_t> best;
+    int best_length = -1;
+    for (const auto& [prefix, length, value] : prefixes) {
+        const uint32_t mask = length == 0 ? 0 : ~uint32_t{0} << (32 - length);
+        if ((address & mask) == (prefix & mask) and int(length) > best_length) {
+            best = value;
+            best_length = length;
+        }
+    }
+    return best;
+}
+
+int
+main()
+{
+    try {
+        // a few prefixes at each level of the trie, inserted shortest first and longest first
+        {
+            LPMTable table;
+            test_err_if(table.lookup(0x0a000001).has_value(), "empty table matches nothing");
+            table.insert(0x0a000000, 8, 1);     // 10.0.0.0/8
+            table.insert(0x0a010200, 24, 2);    // 10.1.2.0/24
+            table.insert(0x0a0102ff, 30, 3);    // 10.1.2.252/30 (stray bits past the length)
+            table.insert(0x0a010203, 32, 4);    // 10.1.2.3/32
+            table.insert(0x0a000000, 12, 5);    // 10.0.0.0/12, inserted after longer prefixes below it
+            table.insert(0x0a010200, 24, 6);    // same prefix again: the first value is kept
+            test_err_if(table.lookup(0x0b000000) != nullopt, "no default route yet");
+            test_err_if(table.lookup(0x0a800000) != 1, "/8");
+            test_err_if(table.lookup(0x0a010100) != 5, "/12 below /8");
+            test_err_if(table.lookup(0x0a010201) != 2, "/24 below /12");
+            test_err_if(table.lookup(0x0a0102fd) != 3, "/30 with stray prefix bits");
+            test_err_if(table.lookup(0x0a010203) != 4, "/32");
+            table.insert(0, 0, 7);
+            test_err_if(table.lookup(0x0b000000) != 7, "default route");
+            test_err_if(table.lookup(0x0a010203) != 4, "default route is shorter than everything");
+            test_err_if(table.size() != 7, "seven prefixes inserted");
+        }
+
+        // random tables against a scan of the same prefixes
+        auto rd = get_random_generator();
+        for (unsigned round = 0; round < 20; round++) {
+            LPMTable table;
+            vector<tuple<uint32_t, uint8_t, uint32_t>> prefixes;
+            const unsigned count = 1 + rd() % 300;
+            for (uint32_t value = 0; value < count; value++) {
+                // a small pool of base addresses, so that prefixes nest and repeat
+                const uint32_t prefix = (rd() % 4 << 30) | (rd() % 8 << 20) | (rd() % 16 << 8) | (rd() % 4);
+                const uint8_t length = rd() % 33;
+                prefixes.emplace_back(prefix, length, value);
+                table.insert(prefix, length, value);
+            }
+            vector<uint32_t> addresses(2000);
+            for (unsigned i = 0; i < addresses.size(); i++) {
+                uint32_t address = rd();
+                if (i % 2) {
+                    // near a prefix: its base address with a few low bits changed
+                    address = get<0>(prefixes[rd() % prefixes.size()]) ^ (rd() % 1024);
+                }
+                test_err_if(table.lookup(address) != scan(prefixes, address),
+                            "lookup of " + to_string(address) + " in round " + to_string(round));
+                addresses[i] = address;
+            }
+
+            // the same addresses in batches of varying size
+            vector<uint32_t> values(addresses.size());
+            for (size_t first = 0; first < addresses.size();) {
+                const size_t batch = min<size_t>(1 + rd() % 256, addresses.size() - first);
+                table.lookup_batch(&addresses[first], &values[first], batch);
+                first += batch;
+            }
+            for (unsigned i = 0; i < addresses.size(); i++) {
+                test_err_if(table.lookup(addresses[i]).value_or(LPMTable::NO_VALUE) != values[i],
+                            "batched lookup of " + to_string(addresses[i]) + " in round " + to_string(round));
+            }
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+#include "stream_reassembler.hh"
+#include "tcp_receiver.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <malloc.h>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//! Bytes currently allocated through operator new
+static size_t live_bytes = 0;
+
+void*
+operator new(const size_t size)
+{
+    void* const p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    live_bytes += malloc_usable_size(p);
+    return p;
+}
+
+void
+operator delete(void* const p) noexcept
+{
+    if (p != nullptr) {
+        live_bytes -= malloc_usable_size(p);
+        free(p);
+    }
+}
+
+void
+operator delete(void* const p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+//! A segment parsed out of a 64 KiB receive buffer, as a UDP or TUN read leaves it
+static TCPSegment
+received_segment(const uint32_t seqno, const string& payload, const bool syn = false)
+{
+    TCPSegment seg;
+    seg.header().seqno = WrappingInt32{seqno};
+    seg.header().syn = syn;
+    seg.payload() = Buffer(string(payload));
+    string wire = seg.serialize().concatenate();
+    wire.reserve(65536);
+
+    TCPSegment parsed;
+    test_err_if(parsed.parse(Buffer(move(wire))) != ParseResult::NoError, "segment parses");
+    return parsed;
+}
+
+int
+main()
+{
+    try {
+        constexpr uint32_t ISN = 1000;
+        constexpr size_t SEGMENT_SIZE = 1400;
+        constexpr size_t SEGMENTS = 40;
+        const string payload(SEGMENT_SIZE, 'x');
+
+        // in order: each payload goes to the byte stream; out of order: each waits in the reassembler
+        for (const bool in_order : {true, false}) {
+            const string name = in_order ? "in order" : "out of order";
+            TCPReceiver receiver{SEGMENTS * SEGMENT_SIZE * 2};
+            receiver.segment_received(received_segment(ISN, "", true));
+
+            const size_t before = live_bytes;
+            for (size_t i = 0; i < SEGMENTS; i++) {
+                // out of order, a one-segment hole is left before every segment
+                const size_t offset = (in_order ? i : 2 * i + 1) * SEGMENT_SIZE;
+                receiver.segment_received(received_segment(ISN + 1 + offset, payload));
+            }
+            const size_t retained = live_bytes - before;
+            const size_t buffered = receiver.stream_out().buffer_size() + receiver.unassembled_bytes();
+
+            test_err_if(buffered != SEGMENTS * SEGMENT_SIZE, name + ": every byte is buffered");
+            test_err_if(retained > 2 * buffered,
+                        name + ": " + to_string(retained) + " bytes retained to buffer " + to_string(buffered));
+        }
+
+        // a slice that fills most of its storage keeps sharing it
+        {
+            string storage(SEGMENT_SIZE, 'y');
+            const Buffer whole{move(storage)};
+            Buffer slice = whole;
+            slice.remove_prefix(40);
+            slice.compact_if_sparse();
+            test_err_if(slice.str().data() != whole.str().data() + 40, "dense slice is not copied");
+
+            slice.remove_suffix(slice.size() - 100);
+            slice.compact_if_sparse();
+            test_err_if(slice.str().data() == whole.str().data() + 40, "sparse slice is copied");
+            test_err_if(slice.copy() != string(100, 'y'), "copied slice keeps its bytes");
+            test_err_if(slice.storage_capacity() >= whole.storage_capacity(), "copy is right-sized");
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
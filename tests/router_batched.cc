@@ -0,0 +1,163 @@
+#include "arp_message.hh"
+#include "router.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t INTERFACES = 4;
+
+static EthernetAddress
+ethernet_address(const uint8_t host, const uint8_t interface)
+{
+    return {0x02, 0, 0, 0, host, interface};
+}
+
+static uint32_t
+subnet_address(const size_t subnet, const unsigned host)
+{
+    return Address("10.0." + to_string(subnet) + "." + to_string(host)).ipv4_numeric();
+}
+
+//! A router with a subnet per interface, the same `routes` (routed through gateways 10.0.i.2 to
+//! 10.0.i.4), and ARP entries for gateways 10.0.i.2 and 10.0.i.3 only
+static void
+build(Router& router, const vector<Router::RouteEntry>& routes)
+{
+    for (size_t i = 0; i < INTERFACES; i++) {
+        router.add_interface({ethernet_address(1, i), Address::from_ipv4_numeric(subnet_address(i, 1))});
+        router.add_routes({{subnet_address(i, 0), 24, {}, i}});
+    }
+    router.add_routes(routes);
+
+    for (size_t i = 0; i < INTERFACES; i++) {
+        for (const unsigned gateway : {2, 3}) {
+            ARPMessage request;
+            request.opcode = ARPMessage::OPCODE_REQUEST;
+            request.sender_ethernet_address = ethernet_address(gateway, i);
+            request.sender_ip_address = subnet_address(i, gateway);
+            request.target_ip_address = subnet_address(i, 1);
+            EthernetFrame frame;
+            frame.header() = {ETHERNET_BROADCAST, request.sender_ethernet_address, EthernetHeader::TYPE_ARP};
+            frame.payload() = request.serialize();
+            router.interface(i).recv_frame(frame);
+        }
+        while (not router.interface(i).frames_out().empty()) {
+            router.interface(i).frames_out().pop();
+        }
+    }
+}
+
+int
+main()
+{
+    try {
+        auto rd = get_random_generator();
+
+        vector<Router::RouteEntry> routes;
+        for (size_t k = 0; k < 300; k++) {
+            const uint8_t length = 8 + rd() % 25;
+            const size_t out = k % INTERFACES;
+            const Address gateway = Address::from_ipv4_numeric(subnet_address(out, 2 + k % 3));
+            // no route covers 10/8, so the subnets are reached directly
+            uint32_t dst = rd();
+            if (dst >> 24 == 10) {
+                dst ^= 0x80000000;
+            }
+            routes.push_back({dst, length, gateway, out});
+        }
+
+        // destinations: on the subnets, inside the routes' prefixes, or anywhere; some run out of TTL
+        vector<vector<InternetDatagram>> arriving(INTERFACES);
+        // each datagram that survives its TTL and goes to a host with an ARP entry is one frame
+        size_t delivered_directly = 0;
+        for (size_t n = 0; n < 3000; n++) {
+            InternetDatagram dgram;
+            dgram.header().ttl = n % 17 == 0 ? n % 3 : 64;
+            switch (n % 3) {
+                case 0: {
+                    const unsigned host = 2 + rd() % 3;
+                    dgram.header().dst = subnet_address(rd() % INTERFACES, host);
+                    delivered_directly += host != 4 and dgram.header().ttl > 1;
+                    break;
+                }
+                case 1: dgram.header().dst = routes[rd() % routes.size()].dst ^ (rd() % 4096); break;
+                default: dgram.header().dst = rd(); break;
+            }
+            dgram.header().src = subnet_address(n % INTERFACES, 9);
+            dgram.payload() = "datagram " + to_string(n);
+            dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+            arriving[n % INTERFACES].push_back(dgram);
+        }
+
+        // the frames sent on each interface, in order, by route() or by route_batched()
+        const auto frames_sent = [&](const size_t burst_size) {
+            Router router;
+            build(router, routes);
+            for (size_t i = 0; i < INTERFACES; i++) {
+                for (const auto& dgram : arriving[i]) {
+                    router.interface(i).datagrams_out().push(dgram);
+                }
+            }
+            if (burst_size == 0) {
+                router.route();
+            } else {
+                router.route_batched(burst_size);
+            }
+
+            vector<vector<string>> sent(INTERFACES);
+            for (size_t i = 0; i < INTERFACES; i++) {
+                for (auto& frames = router.interface(i).frames_out(); not frames.empty(); frames.pop()) {
+                    sent[i].push_back(frames.front().serialize().concatenate());
+                }
+                test_err_if(not router.interface(i).datagrams_out().empty(), "every datagram routed");
+            }
+            return sent;
+        };
+
+        const auto expected = frames_sent(0);
+        size_t total = 0;
+        for (const auto& frames : expected) {
+            total += frames.size();
+        }
+        test_err_if(total < delivered_directly, "datagrams for the subnets are forwarded");
+
+        for (const size_t burst_size : {1, 7, 32, 64, 256}) {
+            test_err_if(frames_sent(burst_size) != expected,
+                        "route_batched(" + to_string(burst_size) + ") sends what route() sends");
+        }
+
+        // a route to an interface that does not exist is refused, and none of its batch is added
+        {
+            Router router;
+            build(router, {});
+            const uint32_t dst = subnet_address(INTERFACES, 0);
+            bool refused = false;
+            try {
+                router.add_routes({{0, 0, {}, 0}, {dst, 24, {}, INTERFACES}});
+            } catch (const out_of_range&) {
+                refused = true;
+            }
+            test_err_if(not refused, "route to a missing interface is refused");
+
+            InternetDatagram dgram;
+            dgram.header().dst = subnet_address(INTERFACES, 2);
+            dgram.header().len = dgram.header().hlen * 4;
+            router.interface(0).datagrams_out().push(dgram);
+            router.route_batched(8);
+            test_err_if(not router.interface(0).frames_out().empty(), "default route was not added");
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
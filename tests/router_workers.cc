@@ -0,0 +1,165 @@
+#include "router.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static EthernetAddress
+ethernet_address(const uint8_t host, const uint8_t interface)
+{
+    return {0x02, 0, 0, 0, host, interface};
+}
+
+static InternetDatagram
+datagram(const string& src, const string& dst, const uint8_t ttl, const string& payload)
+{
+    InternetDatagram dgram;
+    dgram.header().src = Address(src).ipv4_numeric();
+    dgram.header().dst = Address(dst).ipv4_numeric();
+    dgram.header().ttl = ttl;
+    dgram.payload() = string(payload);
+    dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+    return dgram;
+}
+
+int
+main()
+{
+    try {
+        // a router joining three subnets, each with one host (10.0.i.2 behind 10.0.i.1)
+        constexpr size_t subnets = 3;
+        Router router;
+        vector<NetworkInterface> hosts;
+        for (uint8_t i = 0; i < subnets; i++) {
+            const string subnet = "10.0." + to_string(i) + ".";
+            router.add_interface({ethernet_address(1, i), Address(subnet + "1")});
+            router.add_route(Address(subnet + "0").ipv4_numeric(), 24, {}, i);
+            hosts.emplace_back(ethernet_address(2, i), Address(subnet + "2"));
+        }
+        router.start_workers();
+
+        // every host sends to every host (including itself, through the router), with a few that
+        // the router must drop: no route, and TTL running out
+        map<string, size_t> expected;
+        for (size_t n = 0; n < 600; n++) {
+            const size_t from = n % subnets;
+            const size_t to = n / subnets % subnets;
+            const string payload = "datagram " + to_string(n);
+            hosts[from].send_datagram(
+                datagram("10.0." + to_string(from) + ".2", "10.0." + to_string(to) + ".2", 64, payload),
+                Address("10.0." + to_string(from) + ".1"));
+            expected[payload] = to;
+        }
+        hosts[0].send_datagram(datagram("10.0.0.2", "11.0.0.1", 64, "no route"), Address("10.0.0.1"));
+        hosts[1].send_datagram(datagram("10.0.1.2", "10.0.2.2", 1, "expired"), Address("10.0.1.1"));
+
+        // carry frames between the hosts (on this thread) and the workers
+        const auto exchange = [&] {
+            for (size_t i = 0; i < subnets; i++) {
+                auto& frames = hosts[i].frames_out();
+                while (not frames.empty() and router.deliver_frame(i, move(frames.front()))) {
+                    frames.pop();
+                }
+                while (auto frame = router.take_frame(i)) {
+                    frame->payload() = frame->payload().concatenate();
+                    const auto dgram = hosts[i].recv_frame(frame.value());
+                    if (not dgram.has_value()) {
+                        continue;
+                    }
+                    const string payload = dgram->payload().concatenate();
+                    test_err_if(expected.count(payload) != 1, "unexpected datagram: " + payload);
+                    test_err_if(expected[payload] != i, payload + " arrived at the right host");
+                    test_err_if(dgram->header().ttl != 63, payload + " had its TTL decremented");
+                    expected.erase(payload);
+                }
+            }
+            this_thread::yield();
+        };
+        const uint64_t start = timestamp_ms();
+        while (not expected.empty()) {
+            test_err_if(timestamp_ms() - start >= 10000,
+                        to_string(expected.size()) + " datagrams never arrived");
+            exchange();
+        }
+        // the datagrams that the router should drop do not show up late either
+        const uint64_t all_arrived = timestamp_ms();
+        while (timestamp_ms() - all_arrived < 50) {
+            exchange();
+        }
+
+        router.stop_workers();
+        test_err_if(router.dropped_datagrams() != 0, "no queue overflowed");
+
+        // a worker that sleeps past the ARP cache's TTL expires its entries before forwarding again
+        {
+            Router idle_router;
+            vector<NetworkInterface> idle_hosts;
+            for (uint8_t i = 0; i < 2; i++) {
+                const string subnet = "10.0." + to_string(i) + ".";
+                idle_router.add_interface({ethernet_address(1, i), Address(subnet + "1")});
+                idle_router.add_route(Address(subnet + "0").ipv4_numeric(), 24, {}, i);
+                idle_hosts.emplace_back(ethernet_address(2, i), Address(subnet + "2"));
+            }
+            atomic<uint64_t> now{0};
+            idle_router.start_workers(1024, [&] { return now.load(); });
+
+            // carry frames until host 1 receives a datagram; returns the frames that host 1 saw first
+            const auto forward = [&](const string& payload) {
+                idle_hosts[0].send_datagram(datagram("10.0.0.2", "10.0.1.2", 64, payload),
+                                            Address("10.0.0.1"));
+                vector<EthernetFrame> seen;
+                const uint64_t begin = timestamp_ms();
+                while (true) {
+                    test_err_if(timestamp_ms() - begin >= 10000, payload + " never arrived");
+                    for (size_t i = 0; i < 2; i++) {
+                        for (auto& frames = idle_hosts[i].frames_out(); not frames.empty(); frames.pop()) {
+                            idle_router.deliver_frame(i, move(frames.front()));
+                        }
+                        while (auto frame = idle_router.take_frame(i)) {
+                            frame->payload() = frame->payload().concatenate();
+                            if (i == 1) {
+                                seen.push_back(frame.value());
+                            }
+                            const auto dgram = idle_hosts[i].recv_frame(frame.value());
+                            if (dgram.has_value() and dgram->payload().concatenate() == payload) {
+                                return seen;
+                            }
+                        }
+                    }
+                    this_thread::yield();
+                }
+            };
+
+            const auto first = forward("before the TTL");
+            test_err_if(first.front().header().type != EthernetHeader::TYPE_ARP,
+                        "first datagram waits for ARP");
+
+            // known next hop: forwarded directly
+            const auto known = forward("still cached");
+            test_err_if(not (known.size() == 1 and known.front().header().type == EthernetHeader::TYPE_IPv4),
+                        "cached next hop is used without ARP");
+
+            now = ARP_CONSTANT::ARP_CACHE_TTL + 1000;
+            const auto expired = forward("after the TTL");
+            test_err_if(not (expired.front().header().type == EthernetHeader::TYPE_ARP
+                      and expired.front().header().dst == ETHERNET_BROADCAST),
+                        "expired next hop is looked up with a fresh ARP request");
+            idle_router.stop_workers();
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+#include "sender_harness.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int
+main()
+{
+    try {
+        auto rd = get_random_generator();
+        constexpr size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+        for (const auto algorithm : {CongestionControlAlgorithm::reno,
+                                     CongestionControlAlgorithm::newreno,
+                                     CongestionControlAlgorithm::cubic}) {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            const uint16_t retx_timeout = uniform_int_distribution<uint16_t>{10, 10000}(rd);
+            cfg.fixed_isn = isn;
+            cfg.rt_timeout = retx_timeout;
+            cfg.congestion_control = algorithm;
+
+            TCPSenderTestHarness test{"Slow start, then RTO collapses the window", cfg};
+            test.execute(
+                ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(
+                    isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(60000));
+            test.execute(WriteBytes{string(20 * MSS, 'x')});
+
+            // RFC 5681 initial window: three segments for this MSS, even though the peer
+            // advertised much more (the harness checks the newest segment first)
+            for (unsigned i = 3; i-- > 0;) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + i * MSS));
+            }
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectBytesInFlight{3 * MSS});
+
+            // one ACK for the whole flight grows the window by one MSS
+            test.execute(AckReceived{WrappingInt32{isn + 1 + 3 * MSS}}.with_win(60000));
+            for (unsigned i = 7; i-- > 3;) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + i * MSS));
+            }
+            test.execute(ExpectNoSegment{});
+
+            // the timeout retransmits the oldest segment and shrinks the window to one MSS
+            test.execute(Tick{retx_timeout});
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + 3 * MSS));
+            test.execute(ExpectNoSegment{});
+
+            // two MSS of window, three still in flight: nothing new may be sent
+            test.execute(AckReceived{WrappingInt32{isn + 1 + 4 * MSS}}.with_win(60000));
+            test.execute(ExpectNoSegment{});
+            test.execute(ExpectBytesInFlight{3 * MSS});
+
+            // once the rest is acknowledged, the window (now 3 MSS) is refilled
+            test.execute(AckReceived{WrappingInt32{isn + 1 + 7 * MSS}}.with_win(60000));
+            for (unsigned i = 10; i-- > 7;) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + i * MSS));
+            }
+            test.execute(ExpectNoSegment{});
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.congestion_control = CongestionControlAlgorithm::reno;
+
+            TCPSenderTestHarness test{"Peer window still applies under congestion control", cfg};
+            test.execute(
+                ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(
+                    isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
+            test.execute(WriteBytes{string(2 * MSS, 'x')});
+            test.execute(ExpectSegment{}.with_payload_size(1000));
+            test.execute(ExpectNoSegment{});
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
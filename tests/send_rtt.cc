@@ -0,0 +1,155 @@
+#include "parser.hh"
+#include "sender_harness.hh"
+#include "tcp_header.hh"
+#include "test_err_if.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int
+main()
+{
+    try {
+        auto rd = get_random_generator();
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.rt_timeout = 1000;
+            cfg.adaptive_rto = true;
+            cfg.min_rto = 10;
+
+            TCPSenderTestHarness test{"RTO follows the measured RTT", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_payload_size(0).with_seqno(isn));
+            // SRTT = 50, RTTVAR = 25, RTO = 50 + 4 * 25
+            test.execute(Tick{50});
+            test.execute(AckReceived{WrappingInt32{isn + 1}});
+            test.execute(WriteBytes{"abc"});
+            test.execute(ExpectSegment{}.with_data("abc").with_seqno(isn + 1));
+            test.execute(Tick{149});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_data("abc").with_seqno(isn + 1));
+
+            // the backed off timer doubles the measured RTO
+            test.execute(Tick{299});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_data("abc").with_seqno(isn + 1));
+
+            // Karn: an ACK for a retransmitted segment is not a sample, so the RTO is still 150
+            test.execute(Tick{5});
+            test.execute(AckReceived{WrappingInt32{isn + 4}});
+            test.execute(WriteBytes{"d"});
+            test.execute(ExpectSegment{}.with_data("d"));
+            test.execute(Tick{149});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_data("d"));
+            test.execute(AckReceived{WrappingInt32{isn + 5}});
+
+            // a 10 ms sample: RTTVAR = 0.75 * 25 + 0.25 * 40 = 28.75, SRTT = 45, RTO = 160
+            test.execute(WriteBytes{"e"});
+            test.execute(ExpectSegment{}.with_data("e"));
+            test.execute(Tick{10});
+            test.execute(AckReceived{WrappingInt32{isn + 6}});
+            test.execute(WriteBytes{"f"});
+            test.execute(ExpectSegment{}.with_data("f"));
+            test.execute(Tick{159});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_data("f"));
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.rt_timeout = 1000;
+            cfg.adaptive_rto = true;
+
+            TCPSenderTestHarness test{"RTO never drops below min_rto", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(Tick{1});
+            test.execute(AckReceived{WrappingInt32{isn + 1}});
+            test.execute(WriteBytes{"abc"});
+            test.execute(ExpectSegment{}.with_data("abc"));
+            test.execute(Tick{TCPConfig::MIN_RTO_DFLT - 1});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_data("abc"));
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.rt_timeout = 1000;
+            cfg.adaptive_rto = true;
+            cfg.min_rto = 10;
+
+            TCPSenderTestHarness test{"Echoed timestamps sample retransmitted segments", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(Tick{1000});
+            test.execute(ExpectSegment{}.with_syn(true).with_payload_size(0).with_seqno(isn));
+            // the echo identifies the retransmission (sent at 1000 ms), so RTT = 40
+            test.execute(Tick{40});
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_echoed_timestamp(1000));
+            test.execute(WriteBytes{"abc"});
+            test.execute(ExpectSegment{}.with_data("abc"));
+            test.execute(Tick{119});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_data("abc"));
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.rt_timeout = 1000;
+
+            TCPSenderTestHarness test{"Fixed RTO unless adaptive_rto is set", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(Tick{50});
+            test.execute(AckReceived{WrappingInt32{isn + 1}});
+            test.execute(WriteBytes{"abc"});
+            test.execute(ExpectSegment{}.with_data("abc"));
+            test.execute(Tick{999});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_data("abc"));
+        }
+
+        {
+            TCPHeader header;
+            header.sport = 1234;
+            header.dport = 80;
+            header.syn = true;
+            header.ts = true;
+            header.tsval = 0x01020304;
+            header.tsecr = 0xa0b0c0d0;
+
+            NetParser p{Buffer{header.serialize()}};
+            TCPHeader parsed;
+            test_err_if(parsed.parse(p) != ParseResult::NoError, "header with timestamps failed to parse");
+            // serialize() raised the data offset to make room for the options
+            header.doff = 8;
+            test_err_if(not(parsed == header) or parsed.length() != 32,
+                        "timestamps did not survive a round trip:\n" + parsed.to_string());
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+#include "parser.hh"
+#include "sender_harness.hh"
+#include "stream_reassembler.hh"
+#include "tcp_header.hh"
+#include "tcp_receiver.hh"
+#include "test_err_if.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+int
+main()
+{
+    try {
+        auto rd = get_random_generator();
+        constexpr size_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.congestion_control = CongestionControlAlgorithm::newreno;
+
+            TCPSenderTestHarness test{"Three duplicate ACKs trigger a fast retransmit", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(60000));
+            test.execute(WriteBytes{string(3 * MSS, 'x')});
+            for (unsigned i = 3; i-- > 0;) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + i * MSS));
+            }
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(60000));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(60000));
+            test.execute(ExpectNoSegment{});
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(60000));
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1));
+            test.execute(ExpectNoSegment{});
+
+            // a partial ACK means the next segment was lost too
+            test.execute(AckReceived{WrappingInt32{isn + 1 + MSS}}.with_win(60000));
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(isn + 1 + MSS));
+            test.execute(ExpectNoSegment{});
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+
+            TCPSenderTestHarness test{"No fast retransmit without congestion control", cfg};
+            test.execute(ExpectSegment{}.with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}});
+            test.execute(WriteBytes{"abc"});
+            test.execute(ExpectSegment{}.with_data("abc"));
+            for (unsigned i = 0; i < 4; i++) {
+                test.execute(AckReceived{WrappingInt32{isn + 1}});
+            }
+            test.execute(ExpectNoSegment{});
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.congestion_control = CongestionControlAlgorithm::newreno;
+
+            TCPSenderTestHarness test{"SACK repairs two losses from one window", cfg};
+            const auto seqno = [&isn](size_t segment) { return isn + 1 + segment * MSS; };
+            test.execute(ExpectSegment{}.with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(60000));
+            test.execute(WriteBytes{string(18 * MSS, 'x')});
+
+            // slow start: 3, then 4, 5 and 6 segments in flight
+            for (const size_t acked : {3, 7, 12}) {
+                test.execute(AckReceived{seqno(acked)}.with_win(60000));
+            }
+            for (size_t i = 18; i-- > 0;) {
+                test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seqno(i)));
+            }
+            test.execute(ExpectBytesInFlight{6 * MSS});
+
+            // segments 12 and 14 are lost; the receiver reports what it holds
+            const auto sack = [&](size_t ack, initializer_list<pair<size_t, size_t>> blocks) {
+                AckReceived step{seqno(ack)};
+                step.with_win(60000);
+                for (const auto& [begin, end] : blocks) {
+                    step.with_sack(seqno(begin), seqno(end));
+                }
+                return step;
+            };
+            test.execute(sack(12, {{13, 14}}));
+            test.execute(sack(12, {{15, 16}, {13, 14}}));
+            test.execute(ExpectNoSegment{});
+            test.execute(sack(12, {{15, 17}, {13, 14}}));
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seqno(12)));
+            test.execute(ExpectNoSegment{});
+
+            // three segments above 14 are SACKed, so it is lost as well: repaired before any
+            // cumulative ACK arrives
+            test.execute(sack(12, {{15, 18}, {13, 14}}));
+            test.execute(ExpectSegment{}.with_payload_size(MSS).with_seqno(seqno(14)));
+            test.execute(ExpectNoSegment{});
+
+            // the retransmissions fill both holes
+            test.execute(sack(14, {{15, 18}}));
+            test.execute(ExpectNoSegment{});
+            test.execute(AckReceived{seqno(18)}.with_win(60000));
+            test.execute(ExpectBytesInFlight{0});
+        }
+
+        {
+            // blocks come out of both reassembler engines as merged, ordered ranges
+            for (const auto engine : {ReassemblerEngine::interval_map, ReassemblerEngine::bitmap}) {
+                StreamReassembler reassembler{100, engine};
+                reassembler.push_substring("ab", 0, false);
+                reassembler.push_substring("ef", 4, false);
+                reassembler.push_substring("gh", 6, false);
+                reassembler.push_substring("xyz", 20, false);
+                reassembler.stream_out().read(2);
+                // wraps around the end of the bitmap engine's ring
+                reassembler.push_substring("end", 99, false);
+                const vector<pair<uint64_t, uint64_t>> expected{{4, 8}, {20, 23}, {99, 102}};
+                test_err_if(reassembler.unassembled_ranges() != expected, "unexpected unassembled ranges");
+            }
+
+            TCPReceiver receiver{4000};
+            const WrappingInt32 isn(rd());
+            const auto segment = [&isn](uint64_t index, const string& data, bool syn = false) {
+                TCPSegment seg;
+                seg.header().syn = syn;
+                seg.header().seqno = syn ? isn : isn + 1 + index;
+                seg.payload() = string(data);
+                return seg;
+            };
+            receiver.segment_received(segment(0, "", true));
+            receiver.segment_received(segment(10, "abc"));
+            receiver.segment_received(segment(13, "abc"));
+            receiver.segment_received(segment(30, "abc"));
+            const auto blocks = receiver.sack_blocks(4);
+            // the block holding the latest segment comes first
+            test_err_if(blocks.size() != 2 or blocks[0].begin != isn + 31 or blocks[0].end != isn + 34
+                            or blocks[1].begin != isn + 11 or blocks[1].end != isn + 17,
+                        "unexpected SACK blocks from the receiver");
+            test_err_if(receiver.sack_blocks(1).size() != 1, "receiver ignored max_blocks");
+        }
+
+        {
+            TCPHeader header;
+            header.ack = true;
+            header.ts = true;
+            header.sack = {{WrappingInt32{10}, WrappingInt32{20}},
+                           {WrappingInt32{30}, WrappingInt32{40}},
+                           {WrappingInt32{50}, WrappingInt32{60}}};
+            NetParser p{Buffer{header.serialize()}};
+            TCPHeader parsed;
+            test_err_if(parsed.parse(p) != ParseResult::NoError, "header with SACK blocks failed to parse");
+            header.doff = parsed.length() / 4;
+            test_err_if(not(parsed == header) or parsed.length() != 20 + 12 + 28,
+                        "SACK blocks did not survive a round trip:\n" + parsed.to_string());
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -253,6 +253,7 @@ struct AckReceived : public SenderAction
 {
     WrappingInt32 _ackno;
     std::optional<uint16_t> _window_advertisement{};
+    AckExtras _extras{};
 
     AckReceived(WrappingInt32 ackno) : _ackno(ackno) {}
     std::string
@@ -260,6 +261,9 @@ struct AckReceived : public SenderAction
     {
         std::ostringstream ss;
         ss << "ack " << _ackno.raw_value();
+        for (const auto& block : _extras.sack) {
+            ss << " sack " << block.begin.raw_value() << "-" << block.end.raw_value();
+        }
         return ss.str();
     }
 
@@ -270,10 +274,25 @@ struct AckReceived : public SenderAction
         return *this;
     }
 
+    AckReceived&
+    with_echoed_timestamp(uint32_t tsecr)
+    {
+        _extras.echoed_timestamp.emplace(tsecr);
+        return *this;
+    }
+
+    AckReceived&
+    with_sack(WrappingInt32 begin, WrappingInt32 end)
+    {
+        _extras.sack.push_back({begin, end});
+        return *this;
+    }
+
     void
     execute(TCPSender& sender, std::deque<TCPSegment>&) const
     {
-        if (not sender.ack_received(_ackno, _window_advertisement.value_or(DEFAULT_TEST_WINDOW))) {
+        if (not sender.ack_received(
+                _ackno, _window_advertisement.value_or(DEFAULT_TEST_WINDOW), _extras)) {
             sender.send_empty_segment();
         }
         sender.fill_window();
@@ -515,7 +534,7 @@ class TCPSenderTestHarness
 public:
     TCPSenderTestHarness(const std::string& name_, TCPConfig config) :
         outbound_segments(),
-        sender(config.send_capacity, config.rt_timeout, config.fixed_isn),
+        sender(config),
         steps_executed(),
         name(name_)
     {
@@ -0,0 +1,154 @@
+#include "sharded_tcp_stack.hh"
+#include "socket.hh"
+#include "test_err_if.hh"
+#include "test_wire.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//! Wait on the main thread until `done` returns true
+template<typename DoneT>
+static void
+wait_for(const DoneT& done, const string& what)
+{
+    const uint64_t start = timestamp_ms();
+    while (not done()) {
+        test_err_if(timestamp_ms() - start >= 20000, "timed out: " + what);
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+//! What one shard's handlers keep between events; only touched on that shard's thread
+struct ShardState {
+    map<TCPStack::ConnectionId, string> sent{};
+    map<TCPStack::ConnectionId, string> received{};
+    uint64_t next_poll{0};
+};
+
+int
+main()
+{
+    try {
+        constexpr size_t shards = 2;
+        constexpr size_t connections_per_shard = 50;
+        TCPConfig config;
+        config.rt_timeout = 20;  // quick retransmissions, and 200 ms of lingering
+        const Address client_address{"10.144.0.1"};
+        const Address server_address{"10.144.0.2"};
+
+        // the wires are crossed, so every datagram arrives at a shard that does not own its connection
+        vector<FileDescriptor> client_ends;
+        vector<FileDescriptor> server_ends;
+        for (size_t i = 0; i < shards; i++) {
+            auto [client_end, server_end] = wire();
+            client_ends.push_back(move(client_end));
+            server_ends.push_back(move(server_end));
+        }
+        rotate(server_ends.begin(), server_ends.begin() + 1, server_ends.end());
+
+        atomic<size_t> accepted{0};
+        atomic<size_t> verified{0};
+        atomic<size_t> open_connections[2][shards]{};
+        vector<ShardState> server_state(shards);
+        vector<ShardState> client_state(shards);
+
+        // every shard publishes how many connections it still has, for the main thread
+        const auto publish_count = [](TCPStack& stack, ShardState& state, atomic<size_t>& count) {
+            stack.event_loop().add_timer([&state] { return state.next_poll; },
+                                         [&stack, &state, &count] {
+                                             count.store(stack.connection_count());
+                                             state.next_poll = timestamp_ms() + 5;
+                                         });
+        };
+
+        const auto server_setup = [&](TCPStack& stack, const size_t index) {
+            ShardState& state = server_state[index];
+            publish_count(stack, state, open_connections[0][index]);
+            const auto serve = [&stack, &state](const TCPStack::ConnectionId id) {
+                state.received[id] += stack.read(id);
+                if (stack.inbound_eof(id)) {
+                    const string& echo = state.received[id];
+                    test_err_if(stack.write(id, Buffer(string(echo))) != echo.size(),
+                                "echo fits in the outbound stream");
+                    stack.close(id);
+                }
+            };
+            stack.set_handler(serve);
+            stack.listen(80, connections_per_shard * shards, [&, serve, index](uint16_t port) {
+                while (const auto id = stack.accept(port)) {
+                    test_err_if(ShardedTCPStack::shard_of(stack.tuple(id.value()), shards) != index,
+                                "accepted by the shard that owns the connection");
+                    accepted++;
+                    serve(id.value());
+                }
+            });
+        };
+
+        const auto client_setup = [&](TCPStack& stack, const size_t index) {
+            ShardState& state = client_state[index];
+            publish_count(stack, state, open_connections[1][index]);
+            stack.set_handler([&stack, &state, &verified](const TCPStack::ConnectionId id) {
+                string& sent = state.sent[id];
+                if (stack.state(id) == TCPState::State::ESTABLISHED and sent.empty()) {
+                    sent = "connection " + to_string(id) + ": " +
+                           string(100 + id * 37 % 900, char('a' + id % 26));
+                    test_err_if(stack.write(id, Buffer(string(sent))) != sent.size(), "write all");
+                    stack.end_output(id);
+                }
+                state.received[id] += stack.read(id);
+                if (stack.inbound_eof(id)) {
+                    test_err_if(state.received[id] != sent, "echo of connection " + to_string(id));
+                    verified++;
+                    stack.close(id);
+                }
+            });
+            for (size_t i = 0; i < connections_per_shard; i++) {
+                const auto id = stack.connect(Address{"10.144.0.2", 80});
+                test_err_if(ShardedTCPStack::shard_of(stack.tuple(id), shards) != index,
+                            "connect() picks a port that the shard owns");
+            }
+        };
+
+        ShardedTCPStack server{move(server_ends), server_address, config, server_setup};
+        ShardedTCPStack client{move(client_ends), client_address, config, client_setup};
+
+        constexpr size_t connections = shards * connections_per_shard;
+        wait_for([&] { return verified == connections; }, "echoes");
+        test_err_if(accepted != connections, "every connection accepted once");
+        wait_for(
+            [&] {
+                for (const auto& side : open_connections) {
+                    for (const auto& count : side) {
+                        if (count != 0) {
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            },
+            "connections forgotten after lingering");
+
+        server.stop();
+        client.stop();
+        test_err_if(not (server.handoffs() > 0 and client.handoffs() > 0), "datagrams changed shards");
+        test_err_if(not (server.handoff_drops() == 0 and client.handoff_drops() == 0), "no handoff dropped");
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -525,6 +525,7 @@ struct SendSegment : public TCPAction
     WrappingInt32 seqno{0};
     WrappingInt32 ackno{0};
     uint16_t win{0};
+    std::optional<uint8_t> wscale{};
     size_t payload_size{0};
     std::string data{};
 
@@ -603,6 +604,13 @@ struct SendSegment : public TCPAction
         return *this;
     }
 
+    SendSegment&
+    with_wscale(uint8_t wscale_)
+    {
+        wscale = wscale_;
+        return *this;
+    }
+
     SendSegment&
     with_payload_size(size_t payload_size_)
     {
@@ -630,6 +638,8 @@ struct SendSegment : public TCPAction
         data_hdr.ackno = ackno;
         data_hdr.seqno = seqno;
         data_hdr.win = win;
+        data_hdr.ws = wscale.has_value();
+        data_hdr.wscale = wscale.value_or(0);
         return data_seg;
     }
 
@@ -0,0 +1,132 @@
+#include "fd_adapter.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_sponge_socket.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+using namespace std;
+
+//! A TCPOverUDPSpongeSocket bound to a UDP socket on the loopback interface
+static unique_ptr<TCPOverUDPSpongeSocket>
+loopback_socket(Address& local)
+{
+    UDPSocket udp;
+    udp.bind(Address("127.0.0.1", 0));
+    local = udp.local_address();
+    return make_unique<TCPOverUDPSpongeSocket>(TCPOverUDPSocketAdapter(move(udp)));
+}
+
+//! Connect `client` (which sends through its outbound ring) to `server`, accepting on another thread
+static void
+connect_pair(TCPOverUDPSpongeSocket& client, const Address& client_address, TCPOverUDPSpongeSocket& server,
+             const Address& server_address, const uint16_t rt_timeout)
+{
+    TCPConfig tcp_config;
+    tcp_config.rt_timeout = rt_timeout;
+
+    FdAdapterConfig server_config;
+    server_config.source = server_address;
+    thread accepting([&] { server.listen_and_accept(tcp_config, server_config); });
+
+    FdAdapterConfig client_config;
+    client_config.source = client_address;
+    client_config.destination = server_address;
+    client.use_outbound_ring(1000);
+    client.connect(tcp_config, client_config);
+    accepting.join();
+}
+
+int
+main()
+{
+    try {
+        // a producer thread streams far more than the ring holds, so it waits on the TCP thread
+        // again and again; end_outbound() reaches the peer as a FIN
+        {
+            Address client_address;
+            Address server_address;
+            auto client = loopback_socket(client_address);
+            auto server = loopback_socket(server_address);
+            connect_pair(*client, client_address, *server, server_address, 10);
+
+            string to_send(1024 * 1024, 'x');
+            for (size_t i = 0; i < to_send.size(); i++) {
+                to_send[i] = char(i * 7 + i / 251);
+            }
+            thread producer([&] {
+                string_view remaining = to_send;
+                size_t chunk = 1;
+                while (not remaining.empty()) {
+                    const auto piece = remaining.substr(0, chunk);
+                    client->write_outbound(piece);
+                    remaining.remove_prefix(piece.size());
+                    chunk = chunk % 3000 + 17;
+                }
+                client->end_outbound();
+            });
+
+            string received;
+            while (not server->eof()) {
+                received += server->read();
+            }
+            producer.join();
+            test_err_if(received != to_send, "peer receives the bytes written to the ring, in order");
+
+            // the peer closes too, and both connections end cleanly
+            server->wait_until_closed();
+            while (not client->eof()) {
+                test_err_if(not client->read().empty(), "no data from the peer");
+            }
+            client->wait_until_closed();
+        }
+
+        // a producer blocked on a full ring is released with an error once the connection is gone
+        {
+            Address client_address;
+            Address server_address;
+            auto client = loopback_socket(client_address);
+            auto server = loopback_socket(server_address);
+            connect_pair(*client, client_address, *server, server_address, 2);
+
+            optional<string> error;
+            thread producer([&] {
+                const string chunk(10000, 'y');
+                try {
+                    while (true) {
+                        client->write_outbound(chunk);
+                    }
+                } catch (const runtime_error& e) {
+                    error = e.what();
+                }
+            });
+
+            // the peer vanishes without a word; the client gives up retransmitting
+            string received;
+            while (received.size() < 50000) {
+                received += server->read();
+            }
+            server.reset();
+            producer.join();
+            test_err_if(not error.has_value(), "blocked producer is released");
+            client->wait_until_closed();
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
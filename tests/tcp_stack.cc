@@ -0,0 +1,166 @@
+#include "socket.hh"
+#include "tcp_stack.hh"
+#include "test_err_if.hh"
+#include "test_wire.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//! Run both stacks until `done` returns true
+template<typename DoneT>
+static void
+run(TCPStack& a, TCPStack& b, const DoneT& done, const string& what)
+{
+    const uint64_t start = timestamp_ms();
+    while (not done()) {
+        test_err_if(timestamp_ms() - start >= 20000, "timed out: " + what);
+        a.wait_next_event(0);
+        b.wait_next_event(0);
+    }
+}
+
+int
+main()
+{
+    try {
+        TCPConfig config;
+        config.rt_timeout = 20;   // quick retransmissions, and 200 ms of lingering
+        const Address client_address{"10.144.0.1"};
+        const Address server_address{"10.144.0.2"};
+        auto rd = get_random_generator();
+
+        // many connections to one listener, each echoing a different message
+        {
+            constexpr size_t connections = 1000;
+            auto [client_end, server_end] = wire();
+            TCPStack client{move(client_end), client_address, config};
+            TCPStack server{move(server_end), server_address, config};
+
+            map<TCPStack::ConnectionId, string> received;
+            const auto serve = [&](const TCPStack::ConnectionId id) {
+                received[id] += server.read(id);
+                if (server.inbound_eof(id)) {
+                    test_err_if(server.write(id, Buffer(string(received[id]))) != received[id].size(),
+                                "echo fits in the outbound stream");
+                    server.close(id);
+                }
+            };
+            size_t accepted = 0;
+            server.set_handler(serve);
+            server.listen(80, connections, [&](uint16_t port) {
+                while (const auto id = server.accept(port)) {
+                    accepted++;
+                    test_err_if(server.tuple(id.value()).local_port != 80, "accepted on port 80");
+                    serve(id.value());
+                }
+            });
+
+            map<TCPStack::ConnectionId, string> sent;
+            map<TCPStack::ConnectionId, string> echoes;
+            size_t verified = 0;
+            client.set_handler([&](const TCPStack::ConnectionId id) {
+                if (client.state(id) == TCPState::State::ESTABLISHED and sent[id].empty()) {
+                    sent[id] = "connection " + to_string(id) + ": " +
+                               string(rd() % 3000, char('a' + id % 26));
+                    test_err_if(client.write(id, Buffer(string(sent[id]))) != sent[id].size(),
+                                "write all");
+                    client.end_output(id);
+                }
+                echoes[id] += client.read(id);
+                if (client.inbound_eof(id)) {
+                    test_err_if(echoes[id] != sent[id], "echo of connection " + to_string(id));
+                    verified++;
+                    client.close(id);
+                }
+            });
+
+            // a few connections per round, so that the server's socket buffer does not overflow
+            size_t connected = 0;
+            run(client, server,
+                [&] {
+                    for (size_t i = 0; i < 8 and connected < connections; i++, connected++) {
+                        const auto id = client.connect(Address{"10.144.0.2", 80});
+                        test_err_if(client.state(id) != TCPState::State::SYN_SENT,
+                                    "connect() sends a SYN");
+                    }
+                    return verified == connections;
+                },
+                "echoes");
+            test_err_if(accepted != connections, "every connection accepted once");
+            run(client, server,
+                [&] { return client.connection_count() == 0 and server.connection_count() == 0; },
+                "connections forgotten after lingering");
+        }
+
+        // a SYN to a port nobody listens on is refused
+        {
+            auto [client_end, server_end] = wire();
+            TCPStack client{move(client_end), client_address, config};
+            TCPStack server{move(server_end), server_address, config};
+            const auto id = client.connect(Address{"10.144.0.2", 81});
+            run(client, server, [&] { return not client.active(id); }, "RST");
+            test_err_if(client.state(id) != TCPState::State::RESET, "refused with a RST");
+            client.close(id);
+            test_err_if(not (client.connection_count() == 0 and server.connection_count() == 0),
+                        "nothing left");
+        }
+
+        // SYNs beyond the backlog wait until accept() makes room
+        {
+            auto [client_end, server_end] = wire();
+            TCPStack client{move(client_end), client_address, config};
+            TCPStack server{move(server_end), server_address, config};
+            server.listen(82, 2);
+            vector<TCPStack::ConnectionId> ids;
+            for (unsigned i = 0; i < 4; i++) {
+                ids.push_back(client.connect(Address{"10.144.0.2", 82}));
+            }
+            const auto established = [&] {
+                size_t count = 0;
+                for (const auto id : ids) {
+                    count += client.state(id) == TCPState::State::ESTABLISHED;
+                }
+                return count;
+            };
+            run(client, server, [&] { return established() == 2; }, "backlog of two");
+            const uint64_t start = timestamp_ms();
+            run(client, server, [&] { return timestamp_ms() - start > 100; },
+                "SYN retransmissions");
+            test_err_if(not (established() == 2 and server.connection_count() == 2), "backlog is full");
+
+            vector<TCPStack::ConnectionId> accepted;
+            run(client, server,
+                [&] {
+                    while (const auto id = server.accept(82)) {
+                        accepted.push_back(id.value());
+                    }
+                    return established() == 4 and accepted.size() == 4;
+                },
+                "room in the backlog");
+
+            for (const auto id : accepted) {
+                server.close(id);
+            }
+            for (const auto id : ids) {
+                client.close(id);
+            }
+            run(client, server,
+                [&] { return client.connection_count() == 0 and server.connection_count() == 0; },
+                "closing");
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
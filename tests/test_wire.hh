@@ -0,0 +1,34 @@
+#ifndef SPONGE_TESTS_TEST_WIRE_HH
+#define SPONGE_TESTS_TEST_WIRE_HH
+
+#include "file_descriptor.hh"
+#include "socket.hh"
+#include "util.hh"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <utility>
+
+//! Two connected UDP sockets on the loopback interface, to join two endpoints as if by a wire
+static std::pair<FileDescriptor, FileDescriptor>
+wire()
+{
+    UDPSocket a;
+    UDPSocket b;
+    a.bind(Address("127.0.0.1", 0));
+    b.bind(Address("127.0.0.1", 0));
+    a.connect(b.local_address());
+    b.connect(a.local_address());
+    return {std::move(a), std::move(b)};
+}
+
+//! A non-blocking pipe: the read end, then the write end
+static std::pair<FileDescriptor, FileDescriptor>
+make_pipe()
+{
+    int fds[2];
+    SystemCall("pipe2", ::pipe2(static_cast<int*>(fds), O_NONBLOCK | O_CLOEXEC));
+    return {FileDescriptor{fds[0]}, FileDescriptor{fds[1]}};
+}
+
+#endif   // SPONGE_TESTS_TEST_WIRE_HH
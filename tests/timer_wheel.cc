@@ -0,0 +1,152 @@
+#include "test_err_if.hh"
+#include "timer_wheel.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+int
+main()
+{
+    try {
+        // firing order and times, including a zero delay and a deadline in the past
+        {
+            TimerWheel wheel{1000};
+            vector<pair<uint64_t, uint64_t>> fired;
+            const auto record = [&](TimerWheel::TimerId, uint64_t tag) {
+                fired.emplace_back(tag, wheel.now());
+            };
+            wheel.schedule(5000, 3);
+            wheel.schedule(70, 2);
+            wheel.schedule(0, 1);
+            wheel.schedule_at(10, 0);
+            test_err_if(wheel.size() != 4, "four timers pending");
+            test_err_if(wheel.next_expiration() != 1000, "past deadlines are due now");
+            test_err_if(wheel.time_until_next_expiration() != 0, "due timers are 0 ms away");
+
+            wheel.advance(0, record);
+            test_err_if((fired != vector<pair<uint64_t, uint64_t>>{{1, 1000}, {0, 1000}}),
+                        "due timers fire on advance(0)");
+            test_err_if(wheel.time_until_next_expiration() == 0 or wheel.time_until_next_expiration() > 70,
+                        "next timer is at most 70 ms away");
+            wheel.advance(69, record);
+            test_err_if(fired.size() != 2, "nothing fires before its deadline");
+            wheel.advance(1, record);
+            test_err_if(fired.back() != make_pair(uint64_t{2}, uint64_t{1070}),
+                        "timer fires at its deadline");
+            wheel.advance(100000, record);
+            test_err_if(fired.back() != make_pair(uint64_t{3}, uint64_t{6000}),
+                        "now() is the deadline inside the handler");
+            test_err_if(not (wheel.now() == 101070 and wheel.size() == 0), "time ends at the target");
+        }
+
+        // cancellation, also from inside the handler, and scheduling from the handler
+        {
+            TimerWheel wheel;
+            vector<uint64_t> fired;
+            wheel.schedule(100, 1);
+            const auto victim = wheel.schedule(100, 2);
+            const auto gone = wheel.schedule(4000, 3);
+            test_err_if(not (wheel.cancel(gone) and not wheel.cancel(gone)), "cancel exactly once");
+            test_err_if(wheel.pending(gone) or not wheel.pending(victim), "pending");
+            wheel.advance(200, [&](TimerWheel::TimerId, uint64_t tag) {
+                fired.push_back(tag);
+                if (tag == 1) {
+                    test_err_if(not wheel.cancel(victim), "cancel a timer due at the same time");
+                    wheel.schedule(0, 4);
+                }
+            });
+            test_err_if((fired != vector<uint64_t>{1, 4}),
+                        "cancelled timers never fire; timers scheduled while firing do");
+            test_err_if(wheel.size() != 0, "nothing left");
+            test_err_if(wheel.next_expiration().has_value(), "no expiration when empty");
+        }
+
+        // far deadlines beyond the top level, and moving the wheel
+        {
+            TimerWheel original;
+            const uint64_t far = uint64_t{1} << 40;
+            original.schedule(far);
+            original.schedule(10);
+            TimerWheel wheel = std::move(original);
+            vector<uint64_t> fired;
+            const auto record = [&](TimerWheel::TimerId, uint64_t) {
+                fired.push_back(wheel.now());
+            };
+            wheel.advance(far - 1, record);
+            test_err_if(fired != vector<uint64_t>{10}, "far timer waits");
+            wheel.advance(1, record);
+            test_err_if((fired != vector<uint64_t>{10, far}), "far timer fires on time");
+        }
+
+        // random schedules, cancellations and advances against a sorted reference
+        auto rd = get_random_generator();
+        for (unsigned round = 0; round < 20; round++) {
+            TimerWheel wheel{rd() % 100000};
+            multimap<uint64_t, TimerWheel::TimerId> expected;
+            set<TimerWheel::TimerId> cancelled;
+            vector<pair<uint64_t, TimerWheel::TimerId>> fired;
+
+            for (unsigned step = 0; step < 2000; step++) {
+                switch (rd() % 4) {
+                    case 0:
+                    case 1: {
+                        const uint64_t delay =
+                            rd() % 3 == 0 ? rd() % 64 : rd() % (1 << (rd() % 24));
+                        const uint64_t deadline = wheel.now() + delay;
+                        expected.emplace(deadline, wheel.schedule_at(deadline, deadline));
+                        break;
+                    }
+                    case 2:
+                        if (not expected.empty()) {
+                            auto it = expected.begin();
+                            advance(it, rd() % expected.size());
+                            test_err_if(not wheel.cancel(it->second), "cancel a pending timer");
+                            cancelled.insert(it->second);
+                            expected.erase(it);
+                        }
+                        break;
+                    default: {
+                        const uint64_t target = wheel.now() + rd() % (1 << (rd() % 20));
+                        fired.clear();
+                        const auto record = [&](TimerWheel::TimerId id, uint64_t tag) {
+                            test_err_if(tag != wheel.now(), "timer fires at its deadline");
+                            fired.emplace_back(tag, id);
+                        };
+                        wheel.advance(target - wheel.now(), record);
+                        vector<pair<uint64_t, TimerWheel::TimerId>> want;
+                        while (not expected.empty() and expected.begin()->first <= target) {
+                            want.emplace_back(*expected.begin());
+                            expected.erase(expected.begin());
+                        }
+                        test_err_if(fired.size() != want.size(), "the right number of timers fire");
+                        for (size_t i = 0; i < fired.size(); i++) {
+                            test_err_if(fired[i].first != want[i].first, "timers fire in deadline order");
+                            test_err_if(cancelled.count(fired[i].second), "cancelled timer fired");
+                        }
+                        test_err_if(wheel.now() != target, "advance reaches its target");
+                    }
+                }
+                test_err_if(wheel.size() != expected.size(), "size() counts pending timers");
+                if (not expected.empty()) {
+                    test_err_if(wheel.next_expiration().value() > expected.begin()->first,
+                                "next_expiration() is a lower bound");
+                }
+            }
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
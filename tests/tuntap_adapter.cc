@@ -0,0 +1,213 @@
+#include "ipv4_datagram.hh"
+#include "test_err_if.hh"
+#include "tuntap_adapter.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+
+static const Address LOCAL{"10.0.0.1", 1234};
+static const Address PEER{"10.0.0.2", 80};
+
+//! What the test sent, and what it expects to come out of the device
+struct Sent {
+    uint32_t seqno;
+    string payload;
+    bool fin;
+    uint16_t win;
+};
+
+static TCPSegment
+segment(const Sent& sent)
+{
+    TCPSegment seg;
+    seg.header().ack = true;
+    seg.header().ackno = WrappingInt32{7};
+    seg.header().seqno = WrappingInt32{sent.seqno};
+    seg.header().fin = sent.fin;
+    seg.header().psh = sent.fin;
+    seg.header().win = sent.win;
+    seg.payload() = string(sent.payload);
+    return seg;
+}
+
+//! One packet the adapter wrote, split back into segments the way the kernel segments a TSO
+//! super-segment: the checksum is completed from `csum_start` on, and the payload cut into
+//! `gso_size` pieces behind copies of the TCP header
+static vector<Sent>
+segment_like_kernel(string packet, vector<uint16_t>& gso_sizes)
+{
+    VirtioNetHeader vnet{};
+    test_err_if(packet.size() < sizeof(vnet), "packet starts with a vnet header");
+    memcpy(&vnet, packet.data(), sizeof(vnet));
+    packet.erase(0, sizeof(vnet));
+
+    if (vnet.gso_type == VirtioNetHeader::GSO_TCPV4) {
+        test_err_if(vnet.flags != VirtioNetHeader::F_NEEDS_CSUM,
+                    "super-segment leaves the checksum to the device");
+        test_err_if(vnet.csum_start != IPv4Header::LENGTH, "checksum starts at the TCP header");
+        test_err_if(vnet.csum_offset != 16, "TCP checksum is 16 bytes into the TCP header");
+        InternetChecksum check;
+        check.add(string_view(packet).substr(vnet.csum_start));
+        const uint16_t cksum = check.value();
+        packet[vnet.csum_start + vnet.csum_offset] = static_cast<char>(cksum >> 8);
+        packet[vnet.csum_start + vnet.csum_offset + 1] = static_cast<char>(cksum & 0xff);
+    } else {
+        test_err_if(vnet.gso_type != VirtioNetHeader::GSO_NONE or vnet.flags != 0, "plain packet");
+    }
+
+    InternetDatagram dgram;
+    test_err_if(dgram.parse(string(packet)) != ParseResult::NoError, "datagram parses");
+    test_err_if(dgram.header().src != LOCAL.ipv4_numeric() or dgram.header().dst != PEER.ipv4_numeric(),
+                "datagram addresses");
+    TCPSegment seg;
+    const ParseResult tcp_result = seg.parse(dgram.payload().concatenate(), dgram.header().pseudo_cksum());
+    test_err_if(tcp_result != ParseResult::NoError, "TCP checksum is correct once completed");
+    test_err_if(seg.header().sport != LOCAL.port() or seg.header().dport != PEER.port(), "ports");
+
+    const string payload{seg.payload().str()};
+    if (vnet.gso_type == VirtioNetHeader::GSO_NONE) {
+        gso_sizes.push_back(0);
+        return {{seg.header().seqno.raw_value(), payload, seg.header().fin, seg.header().win}};
+    }
+    test_err_if(vnet.hdr_len != IPv4Header::LENGTH + seg.header().length(), "hdr_len covers both headers");
+    gso_sizes.push_back(vnet.gso_size);
+    vector<Sent> pieces;
+    for (size_t offset = 0; offset < payload.size(); offset += vnet.gso_size) {
+        const bool last = offset + vnet.gso_size >= payload.size();
+        pieces.push_back({seg.header().seqno.raw_value() + uint32_t(offset),
+                          payload.substr(offset, vnet.gso_size),
+                          last and seg.header().fin,
+                          seg.header().win});
+    }
+    return pieces;
+}
+
+//! Is a packet waiting on the test's end of the socketpair?
+static bool
+device_has_packet(FileDescriptor& device)
+{
+    char byte = 0;
+    return ::recv(device.fd_num(), &byte, 1, MSG_PEEK | MSG_DONTWAIT) > 0;
+}
+
+//! A datagram from the peer, with a correct TCP checksum, or only the pseudo-header's sum in its
+//! place (as the kernel leaves it with NEEDS_CSUM)
+static string
+from_peer(const string& payload, const bool partial_checksum)
+{
+    TCPSegment seg;
+    seg.header().sport = PEER.port();
+    seg.header().dport = LOCAL.port();
+    seg.header().ack = true;
+    seg.payload() = string(payload);
+
+    InternetDatagram dgram;
+    dgram.header().src = PEER.ipv4_numeric();
+    dgram.header().dst = LOCAL.ipv4_numeric();
+    dgram.header().len = dgram.header().hlen * 4 + seg.header().length() + payload.size();
+    string tcp = seg.serialize(dgram.header().pseudo_cksum()).concatenate();
+    if (partial_checksum) {
+        const InternetChecksum pseudo_sum{dgram.header().pseudo_cksum()};
+        const auto pseudo = static_cast<uint16_t>(~pseudo_sum.value());
+        tcp[16] = static_cast<char>(pseudo >> 8);
+        tcp[17] = static_cast<char>(pseudo & 0xff);
+    }
+    dgram.payload() = move(tcp);
+    return dgram.serialize().concatenate();
+}
+
+int
+main()
+{
+    try {
+        int fds[2];
+        SystemCall("socketpair", socketpair(AF_UNIX, SOCK_SEQPACKET, 0, static_cast<int*>(fds)));
+        FileDescriptor device{fds[1]};
+        TCPOverIPv4OverTunFdAdapter adapter{TunFD{FileDescriptor{fds[0]}, true}};
+        adapter.config_mut().source = LOCAL;
+        adapter.config_mut().destination = PEER;
+
+        // runs of segments, and the TSO packets they should be merged into (gso_size, or 0 for a plain
+        // packet)
+        vector<Sent> sent;
+        uint32_t seqno = 1000;
+        const auto add = [&](const size_t size, const bool fin = false, const uint16_t win = 1000) {
+            sent.push_back({seqno, string(size, char('a' + sent.size() % 26)), fin, win});
+            seqno += size + fin;
+        };
+        for (unsigned i = 0; i < 4; i++) {
+            add(1000);
+        }
+        add(300, true);  // a shorter last segment, with FIN: one run of five
+        add(1000);       // nothing continues a run after FIN
+        add(1500);       // larger than the first segment: a run of its own
+        add(1000);       // shorter: may end the run...
+        add(1000);       // ...but not continue it
+        add(1000, false, 2000);  // a different header
+        add(1000, false, 2000);
+        seqno += 5000;
+        add(1000, false, 2000);  // not contiguous
+        for (unsigned i = 0; i < 70; i++) {
+            add(1000);  // more than one super-segment can carry
+        }
+        const vector<uint16_t> expected_gso_sizes{1000, 0, 1500, 0, 1000, 0, 1000, 1000};
+
+        for (const auto& s : sent) {
+            TCPSegment seg = segment(s);
+            adapter.write(seg);
+        }
+        test_err_if(device_has_packet(device), "write() holds segments back until flush()");
+        adapter.flush();
+
+        vector<Sent> received;
+        vector<uint16_t> gso_sizes;
+        while (device_has_packet(device)) {
+            for (auto& piece : segment_like_kernel(device.read(), gso_sizes)) {
+                received.push_back(move(piece));
+            }
+        }
+        test_err_if((gso_sizes != expected_gso_sizes), "runs are merged into the expected packets");
+        test_err_if(received.size() != sent.size(), "as many segments come out as went in");
+        for (size_t i = 0; i < sent.size(); i++) {
+            test_err_if(received[i].seqno != sent[i].seqno or received[i].payload != sent[i].payload
+                            or received[i].fin != sent[i].fin or received[i].win != sent[i].win,
+                        "segment " + to_string(i) + " comes out as it went in");
+        }
+
+        // reading: a checksum the kernel left to the device (NEEDS_CSUM) or already verified
+        // (DATA_VALID) is not checked; any other must be correct
+        const auto deliver = [&](const uint8_t flags, const uint8_t gso_type, const string& datagram) {
+            VirtioNetHeader vnet{};
+            vnet.flags = flags;
+            vnet.gso_type = gso_type;
+            string packet(reinterpret_cast<const char*>(&vnet), sizeof(vnet));
+            device.write(packet + datagram);
+            return adapter.read();
+        };
+        const string super_segment(60000, 's');
+        const auto coalesced = deliver(VirtioNetHeader::F_NEEDS_CSUM, VirtioNetHeader::GSO_TCPV4,
+                                       from_peer(super_segment, true));
+        test_err_if(not coalesced.has_value() or coalesced->payload().str() != super_segment,
+                    "a GRO super-segment arrives whole");
+        const auto verified =
+            deliver(VirtioNetHeader::F_DATA_VALID, VirtioNetHeader::GSO_NONE, from_peer("v", true));
+        test_err_if(not verified, "a verified checksum is not checked again");
+        test_err_if(deliver(0, VirtioNetHeader::GSO_NONE, from_peer("p", true)).has_value(),
+                    "a partial checksum is rejected without NEEDS_CSUM");
+        test_err_if(not deliver(0, VirtioNetHeader::GSO_NONE, from_peer("c", false)), "a correct checksum");
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
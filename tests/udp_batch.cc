@@ -0,0 +1,208 @@
+#include "buffer.hh"
+#include "fd_adapter.hh"
+#include "socket.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//! A UDPSocket bound to an ephemeral port on the loopback interface
+static UDPSocket
+loopback_socket()
+{
+    UDPSocket sock;
+    sock.bind(Address("127.0.0.1", 0));
+    return sock;
+}
+
+//! An adapter on a new loopback socket, sending to `destination`
+static TCPOverUDPSocketAdapter
+loopback_adapter(const Address& destination, const bool offload)
+{
+    UDPSocket sock = loopback_socket();
+    const Address local = sock.local_address();
+    TCPOverUDPSocketAdapter adapter{move(sock)};
+    adapter.set_offload(offload);
+    adapter.config_mut().source = local;
+    adapter.config_mut().destination = destination;
+    return adapter;
+}
+
+//! Write a segment with `payload_size` bytes of payload, numbered `seqno`, and return it
+static TCPSegment
+write_segment(TCPOverUDPSocketAdapter& adapter, const uint32_t seqno, const size_t payload_size)
+{
+    TCPSegment seg;
+    seg.header().seqno = WrappingInt32{seqno};
+    seg.payload() = string(payload_size, char('a' + seqno % 26));
+    adapter.write(seg);
+    return seg;
+}
+
+//! Read `count` segments from `adapter`, whose datagrams are already waiting on its socket
+static vector<TCPSegment>
+read_segments(TCPOverUDPSocketAdapter& adapter, const size_t count)
+{
+    vector<TCPSegment> segments;
+    for (size_t attempts = 0; segments.size() < count and attempts < 100 * count; attempts++) {
+        if (auto seg = adapter.read()) {
+            segments.push_back(move(*seg));
+        }
+    }
+    test_err_if(segments.size() != count, "adapter reads " + to_string(count) + " segments");
+    test_err_if(adapter.read().has_value() or adapter.read_pending(), "and nothing more");
+    return segments;
+}
+
+int
+main()
+{
+    try {
+        UDPSocket receiver;
+        receiver.bind(Address("127.0.0.1", 0));
+        UDPSocket sender;
+        sender.bind(Address("127.0.0.1", 0));
+
+        vector<UDPSocket::received_datagram> batch(64);
+        test_err_if(receiver.recv_batch(batch) != 0, "recv_batch() does not block when nothing is waiting");
+
+        // 100 datagrams, each sent from several views, in one send_batch()
+        vector<string> sent;
+        vector<BufferViewList> payloads;
+        for (unsigned i = 0; i < 100; i++) {
+            sent.push_back(to_string(i) + ":" + string(i * 7, char('a' + i % 26)));
+        }
+        for (const auto& payload : sent) {
+            BufferViewList views{string_view(payload).substr(0, 2)};
+            views.append(string_view(payload).substr(2));
+            payloads.push_back(views);
+        }
+        sender.send_batch(receiver.local_address(), payloads);
+
+        // received in order, 64 and then 36
+        size_t next = 0;
+        for (const size_t expected : {64, 36, 0}) {
+            const size_t count = receiver.recv_batch(batch);
+            test_err_if(count != expected, "recv_batch() returns as many datagrams as fit or are waiting");
+            for (size_t i = 0; i < count; i++, next++) {
+                test_err_if(batch[i].payload != sent[next], "payloads arrive intact and in order");
+                test_err_if(batch[i].source_address != sender.local_address(),
+                            "source address is the sender");
+            }
+        }
+
+        // empty datagrams are datagrams too
+        sender.send_batch(receiver.local_address(), {BufferViewList{}, BufferViewList{"x"}});
+        const size_t received = receiver.recv_batch(batch);
+        test_err_if(received != 2 or not batch[0].payload.empty() or batch[1].payload != "x",
+                    "empty payload");
+
+        // a datagram that does not fit is an error, as with recv()
+        sender.send_batch(receiver.local_address(), {BufferViewList{string(100, 'x')}});
+        bool threw = false;
+        try {
+            receiver.recv_batch(batch, 50);
+        } catch (const runtime_error&) {
+            threw = true;
+        }
+        test_err_if(not threw, "oversized datagram throws");
+
+        // with GSO, the kernel cuts one payload into datagrams of the segment size...
+        const string run = string(100, 'a') + string(100, 'b') + string(100, 'c') + string(50, 'd');
+        sender.send_batch(receiver.local_address(), {BufferViewList{run}}, {100});
+        test_err_if(receiver.recv_batch(batch) != 4, "GSO payload arrives as four datagrams");
+        test_err_if(not (batch[2].payload == string(100, 'c') and batch[3].payload == string(50, 'd')),
+                    "GSO datagrams are cut at the segment size");
+        test_err_if(batch[0].segment_size != 0, "datagrams are not coalesced without GRO");
+
+        // ...which a socket with GRO may receive in one payload again
+        receiver.set_gro(true);
+        sender.send_batch(receiver.local_address(), {BufferViewList{run}}, {100});
+        test_err_if(receiver.recv_batch(batch) != 1, "GRO coalesces the datagrams");
+        test_err_if(batch[0].payload != run or batch[0].segment_size != 100,
+                    "coalesced payload and segment size");
+
+        // an adapter with offload sends each run of equal-size segments, which may end in one
+        // shorter segment, as one GSO payload (a GRO socket receives the payloads as they were sent)
+        UDPSocket observer = loopback_socket();
+        observer.set_gro(true);
+        TCPOverUDPSocketAdapter offloading = loopback_adapter(observer.local_address(), true);
+
+        // payload sizes, written and flushed together; then the payloads and segment sizes expected
+        // (the segment size includes the 20-byte TCP header, and is 0 for a lone segment)
+        const vector<vector<size_t>> flushes{
+            {1000, 1000, 1000, 1000, 300, 1000, 1500, 1500, 1000, 1000, 1000},
+            vector<size_t>(64, 100),   // as many segments as one payload may carry
+            vector<size_t>(50, 1400),  // more bytes than one payload may carry
+            {700},
+        };
+        const vector<pair<size_t, size_t>> expected_runs{
+            {5, 1020}, {1, 0}, {3, 1520}, {2, 1020}, {64, 120}, {45, 1420}, {5, 1420}, {1, 0}};
+
+        vector<TCPSegment> written;
+        for (const auto& sizes : flushes) {
+            for (const size_t size : sizes) {
+                written.push_back(write_segment(offloading, written.size(), size));
+            }
+            offloading.flush();
+        }
+
+        vector<pair<size_t, size_t>> runs;
+        size_t next_segment = 0;
+        for (size_t count = observer.recv_batch(batch); count > 0; count = observer.recv_batch(batch)) {
+            for (size_t i = 0; i < count; i++) {
+                string expected;
+                size_t segments = 0;
+                while (expected.size() < batch[i].payload.size() and next_segment < written.size()) {
+                    expected += written[next_segment++].serialize(0).concatenate();
+                    segments++;
+                }
+                test_err_if(batch[i].payload != expected, "a GSO payload is its segments back to back");
+                runs.emplace_back(segments, batch[i].segment_size);
+            }
+        }
+        test_err_if(runs != expected_runs, "runs are grouped and capped");
+
+        // an adapter with offload slices each GRO payload back into segments, and drops every slice
+        // of a payload from anyone but its peer
+        TCPOverUDPSocketAdapter receiving = loopback_adapter(Address("127.0.0.1", 0), true);
+        TCPOverUDPSocketAdapter sending = loopback_adapter(receiving.config().source, true);
+        TCPOverUDPSocketAdapter stranger = loopback_adapter(receiving.config().source, true);
+        receiving.config_mut().destination = sending.config().source;
+
+        uint32_t seqno = 0;
+        for (const auto& sizes : flushes) {
+            for (const size_t size : sizes) {
+                write_segment(stranger, 1000000 + seqno, size);
+            }
+            stranger.flush();
+            vector<TCPSegment> sent_segments;
+            for (const size_t size : sizes) {
+                sent_segments.push_back(write_segment(sending, seqno++, size));
+            }
+            sending.flush();
+
+            const auto read_back = read_segments(receiving, sent_segments.size());
+            for (size_t i = 0; i < sent_segments.size(); i++) {
+                const TCPSegment& seg = sent_segments[i];
+                test_err_if(read_back[i].header().seqno != seg.header().seqno
+                                or read_back[i].payload().str() != seg.payload().str(),
+                            "segment " + to_string(seg.header().seqno.raw_value()) + " read as written");
+            }
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}